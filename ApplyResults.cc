@@ -0,0 +1,309 @@
+/*
+   copyright 2026 Paul Dreik
+   Distributed under GPL v 2.0 or later, at your option.
+   See LICENSE for further details.
+*/
+
+#include "config.h"
+
+// std
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <iostream>
+#include <iterator>
+#include <optional>
+#include <vector>
+
+// os
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// project
+#include "ApplyResults.hh"
+#include "Fileinfo.hh"
+#include "Options.hh"
+#include "PageCache.hh"
+#include "Rdutil.hh"
+#include "ResultsFile.hh"
+#include "Throttle.hh"
+
+namespace {
+bool
+parseduptype(const std::string& text, Fileinfo::duptype& duptype)
+{
+  if (text == "DUPTYPE_FIRST_OCCURRENCE") {
+    duptype = Fileinfo::duptype::DUPTYPE_FIRST_OCCURRENCE;
+  } else if (text == "DUPTYPE_WITHIN_SAME_TREE") {
+    duptype = Fileinfo::duptype::DUPTYPE_WITHIN_SAME_TREE;
+  } else if (text == "DUPTYPE_OUTSIDE_TREE") {
+    duptype = Fileinfo::duptype::DUPTYPE_OUTSIDE_TREE;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+bool
+newerthan(const struct stat& a, const struct stat& b)
+{
+  if (a.st_mtim.tv_sec != b.st_mtim.tv_sec) {
+    return a.st_mtim.tv_sec > b.st_mtim.tv_sec;
+  }
+  return a.st_mtim.tv_nsec > b.st_mtim.tv_nsec;
+}
+
+/// the change time in nanoseconds since the epoch, as in the results file
+std::int64_t
+ctimeof(const struct stat& info)
+{
+  return std::int64_t{ info.st_ctim.tv_sec } * 1000000000 +
+         info.st_ctim.tv_nsec;
+}
+
+/**
+ * reads into buffer from offset, until it is full or the file ends, at the
+ * rate the options allow.
+ * @return the number of bytes read, negative on error
+ */
+ssize_t
+readat(int fd, std::vector<char>& buffer, off_t offset, const Options& options)
+{
+  std::size_t filled = 0;
+  while (filled < buffer.size()) {
+    const auto wanted = buffer.size() - filled;
+    throttleread(options, wanted);
+    const auto n = pread(
+      fd, buffer.data() + filled, wanted, offset + static_cast<off_t>(filled));
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n < 0) {
+      return -1;
+    }
+    if (n == 0) {
+      break;
+    }
+    filled += static_cast<std::size_t>(n);
+  }
+  return static_cast<ssize_t>(filled);
+}
+
+/**
+ * reads the files the way they are checksummed, within -maxopenrate and
+ * -maxreadrate, and with -cacheneutral leaving the page cache as it was.
+ * @return true if the files could be read and have the same contents
+ */
+bool
+samecontents(const std::string& a, const std::string& b, const Options& options)
+{
+  throttleopen(options);
+  const int fda = open(a.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fda < 0) {
+    return false;
+  }
+  throttleopen(options);
+  const int fdb = open(b.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fdb < 0) {
+    close(fda);
+    return false;
+  }
+  struct stat infoa
+  {};
+  struct stat infob
+  {};
+  bool same = 0 == fstat(fda, &infoa) && 0 == fstat(fdb, &infob) &&
+              infoa.st_size == infob.st_size;
+  std::optional<CacheKeeper> keepera;
+  std::optional<CacheKeeper> keeperb;
+  if (same && options.cacheneutral) {
+    const auto size = static_cast<std::uint64_t>(infoa.st_size);
+    keepera.emplace(fda, 0, size, true);
+    keeperb.emplace(fdb, 0, size, true);
+  }
+  std::vector<char> bufa(options.buffersize);
+  std::vector<char> bufb(options.buffersize);
+  off_t offset = 0;
+  while (same) {
+    const auto na = readat(fda, bufa, offset, options);
+    const auto nb = readat(fdb, bufb, offset, options);
+    if (na < 0 || na != nb) {
+      same = false;
+      break;
+    }
+    if (na == 0) {
+      break;
+    }
+    const auto n = static_cast<std::size_t>(na);
+    same = std::equal(bufa.begin(),
+                      bufa.begin() + static_cast<std::ptrdiff_t>(n),
+                      bufb.begin());
+    offset += na;
+    if (keepera) {
+      keepera->release(static_cast<std::uint64_t>(offset));
+      keeperb->release(static_cast<std::uint64_t>(offset));
+    }
+  }
+  keepera.reset();
+  keeperb.reset();
+  close(fda);
+  close(fdb);
+  return same;
+}
+} // namespace
+
+int
+applyresults(const Options& options, const std::string& dryruntext)
+{
+  const std::string& filename = options.applyfile;
+  struct stat resultsinfo
+  {};
+  if (0 != stat(filename.c_str(), &resultsinfo)) {
+    std::cerr << "could not find results file \"" << filename << "\"\n";
+    return -1;
+  }
+  std::vector<ResultEntry> entries;
+  if (0 != readresultsfile(filename, entries)) {
+    return -1;
+  }
+  // a results file edited after it was made is newer than the files changed
+  // in between, so only the change times of the binary format tell for sure.
+  // without them, the contents have to be compared before losing any.
+  const bool knowsctimes =
+    std::all_of(entries.begin(), entries.end(), [](const ResultEntry& e) {
+      return e.ctime != 0;
+    });
+  if (!knowsctimes && !options.applyverify && !options.dryrun &&
+      (options.makesymlinks || options.makehardlinks ||
+       options.deleteduplicates)) {
+    std::cerr << "results file \"" << filename
+              << "\" does not tell when its files last changed. give "
+                 "-applyverify true, or make it with -outputformat binary\n";
+    return -1;
+  }
+  std::cout << dryruntext << "Now checking the " << entries.size()
+            << " files of results file " << filename << std::endl;
+
+  std::vector<Fileinfo> list;
+  std::size_t changed = 0;
+  std::size_t different = 0;
+  for (auto it = entries.begin(); it != entries.end();) {
+    const bool remote = it->isremoteoriginal();
+    if (!it->isoriginal() && !remote) {
+      std::cerr << "results file \"" << filename << "\" has \"" << it->name
+                << "\" without an original before it\n";
+      return -1;
+    }
+    const auto identity = it->identity;
+    const auto last = std::find_if(it + 1, entries.end(), [=](const auto& e) {
+      return e.identity != -identity;
+    });
+    if (!it->name.empty() && it->name.back() == '/') {
+      // a set of directories from -dirduplicates. the files within are not
+      // in the results file, so it is not known what to act on.
+      std::cout << dryruntext << "Skipping the set of directory " << it->name
+                << ", only files are acted on" << std::endl;
+      it = last;
+      continue;
+    }
+    if (remote && (options.makesymlinks || options.makehardlinks ||
+                   options.dedupextents)) {
+      // from -mergemanifests, the original is on another node
+      std::cout << dryruntext << "Skipping the set of " << it->name
+                << ", the original is on another node, only deleting is done"
+                << std::endl;
+      it = last;
+      continue;
+    }
+
+    std::vector<Fileinfo> group;
+    for (; it != last; ++it) {
+      if (remote && group.empty()) {
+        // it can not be checked, but is never acted on
+        Fileinfo file(
+          it->name, it->cmdline_index, static_cast<int>(it->depth));
+        file.setidentity(it->identity);
+        file.setduptype(Fileinfo::duptype::DUPTYPE_FIRST_OCCURRENCE);
+        group.push_back(std::move(file));
+        continue;
+      }
+      Fileinfo::duptype duptype{};
+      if (!parseduptype(it->duptype, duptype)) {
+        std::cerr << "results file \"" << filename << "\" has \"" << it->name
+                  << "\" with bad duptype " << it->duptype << '\n';
+        return -1;
+      }
+      Fileinfo file(it->name, it->cmdline_index, static_cast<int>(it->depth));
+      struct stat info
+      {};
+      const bool exists = 0 == lstat(it->name.c_str(), &info);
+      if (exists) {
+        file.setfileinfo(info);
+      }
+      const bool unchanged = exists && file.isRegularFile() &&
+                             file.size() == it->size &&
+                             file.device() == it->device &&
+                             file.inode() == it->inode &&
+                             (it->ctime != 0 ? ctimeof(info) == it->ctime
+                                             : !newerthan(info, resultsinfo));
+      const bool isoriginal = group.empty();
+      if (!unchanged) {
+        std::cout << dryruntext << "Skipping "
+                  << (isoriginal ? "the set of " : "") << it->name
+                  << ", it changed after the results file was made"
+                  << std::endl;
+        ++changed;
+        if (isoriginal) {
+          changed += static_cast<std::size_t>(last - it - 1);
+          it = last;
+          break;
+        }
+        continue;
+      }
+      if (!isoriginal && options.applyverify &&
+          (remote ||
+           !samecontents(group.front().name(), it->name, options))) {
+        std::cout << dryruntext << "Skipping " << it->name
+                  << (remote ? ", it can not be compared to "
+                             : ", its contents differ from ")
+                  << group.front().name() << std::endl;
+        ++different;
+        continue;
+      }
+      file.setidentity(it->identity);
+      file.setduptype(duptype);
+      group.push_back(std::move(file));
+    }
+    if (group.size() >= 2) {
+      std::move(group.begin(), group.end(), std::back_inserter(list));
+    }
+  }
+
+  std::cout << dryruntext << "Skipped " << changed << " changed files";
+  if (options.applyverify) {
+    std::cout << " and " << different << " files with other contents";
+  }
+  std::cout << ". " << list.size() << " files left." << std::endl;
+
+  Rdutil gswd(list);
+  if (options.makesymlinks) {
+    std::cout << dryruntext << "Now making symbolic links." << std::endl;
+    const auto tmp = gswd.makesymlinks(options.dryrun, options.threads);
+    std::cout << dryruntext << "Making " << tmp << " links." << std::endl;
+  } else if (options.makehardlinks) {
+    std::cout << dryruntext << "Now making hard links." << std::endl;
+    const auto tmp = gswd.makehardlinks(options.dryrun, options.threads);
+    std::cout << dryruntext << "Making " << tmp << " links." << std::endl;
+  } else if (options.deleteduplicates) {
+    std::cout << dryruntext << "Now deleting duplicates:" << std::endl;
+    const auto tmp = gswd.deleteduplicates(options.dryrun, options.threads);
+    std::cout << dryruntext << "Deleted " << tmp << " files." << std::endl;
+  } else if (options.dedupextents) {
+    std::cout << dryruntext << "Now sharing the extents of duplicates."
+              << std::endl;
+    gswd.dedupextents(options.dryrun, options.threads)
+      .report(std::cout, dryruntext);
+  }
+  return 0;
+}
@@ -0,0 +1,36 @@
+/*
+   copyright 2026 Paul Dreik
+   Distributed under GPL v 2.0 or later, at your option.
+   See LICENSE for further details.
+
+   taking the action on the duplicates of an earlier run.
+ */
+#ifndef RDFIND_APPLYRESULTS_HH_
+#define RDFIND_APPLYRESULTS_HH_
+
+#include <string>
+
+struct Options;
+
+/**
+ * takes the action asked for by the options on the duplicates listed in the
+ * results file options.applyfile, made by an earlier run, without
+ * traversing or reading the files again. the results file may have been
+ * edited, for instance to remove sets which shall be left alone.
+ *
+ * each listed file is checked with lstat to still be a regular file with
+ * the size, device and inode of the results file, and not be changed since.
+ * the binary format has the change time of each file, which has to be the
+ * same. otherwise, the file must not be modified after the results file,
+ * which says little if it was edited, so the files are only replaced or
+ * deleted with options.applyverify. files which do not pass are skipped, and
+ * their whole set if it is the original. with options.applyverify, the
+ * contents of each duplicate are also compared to its original. an original
+ * on another node, from -mergemanifests, is not checked and its duplicates
+ * are only deleted.
+ * @return zero on success
+ */
+int
+applyresults(const Options& options, const std::string& dryruntext);
+
+#endif /* RDFIND_APPLYRESULTS_HH_ */
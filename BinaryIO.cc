@@ -0,0 +1,166 @@
+/*
+   copyright 2026 Paul Dreik
+   Distributed under GPL v 2.0 or later, at your option.
+   See LICENSE for further details.
+*/
+
+#include "config.h"
+
+// std
+#include <algorithm>
+#include <array>
+#include <istream>
+#include <limits>
+#include <ostream>
+
+// project
+#include "BinaryIO.hh"
+
+namespace {
+template<typename T>
+std::array<char, sizeof(T)>
+toLittleEndian(T value)
+{
+  std::array<char, sizeof(T)> ret{};
+  for (auto& c : ret) {
+    c = static_cast<char>(value & 0xFF);
+    value = static_cast<T>(value >> 8);
+  }
+  return ret;
+}
+
+template<typename T>
+T
+fromLittleEndian(const std::array<char, sizeof(T)>& bytes)
+{
+  T ret{};
+  for (std::size_t i = sizeof(T); i > 0; --i) {
+    ret = static_cast<T>(ret << 8);
+    ret = static_cast<T>(ret | static_cast<unsigned char>(bytes[i - 1]));
+  }
+  return ret;
+}
+} // namespace
+
+void
+BinaryWriter::writeU8(std::uint8_t value)
+{
+  m_out.put(static_cast<char>(value));
+}
+
+void
+BinaryWriter::writeU32(std::uint32_t value)
+{
+  const auto bytes = toLittleEndian(value);
+  m_out.write(bytes.data(), bytes.size());
+}
+
+void
+BinaryWriter::writeU64(std::uint64_t value)
+{
+  const auto bytes = toLittleEndian(value);
+  m_out.write(bytes.data(), bytes.size());
+}
+
+void
+BinaryWriter::writeI64(std::int64_t value)
+{
+  writeU64(static_cast<std::uint64_t>(value));
+}
+
+void
+BinaryWriter::writeString(const std::string& value)
+{
+  if (value.size() > std::numeric_limits<std::uint32_t>::max()) {
+    m_out.setstate(std::ios_base::failbit);
+    return;
+  }
+  writeU32(static_cast<std::uint32_t>(value.size()));
+  writeBytes(value.data(), value.size());
+}
+
+void
+BinaryWriter::writeBytes(const void* data, std::size_t length)
+{
+  m_out.write(static_cast<const char*>(data),
+              static_cast<std::streamsize>(length));
+}
+
+bool
+BinaryWriter::good() const
+{
+  return m_out.good();
+}
+
+bool
+BinaryReader::readU8(std::uint8_t& value)
+{
+  char c{};
+  if (!m_in.get(c)) {
+    return false;
+  }
+  value = static_cast<std::uint8_t>(c);
+  return true;
+}
+
+bool
+BinaryReader::readU32(std::uint32_t& value)
+{
+  std::array<char, sizeof(value)> bytes;
+  if (!readBytes(bytes.data(), bytes.size())) {
+    return false;
+  }
+  value = fromLittleEndian<std::uint32_t>(bytes);
+  return true;
+}
+
+bool
+BinaryReader::readU64(std::uint64_t& value)
+{
+  std::array<char, sizeof(value)> bytes;
+  if (!readBytes(bytes.data(), bytes.size())) {
+    return false;
+  }
+  value = fromLittleEndian<std::uint64_t>(bytes);
+  return true;
+}
+
+bool
+BinaryReader::readI64(std::int64_t& value)
+{
+  std::uint64_t tmp{};
+  if (!readU64(tmp)) {
+    return false;
+  }
+  value = static_cast<std::int64_t>(tmp);
+  return true;
+}
+
+bool
+BinaryReader::readString(std::string& value)
+{
+  std::uint32_t length{};
+  if (!readU32(length)) {
+    return false;
+  }
+  // read in pieces, so a damaged length runs into the end of the stream
+  // instead of allocating all of it first
+  constexpr std::size_t piece = 4096;
+  value.clear();
+  while (value.size() < length) {
+    const auto offset = value.size();
+    const auto n = std::min<std::size_t>(piece, length - offset);
+    value.resize(offset + n);
+    if (!readBytes(value.data() + offset, n)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool
+BinaryReader::readBytes(void* data, std::size_t length)
+{
+  m_in.read(static_cast<char*>(data), static_cast<std::streamsize>(length));
+  return static_cast<std::size_t>(m_in.gcount()) == length;
+}
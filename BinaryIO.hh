@@ -0,0 +1,64 @@
+/*
+   copyright 2026 Paul Dreik
+   Distributed under GPL v 2.0 or later, at your option.
+   See LICENSE for further details.
+*/
+#ifndef RDFIND_BINARYIO_HH_
+#define RDFIND_BINARYIO_HH_
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+
+/**
+ * Writes the binary files rdfind keeps between runs. Integers are stored
+ * in little endian byte order, strings as a 32 bit length followed by the
+ * characters. Errors are sticky, check good() when done.
+ */
+class BinaryWriter
+{
+public:
+  explicit BinaryWriter(std::ostream& out)
+    : m_out(out)
+  {
+  }
+
+  void writeU8(std::uint8_t value);
+  void writeU32(std::uint32_t value);
+  void writeU64(std::uint64_t value);
+  void writeI64(std::int64_t value);
+  void writeString(const std::string& value);
+  void writeBytes(const void* data, std::size_t length);
+
+  bool good() const;
+
+private:
+  std::ostream& m_out;
+};
+
+/**
+ * Reads what BinaryWriter wrote. Each read function returns false if the
+ * value could not be read completely, for instance because the file was
+ * truncated.
+ */
+class BinaryReader
+{
+public:
+  explicit BinaryReader(std::istream& in)
+    : m_in(in)
+  {
+  }
+
+  bool readU8(std::uint8_t& value);
+  bool readU32(std::uint32_t& value);
+  bool readU64(std::uint64_t& value);
+  bool readI64(std::int64_t& value);
+  bool readString(std::string& value);
+  bool readBytes(void* data, std::size_t length);
+
+private:
+  std::istream& m_in;
+};
+
+#endif /* RDFIND_BINARYIO_HH_ */
@@ -0,0 +1,376 @@
+/*
+   copyright 2026 Paul Dreik
+   Distributed under GPL v 2.0 or later, at your option.
+   See LICENSE for further details.
+*/
+
+#include "config.h"
+
+// std
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+// os
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// project
+#include "BinaryIO.hh"
+#include "Checkpoint.hh"
+#include "Options.hh"
+
+namespace {
+// identifies the file format. bump the version if the layout changes.
+constexpr char magic[] = "RDFINDCP";
+constexpr std::uint32_t version = 1;
+
+// the kinds of records in the journal
+enum recordtype : std::uint8_t
+{
+  RECORD_SETTINGS = 1,
+  RECORD_FILE = 2,
+  RECORD_FILELIST_DONE = 3,
+  RECORD_BUFFER = 4,
+  RECORD_STAGE_DONE = 5,
+};
+
+// write a batch when it has this many records, or is this old
+constexpr std::size_t max_batch_records = 4096;
+constexpr auto max_batch_age = std::chrono::seconds(5);
+
+/// the options which affect what the buffers mean. a journal can only be
+/// resumed with the same settings as it was made.
+void
+writesettings(BinaryWriter& writer, const Options& options)
+{
+  writer.writeU64(options.first_bytes_size);
+  writer.writeU64(options.last_bytes_size);
+  writer.writeU8(
+    static_cast<std::uint8_t>(options.checksum_for_firstlast_bytes));
+  const std::uint8_t flags =
+    static_cast<std::uint8_t>((options.usemd5 ? 1U : 0U) |
+                              (options.usesha1 ? 2U : 0U) |
+                              (options.usesha256 ? 4U : 0U) |
+                              (options.usesha512 ? 8U : 0U) |
+                              (options.usexxh128 ? 16U : 0U) |
+                              (options.nochecksum ? 32U : 0U));
+  writer.writeU8(flags);
+}
+
+std::uint8_t
+modetobyte(Fileinfo::readtobuffermode mode)
+{
+  return static_cast<std::uint8_t>(static_cast<signed char>(mode));
+}
+
+Fileinfo::readtobuffermode
+bytetomode(std::uint8_t byte)
+{
+  return static_cast<Fileinfo::readtobuffermode>(
+    static_cast<signed char>(byte));
+}
+} // namespace
+
+Checkpoint::~Checkpoint()
+{
+  if (m_fd >= 0) {
+    flush();
+    close(m_fd);
+  }
+}
+
+int
+Checkpoint::create(const std::string& filename, const Options& options)
+{
+  m_filename = filename;
+  m_fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+  if (m_fd < 0) {
+    std::cerr << "could not open checkpoint file \"" << filename
+              << "\": " << std::strerror(errno) << '\n';
+    return -1;
+  }
+  BinaryWriter writer(m_batch);
+  writer.writeBytes(magic, sizeof(magic) - 1);
+  writer.writeU32(version);
+
+  beginrecord(RECORD_SETTINGS);
+  BinaryWriter settings(m_record);
+  writesettings(settings, options);
+  endrecord();
+  return flush();
+}
+
+int
+Checkpoint::resume(const std::string& filename,
+                   const Options& options,
+                   std::vector<Fileinfo>& list)
+{
+  std::uint64_t validlength = 0;
+  if (0 != replay(filename, options, list, validlength)) {
+    return -1;
+  }
+
+  m_filename = filename;
+  m_fd = open(filename.c_str(), O_WRONLY | O_APPEND);
+  if (m_fd < 0) {
+    std::cerr << "could not open checkpoint file \"" << filename
+              << "\": " << std::strerror(errno) << '\n';
+    return -1;
+  }
+  // get rid of a partially written record at the end, so appended records
+  // can be read back.
+  if (0 != ftruncate(m_fd, static_cast<off_t>(validlength))) {
+    std::cerr << "could not truncate checkpoint file \"" << filename
+              << "\": " << std::strerror(errno) << '\n';
+    return -1;
+  }
+  return 0;
+}
+
+int
+Checkpoint::replay(const std::string& filename,
+                   const Options& options,
+                   std::vector<Fileinfo>& list,
+                   std::uint64_t& validlength)
+{
+  std::ifstream in(filename, std::ios_base::binary);
+  if (!in.is_open()) {
+    std::cerr << "could not open checkpoint file \"" << filename << "\"\n";
+    return -1;
+  }
+  BinaryReader reader(in);
+  char filemagic[sizeof(magic) - 1];
+  std::uint32_t fileversion{};
+  if (!reader.readBytes(filemagic, sizeof(filemagic)) ||
+      !std::equal(filemagic, filemagic + sizeof(filemagic), magic) ||
+      !reader.readU32(fileversion) || fileversion != version) {
+    std::cerr << "\"" << filename << "\" is not a checkpoint file\n";
+    return -1;
+  }
+
+  std::ostringstream expected;
+  {
+    BinaryWriter settings(expected);
+    writesettings(settings, options);
+  }
+
+  std::vector<Fileinfo> files;
+  bool havesettings = false;
+  bool havefilelist = false;
+  std::string payload;
+  for (;;) {
+    validlength = static_cast<std::uint64_t>(in.tellg());
+    std::uint8_t type{};
+    std::uint32_t length{};
+    payload.resize(0);
+    if (!reader.readU8(type) || !reader.readU32(length)) {
+      break;
+    }
+    payload.resize(length);
+    if (!reader.readBytes(payload.data(), payload.size())) {
+      break;
+    }
+    std::istringstream record(payload);
+    BinaryReader fields(record);
+
+    if (!havesettings) {
+      if (type != RECORD_SETTINGS || payload != expected.str()) {
+        std::cerr << "checkpoint file \"" << filename
+                  << "\" was made with different checksum or first/last "
+                     "bytes options, can not resume\n";
+        return -1;
+      }
+      havesettings = true;
+      continue;
+    }
+
+    switch (type) {
+      case RECORD_FILE: {
+        std::int64_t identity{}, cmdline_index{}, depth{}, size{};
+        std::uint64_t device{}, inode{};
+        std::string name;
+        if (!fields.readI64(identity) || !fields.readI64(cmdline_index) ||
+            !fields.readI64(depth) || !fields.readI64(size) ||
+            !fields.readU64(device) || !fields.readU64(inode) ||
+            !fields.readString(name)) {
+          return -1;
+        }
+        Fileinfo file(std::move(name),
+                      static_cast<int>(cmdline_index),
+                      static_cast<int>(depth));
+        struct stat info
+        {};
+        info.st_mode = S_IFREG;
+        info.st_size = size;
+        info.st_dev = device;
+        info.st_ino = inode;
+        file.setfileinfo(info);
+        file.setidentity(identity);
+        files.push_back(std::move(file));
+      } break;
+      case RECORD_FILELIST_DONE:
+        list = std::move(files);
+        files.clear();
+        havefilelist = true;
+        break;
+      case RECORD_BUFFER: {
+        std::uint8_t mode{};
+        std::int64_t identity{};
+        std::string bytes;
+        if (!fields.readU8(mode) || !fields.readI64(identity) ||
+            !fields.readString(bytes)) {
+          return -1;
+        }
+        m_buffers[bytetomode(mode)][identity] = std::move(bytes);
+      } break;
+      case RECORD_STAGE_DONE: {
+        std::uint8_t mode{};
+        if (!fields.readU8(mode)) {
+          return -1;
+        }
+        m_stagesdone.push_back(bytetomode(mode));
+      } break;
+      default:
+        std::cerr << "unknown record in checkpoint file \"" << filename
+                  << "\"\n";
+        return -1;
+    }
+  }
+
+  if (!havesettings || !havefilelist) {
+    std::cerr << "checkpoint \"" << filename
+              << "\" was made before scanning finished, there is nothing to "
+                 "resume. run again without -resume.\n";
+    return -1;
+  }
+  return 0;
+}
+
+void
+Checkpoint::recordfilelist(const std::vector<Fileinfo>& list)
+{
+  if (m_fd < 0) {
+    return;
+  }
+  for (const auto& file : list) {
+    beginrecord(RECORD_FILE);
+    BinaryWriter writer(m_record);
+    writer.writeI64(file.getidentity());
+    writer.writeI64(file.get_cmdline_index());
+    writer.writeI64(file.depth());
+    writer.writeI64(file.size());
+    writer.writeU64(file.device());
+    writer.writeU64(file.inode());
+    writer.writeString(file.name());
+    endrecord();
+  }
+  beginrecord(RECORD_FILELIST_DONE);
+  BinaryWriter(m_record).writeU64(list.size());
+  endrecord();
+  flush();
+}
+
+void
+Checkpoint::recordbuffer(const Fileinfo& file, Fileinfo::readtobuffermode mode)
+{
+  if (m_fd < 0) {
+    return;
+  }
+  beginrecord(RECORD_BUFFER);
+  BinaryWriter writer(m_record);
+  writer.writeU8(modetobyte(mode));
+  writer.writeI64(file.getidentity());
+  writer.writeString(std::string(file.getbyteptr(), file.getbuffersize()));
+  endrecord();
+
+  if (m_batchrecords >= max_batch_records ||
+      std::chrono::steady_clock::now() - m_lastflush > max_batch_age) {
+    flush();
+  }
+}
+
+bool
+Checkpoint::restorebuffer(Fileinfo& file, Fileinfo::readtobuffermode mode) const
+{
+  const auto permode = m_buffers.find(mode);
+  if (permode == m_buffers.end()) {
+    return false;
+  }
+  const auto it = permode->second.find(file.getidentity());
+  if (it == permode->second.end() || it->second.size() != file.getbuffersize()) {
+    return false;
+  }
+  file.setbytes(it->second.data(), it->second.size());
+  return true;
+}
+
+void
+Checkpoint::recordstagedone(Fileinfo::readtobuffermode mode)
+{
+  if (m_fd < 0) {
+    return;
+  }
+  beginrecord(RECORD_STAGE_DONE);
+  BinaryWriter(m_record).writeU8(modetobyte(mode));
+  endrecord();
+  flush();
+}
+
+bool
+Checkpoint::stagedone(Fileinfo::readtobuffermode mode) const
+{
+  return std::find(m_stagesdone.begin(), m_stagesdone.end(), mode) !=
+         m_stagesdone.end();
+}
+
+int
+Checkpoint::flush()
+{
+  m_lastflush = std::chrono::steady_clock::now();
+  if (m_fd < 0 || m_failed) {
+    return -1;
+  }
+  const std::string data = m_batch.str();
+  m_batch.str(std::string());
+  m_batchrecords = 0;
+
+  std::size_t written = 0;
+  while (written < data.size()) {
+    const auto ret = write(m_fd, data.data() + written, data.size() - written);
+    if (ret < 0 && errno == EINTR) {
+      continue;
+    }
+    if (ret < 0) {
+      std::cerr << "failed writing to checkpoint file \"" << m_filename
+                << "\": " << std::strerror(errno)
+                << ". no more checkpoints will be made.\n";
+      m_failed = true;
+      return -1;
+    }
+    written += static_cast<std::size_t>(ret);
+  }
+  // make sure the batch survives a crash of the machine, not only of rdfind
+  fdatasync(m_fd);
+  return 0;
+}
+
+void
+Checkpoint::beginrecord(std::uint8_t type)
+{
+  m_record.str(std::string());
+  BinaryWriter(m_batch).writeU8(type);
+}
+
+void
+Checkpoint::endrecord()
+{
+  const std::string payload = m_record.str();
+  BinaryWriter writer(m_batch);
+  writer.writeU32(static_cast<std::uint32_t>(payload.size()));
+  writer.writeBytes(payload.data(), payload.size());
+  ++m_batchrecords;
+}
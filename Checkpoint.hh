@@ -0,0 +1,104 @@
+/*
+   copyright 2026 Paul Dreik
+   Distributed under GPL v 2.0 or later, at your option.
+   See LICENSE for further details.
+*/
+#ifndef RDFIND_CHECKPOINT_HH_
+#define RDFIND_CHECKPOINT_HH_
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Fileinfo.hh"
+
+struct Options;
+
+/**
+ * An append only journal of the progress made, so that an interrupted run
+ * can be resumed instead of starting over.
+ *
+ * The journal holds the list of duplicate candidates as it is before the
+ * first elimination stage, followed by the buffer of each file as it is
+ * read during the stages. Records are written in batches, a batch is
+ * written when it is large enough, a few seconds old or a stage finished.
+ * A truncated record at the end, for instance after a crash, is ignored.
+ */
+class Checkpoint
+{
+public:
+  Checkpoint() = default;
+  Checkpoint(const Checkpoint&) = delete;
+  Checkpoint& operator=(const Checkpoint&) = delete;
+  ~Checkpoint();
+
+  /**
+   * starts a new journal, replacing the file if it exists.
+   * @return zero on success
+   */
+  int create(const std::string& filename, const Options& options);
+
+  /**
+   * reads a journal written by an earlier run and opens it for appending.
+   * @param list receives the candidates
+   * @return zero on success. it is an error if the options affecting the
+   * buffers differ from the earlier run, or if it did not finish scanning.
+   */
+  int resume(const std::string& filename,
+             const Options& options,
+             std::vector<Fileinfo>& list);
+
+  /// records the candidates, before the first elimination stage
+  void recordfilelist(const std::vector<Fileinfo>& list);
+
+  /// records the buffer of a file, after it was read in the given mode
+  void recordbuffer(const Fileinfo& file, Fileinfo::readtobuffermode mode);
+
+  /**
+   * gives a file the buffer it got in an earlier run.
+   * @return true if the buffer was known
+   */
+  bool restorebuffer(Fileinfo& file, Fileinfo::readtobuffermode mode) const;
+
+  /// records that a stage is finished, and writes the pending batch
+  void recordstagedone(Fileinfo::readtobuffermode mode);
+
+  /// true if an earlier run finished the stage
+  bool stagedone(Fileinfo::readtobuffermode mode) const;
+
+  /**
+   * writes the pending batch to the journal
+   * @return zero on success
+   */
+  int flush();
+
+private:
+  void beginrecord(std::uint8_t type);
+  void endrecord();
+  int replay(const std::string& filename,
+             const Options& options,
+             std::vector<Fileinfo>& list,
+             std::uint64_t& validlength);
+
+  std::string m_filename;
+  int m_fd = -1;
+  // records not yet written to the journal
+  std::ostringstream m_batch;
+  // the record currently being made
+  std::ostringstream m_record;
+  std::size_t m_batchrecords = 0;
+  std::chrono::steady_clock::time_point m_lastflush;
+  bool m_failed = false;
+
+  // what earlier runs found out, per read mode and file identity
+  std::map<Fileinfo::readtobuffermode,
+           std::unordered_map<std::int64_t, std::string>>
+    m_buffers;
+  std::vector<Fileinfo::readtobuffermode> m_stagesdone;
+};
+
+#endif /* RDFIND_CHECKPOINT_HH_ */
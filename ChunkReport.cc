@@ -0,0 +1,240 @@
+/*
+   copyright 2026 Paul Dreik
+   Distributed under GPL v 2.0 or later, at your option.
+   See LICENSE for further details.
+*/
+
+#include "config.h"
+
+// std
+#include <algorithm>
+#include <cerrno>
+#include <fstream>
+#include <iostream>
+#include <optional>
+
+// os
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// project
+#include "ChunkReport.hh"
+#include "Fileinfo.hh"
+#include "Options.hh"
+#include "PageCache.hh"
+#include "Throttle.hh"
+
+ChunkReport::ChunkReport(const Options& options)
+  : m_chunker(options.chunksize)
+  , m_checksum(options.checksum_for_firstlast_bytes)
+  , m_keepranges(options.dedupextents)
+  , m_options(options)
+  , m_buffer(std::max(options.buffersize, 2 * m_chunker.maxsize()))
+{
+}
+
+int
+ChunkReport::add(const Fileinfo& file)
+{
+  const auto index = static_cast<std::uint32_t>(m_files.size());
+  m_files.push_back(&file);
+
+  throttleopen(m_options);
+  const int fd = open(file.name().c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    std::cerr << "could not open \"" << file.name() << "\" for reading\n";
+    return -1;
+  }
+  std::optional<CacheKeeper> keeper;
+  if (m_options.cacheneutral) {
+    keeper.emplace(fd, 0, static_cast<std::uint64_t>(file.size()), true);
+  }
+
+  // the buffer is refilled when less than the longest chunk is left in it,
+  // so each chunk is cut from one piece of memory.
+  auto& buffer = m_buffer;
+  std::size_t start = 0;
+  std::size_t filled = 0;
+  std::uint64_t offset = 0; // of buffer[start] in the file
+  std::uint64_t readoffset = 0;
+  bool eof = false;
+  for (;;) {
+    if (!eof && filled - start < m_chunker.maxsize()) {
+      std::copy(buffer.begin() + static_cast<std::ptrdiff_t>(start),
+                buffer.begin() + static_cast<std::ptrdiff_t>(filled),
+                buffer.begin());
+      filled -= start;
+      start = 0;
+      while (filled < buffer.size()) {
+        const auto n =
+          read(fd, buffer.data() + filled, buffer.size() - filled);
+        if (n < 0 && errno == EINTR) {
+          continue;
+        }
+        if (n < 0) {
+          std::cerr << "failed reading \"" << file.name() << "\"\n";
+          keeper.reset();
+          close(fd);
+          return -1;
+        }
+        if (n == 0) {
+          eof = true;
+          break;
+        }
+        throttleread(m_options, static_cast<std::uint64_t>(n));
+        filled += static_cast<std::size_t>(n);
+        readoffset += static_cast<std::uint64_t>(n);
+        if (keeper) {
+          keeper->release(readoffset);
+        }
+      }
+    }
+    if (start == filled) {
+      break;
+    }
+    const auto length = m_chunker.cut(buffer.data() + start, filled - start);
+    addchunk(buffer.data() + start, length, index, offset);
+    start += length;
+    offset += length;
+  }
+  keeper.reset();
+  close(fd);
+  return 0;
+}
+
+void
+ChunkReport::addchunk(const unsigned char* data,
+                      std::size_t length,
+                      std::uint32_t file,
+                      std::uint64_t offset)
+{
+  ++m_chunks;
+  m_bytes += length;
+
+  // the digest is cut to 16 bytes, which is what xxh128 gives
+  unsigned char full[64];
+  m_checksum.reset();
+  m_checksum.update(length, data);
+  m_checksum.printToBuffer(full, sizeof(full));
+  Digest digest;
+  std::copy(full, full + digest.size(), digest.begin());
+
+  const auto [it, inserted] = m_index.try_emplace(digest, Location{});
+  if (inserted) {
+    it->second.file = file;
+    it->second.offset = offset;
+    return;
+  }
+  // a chunk repeated within a file can not be shared with another
+  const auto& first = it->second;
+  if (first.file == file) {
+    return;
+  }
+  m_sharedbytes += length;
+  auto& pair = m_pairs[std::make_pair(first.file, file)];
+  pair.shared += length;
+  if (m_keepranges) {
+    // chunks following each other in both files make one range
+    auto& ranges = pair.ranges;
+    if (!ranges.empty() &&
+        ranges.back().source + ranges.back().length == first.offset &&
+        ranges.back().destination + ranges.back().length == offset) {
+      ranges.back().length += length;
+    } else {
+      ranges.push_back({ first.offset, offset, length });
+    }
+  }
+}
+
+int
+ChunkReport::write(const std::string& filename) const
+{
+  std::vector<const decltype(m_pairs)::value_type*> sorted;
+  sorted.reserve(m_pairs.size());
+  for (const auto& entry : m_pairs) {
+    sorted.push_back(&entry);
+  }
+  std::stable_sort(
+    sorted.begin(), sorted.end(), [](const auto* a, const auto* b) {
+      return a->second.shared > b->second.shared;
+    });
+
+  std::ofstream out(filename, std::ios_base::trunc);
+  if (!out.is_open()) {
+    std::cerr << "could not open \"" << filename << "\" for writing\n";
+    return -1;
+  }
+  out << "# Automatically generated\n";
+  out << "# chunks of " << m_chunker.averagesize()
+      << " bytes on average, the first file is the better ranked\n";
+  out << "# shared size name size name\n";
+  for (const auto* entry : sorted) {
+    const auto& first = *m_files[entry->first.first];
+    const auto& second = *m_files[entry->first.second];
+    out << entry->second.shared << '\t' << first.size() << '\t'
+        << first.name() << '\t' << second.size() << '\t' << second.name()
+        << '\n';
+  }
+  out << "# end of file\n";
+  out.flush();
+  if (!out.good()) {
+    std::cerr << "failed writing \"" << filename << "\"\n";
+    return -1;
+  }
+  return 0;
+}
+
+DedupSummary
+ChunkReport::dedup(bool dryrun) const
+{
+  DedupSummary summary;
+  std::vector<SharedRange> aligned;
+  for (const auto& [files, pair] : m_pairs) {
+    const auto& source = m_files[files.first]->name();
+    const auto& destination = m_files[files.second]->name();
+
+    struct stat info
+    {};
+    std::uint64_t blocksize = 4096;
+    if (stat(destination.c_str(), &info) == 0 && info.st_blksize > 0) {
+      blocksize = static_cast<std::uint64_t>(info.st_blksize);
+    }
+
+    // each range is shrunk to the whole blocks it covers, which is only
+    // possible if it starts at the same place within a block in both files
+    aligned.clear();
+    std::uint64_t length = 0;
+    for (const auto& range : pair.ranges) {
+      if (range.source % blocksize != range.destination % blocksize) {
+        continue;
+      }
+      const auto skip =
+        (blocksize - range.destination % blocksize) % blocksize;
+      if (range.length <= skip) {
+        continue;
+      }
+      const auto blocks = (range.length - skip) / blocksize * blocksize;
+      if (blocks == 0) {
+        continue;
+      }
+      aligned.push_back(
+        { range.source + skip, range.destination + skip, blocks });
+      length += blocks;
+    }
+    if (length == 0) {
+      continue;
+    }
+
+    if (dryrun) {
+      std::cout << "(DRYRUN MODE) share " << length << " bytes of "
+                << destination << " with " << source << '\n';
+      ++summary.shared;
+      summary.bytes += length;
+      continue;
+    }
+    summary.add(dedupranges(source, destination, aligned), length);
+  }
+  std::cout.flush();
+  return summary;
+}
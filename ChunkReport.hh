@@ -0,0 +1,116 @@
+/*
+   copyright 2026 Paul Dreik
+   Distributed under GPL v 2.0 or later, at your option.
+   See LICENSE for further details.
+*/
+#ifndef RDFIND_CHUNKREPORT_HH_
+#define RDFIND_CHUNKREPORT_HH_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iosfwd>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Checksum.hh"
+#include "Chunker.hh"
+#include "ExtentDedup.hh"
+
+class Fileinfo;
+struct Options;
+
+/**
+ * Finds the parts files have in common, also when they are not duplicates
+ * as a whole. Each file is cut into chunks with Chunker, and the digest of
+ * each chunk is looked up among the chunks seen before. A chunk seen before
+ * counts as shared between the file it was first seen in and this one, so
+ * with files added in ranking order each chunk is credited to the best
+ * ranked file holding it.
+ *
+ * The index keeps about 70 bytes for each distinct chunk in memory.
+ */
+class ChunkReport
+{
+public:
+  explicit ChunkReport(const Options& options);
+
+  /**
+   * reads the file and adds its chunks. the file has to outlive this.
+   * @return zero on success
+   */
+  int add(const Fileinfo& file);
+
+  /// the number of bytes and chunks read so far
+  std::uint64_t bytes() const { return m_bytes; }
+  std::uint64_t chunks() const { return m_chunks; }
+  /// the number of bytes in chunks seen before
+  std::uint64_t sharedbytes() const { return m_sharedbytes; }
+  /// the number of pairs of files with chunks in common
+  std::size_t pairs() const { return m_pairs.size(); }
+
+  /**
+   * writes the bytes each pair of files has in common to filename, the
+   * pair with the most first.
+   * @return zero on success
+   */
+  int write(const std::string& filename) const;
+
+  /**
+   * makes the parts of the second file of each pair share the extents of
+   * the same contents in the first file. only the whole blocks of each part
+   * can be shared.
+   */
+  DedupSummary dedup(bool dryrun) const;
+
+private:
+  using Digest = std::array<unsigned char, 16>;
+  struct DigestHash
+  {
+    std::size_t operator()(const Digest& digest) const
+    {
+      std::size_t hash;
+      std::memcpy(&hash, digest.data(), sizeof(hash));
+      return hash;
+    }
+  };
+
+  // where a chunk was first seen
+  struct Location
+  {
+    std::uint32_t file = 0;
+    std::uint64_t offset = 0;
+  };
+
+  // what two files have in common
+  struct Pair
+  {
+    std::uint64_t shared = 0;
+    std::vector<SharedRange> ranges; // only kept for dedup
+  };
+
+  /// adds the chunk at offset within the file with the given index
+  void addchunk(const unsigned char* data,
+                std::size_t length,
+                std::uint32_t file,
+                std::uint64_t offset);
+
+  Chunker m_chunker;
+  Checksum m_checksum;
+  bool m_keepranges;
+  const Options& m_options;
+  std::vector<unsigned char> m_buffer;
+  std::vector<const Fileinfo*> m_files;
+  std::unordered_map<Digest, Location, DigestHash> m_index;
+  // on the index of the first and second file
+  std::map<std::pair<std::uint32_t, std::uint32_t>, Pair> m_pairs;
+  std::uint64_t m_bytes = 0;
+  std::uint64_t m_chunks = 0;
+  std::uint64_t m_sharedbytes = 0;
+};
+
+#endif /* RDFIND_CHUNKREPORT_HH_ */
@@ -0,0 +1,82 @@
+/*
+   copyright 2026 Paul Dreik
+   Distributed under GPL v 2.0 or later, at your option.
+   See LICENSE for further details.
+*/
+
+#include "config.h"
+
+// std
+#include <algorithm>
+#include <array>
+#include <cassert>
+
+// project
+#include "Chunker.hh"
+
+namespace {
+// a random number for each byte value, from splitmix64 with a fixed seed so
+// the cut points are the same between runs and machines.
+constexpr std::array<std::uint64_t, 256> geartable = [] {
+  std::array<std::uint64_t, 256> table{};
+  std::uint64_t state = 0;
+  for (auto& entry : table) {
+    state += 0x9E3779B97F4A7C15;
+    std::uint64_t z = state;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+    entry = z ^ (z >> 31);
+  }
+  return table;
+}();
+
+// a mask of the highest bits, which depend on the last 64 bytes rolled
+constexpr std::uint64_t
+highbits(unsigned count)
+{
+  return ~std::uint64_t{ 0 } << (64 - count);
+}
+} // namespace
+
+Chunker::Chunker(std::size_t averagesize)
+  : m_minsize(averagesize / 4)
+  , m_averagesize(averagesize)
+  , m_maxsize(averagesize * 8)
+{
+  assert(averagesize >= 64 && (averagesize & (averagesize - 1)) == 0);
+  unsigned bits = 0;
+  while ((std::size_t{ 1 } << bits) < averagesize) {
+    ++bits;
+  }
+  // two bits more and less than the average needs, as FastCDC suggests
+  m_strictmask = highbits(bits + 2);
+  m_loosemask = highbits(bits - 2);
+}
+
+std::size_t
+Chunker::cut(const unsigned char* data, std::size_t length) const
+{
+  if (length <= m_minsize) {
+    return length;
+  }
+  const std::size_t end = std::min(length, m_maxsize);
+  const std::size_t normal = std::min(end, m_averagesize);
+
+  // the bytes before the minimum size can not end the chunk, and only the
+  // last 64 bytes count, so the hash starts at the minimum size.
+  std::uint64_t hash = 0;
+  std::size_t i = m_minsize;
+  for (; i < normal; ++i) {
+    hash = (hash << 1) + geartable[data[i]];
+    if ((hash & m_strictmask) == 0) {
+      return i + 1;
+    }
+  }
+  for (; i < end; ++i) {
+    hash = (hash << 1) + geartable[data[i]];
+    if ((hash & m_loosemask) == 0) {
+      return i + 1;
+    }
+  }
+  return end;
+}
@@ -0,0 +1,48 @@
+/*
+   copyright 2026 Paul Dreik
+   Distributed under GPL v 2.0 or later, at your option.
+   See LICENSE for further details.
+*/
+#ifndef RDFIND_CHUNKER_HH_
+#define RDFIND_CHUNKER_HH_
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Cuts data into chunks at positions decided by the contents, so an insert
+ * or a removal only changes the chunks around it. This is FastCDC: a gear
+ * hash is rolled over the bytes, one shift, one table lookup and one add
+ * per byte, and a chunk ends where the hash has zeros in the bits of a
+ * mask. The first quarter of the average size is skipped, a stricter mask
+ * is used up to the average size and a looser one after it, which keeps
+ * most chunks close to the average. No chunk is longer than eight times the
+ * average.
+ */
+class Chunker
+{
+public:
+  /// @param averagesize a power of two, at least 64
+  explicit Chunker(std::size_t averagesize);
+
+  std::size_t minsize() const { return m_minsize; }
+  std::size_t averagesize() const { return m_averagesize; }
+  std::size_t maxsize() const { return m_maxsize; }
+
+  /**
+   * finds where the chunk starting at data ends. length has to be at least
+   * maxsize(), unless data ends there.
+   * @return the length of the chunk, at most length
+   */
+  [[gnu::pure]] std::size_t cut(const unsigned char* data,
+                                std::size_t length) const;
+
+private:
+  std::size_t m_minsize;
+  std::size_t m_averagesize;
+  std::size_t m_maxsize;
+  std::uint64_t m_strictmask;
+  std::uint64_t m_loosemask;
+};
+
+#endif /* RDFIND_CHUNKER_HH_ */
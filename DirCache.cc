@@ -0,0 +1,188 @@
+/*
+   copyright 2026 Paul Dreik
+   Distributed under GPL v 2.0 or later, at your option.
+   See LICENSE for further details.
+*/
+
+#include "config.h"
+
+// std
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+// project
+#include "BinaryIO.hh"
+#include "DirCache.hh"
+
+namespace {
+// identifies the file format. bump the version if the layout changes.
+constexpr char magic[] = "RDFINDDC";
+constexpr std::uint32_t version = 1;
+} // namespace
+
+DirCache::DirCache(std::int64_t maxage)
+  : m_maxage(maxage)
+  , m_now(std::time(nullptr))
+{
+}
+
+int
+DirCache::load(const std::string& filename)
+{
+  std::ifstream in(filename, std::ios_base::binary);
+  if (!in.is_open()) {
+    // first run, nothing cached yet.
+    return 0;
+  }
+
+  BinaryReader reader(in);
+  char filemagic[sizeof(magic) - 1];
+  std::uint32_t fileversion{};
+  std::uint64_t nlistings{};
+  if (!reader.readBytes(filemagic, sizeof(filemagic)) ||
+      !std::equal(filemagic, filemagic + sizeof(filemagic), magic) ||
+      !reader.readU32(fileversion) || fileversion != version ||
+      !reader.readU64(nlistings)) {
+    std::cerr << "ignoring directory cache \"" << filename
+              << "\", it is not in the expected format\n";
+    return -1;
+  }
+
+  for (std::uint64_t i = 0; i < nlistings; ++i) {
+    key k;
+    Listing listing;
+    std::uint64_t nentries{};
+    if (!reader.readU64(k.first) || !reader.readU64(k.second) ||
+        !reader.readI64(listing.mtime_sec) ||
+        !reader.readI64(listing.mtime_nsec) ||
+        !reader.readI64(listing.ctime_sec) ||
+        !reader.readI64(listing.ctime_nsec) ||
+        !reader.readI64(listing.verified) || !reader.readU64(nentries)) {
+      break;
+    }
+    bool ok = true;
+    for (std::uint64_t j = 0; ok && j < nentries; ++j) {
+      Entry e;
+      std::uint8_t type{};
+      ok = reader.readString(e.name) && reader.readU8(type) &&
+           reader.readU64(e.size) && reader.readU64(e.device) &&
+           reader.readU64(e.inode);
+      e.type = static_cast<entrytype>(type);
+      listing.entries.push_back(std::move(e));
+    }
+    if (!ok) {
+      break;
+    }
+    m_previous.emplace(k, std::move(listing));
+  }
+
+  if (m_previous.size() != nlistings) {
+    std::cerr << "directory cache \"" << filename
+              << "\" is truncated, using the " << m_previous.size()
+              << " complete listings\n";
+  }
+  return 0;
+}
+
+int
+DirCache::save(const std::string& filename) const
+{
+  // write to a temporary and rename it into place, so an interrupted run
+  // does not leave a damaged cache behind.
+  const std::string tempname = filename + ".tmp";
+  {
+    std::ofstream out(tempname, std::ios_base::binary | std::ios_base::trunc);
+    if (!out.is_open()) {
+      std::cerr << "could not open directory cache \"" << tempname
+                << "\" for writing\n";
+      return -1;
+    }
+    BinaryWriter writer(out);
+    writer.writeBytes(magic, sizeof(magic) - 1);
+    writer.writeU32(version);
+    writer.writeU64(m_current.size());
+    for (const auto& [k, listing] : m_current) {
+      writer.writeU64(k.first);
+      writer.writeU64(k.second);
+      writer.writeI64(listing.mtime_sec);
+      writer.writeI64(listing.mtime_nsec);
+      writer.writeI64(listing.ctime_sec);
+      writer.writeI64(listing.ctime_nsec);
+      writer.writeI64(listing.verified);
+      writer.writeU64(listing.entries.size());
+      for (const auto& e : listing.entries) {
+        writer.writeString(e.name);
+        writer.writeU8(static_cast<std::uint8_t>(e.type));
+        writer.writeU64(e.size);
+        writer.writeU64(e.device);
+        writer.writeU64(e.inode);
+      }
+    }
+    out.flush();
+    if (!writer.good()) {
+      std::cerr << "failed writing directory cache \"" << tempname << "\"\n";
+      std::remove(tempname.c_str());
+      return -1;
+    }
+  }
+  if (0 != std::rename(tempname.c_str(), filename.c_str())) {
+    std::cerr << "failed moving directory cache into place as \"" << filename
+              << "\"\n";
+    return -1;
+  }
+  return 0;
+}
+
+const std::vector<DirCache::Entry>*
+DirCache::lookup(const struct stat& dirinfo)
+{
+  const key k{ dirinfo.st_dev, dirinfo.st_ino };
+
+  // a directory may be reached more than once, for instance if given twice on
+  // the command line.
+  if (auto it = m_current.find(k); it != m_current.end()) {
+    ++m_hits;
+    return &it->second.entries;
+  }
+
+  auto it = m_previous.find(k);
+  if (it == m_previous.end()) {
+    ++m_misses;
+    return nullptr;
+  }
+  const Listing& listing = it->second;
+  const bool unchanged = listing.mtime_sec == dirinfo.st_mtim.tv_sec &&
+                         listing.mtime_nsec == dirinfo.st_mtim.tv_nsec &&
+                         listing.ctime_sec == dirinfo.st_ctim.tv_sec &&
+                         listing.ctime_nsec == dirinfo.st_ctim.tv_nsec;
+  // a directory changed during the same second as it was listed may have
+  // been modified after the listing without its timestamps revealing it.
+  const bool racy = listing.ctime_sec >= listing.verified ||
+                    listing.mtime_sec >= listing.verified;
+  const bool expired = m_maxage >= 0 && m_now - listing.verified >= m_maxage;
+  if (!unchanged || racy || expired) {
+    ++m_misses;
+    return nullptr;
+  }
+
+  ++m_hits;
+  auto inserted = m_current.emplace(k, std::move(it->second));
+  m_previous.erase(it);
+  return &inserted.first->second.entries;
+}
+
+void
+DirCache::store(const struct stat& dirinfo, std::vector<Entry> entries)
+{
+  Listing listing;
+  listing.mtime_sec = dirinfo.st_mtim.tv_sec;
+  listing.mtime_nsec = dirinfo.st_mtim.tv_nsec;
+  listing.ctime_sec = dirinfo.st_ctim.tv_sec;
+  listing.ctime_nsec = dirinfo.st_ctim.tv_nsec;
+  listing.verified = m_now;
+  listing.entries = std::move(entries);
+  m_current.insert_or_assign(key{ dirinfo.st_dev, dirinfo.st_ino },
+                             std::move(listing));
+}
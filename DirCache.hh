@@ -0,0 +1,114 @@
+/*
+   copyright 2026 Paul Dreik
+   Distributed under GPL v 2.0 or later, at your option.
+   See LICENSE for further details.
+*/
+#ifndef RDFIND_DIRCACHE_HH_
+#define RDFIND_DIRCACHE_HH_
+
+#include <cstdint>
+#include <ctime>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+// os specific headers
+#include <sys/stat.h>
+
+/**
+ * Persisted directory listings, so that directories which did not change
+ * since the previous run do not have to be listed (readdir) and have their
+ * entries examined (lstat) again.
+ *
+ * A listing is identified by the device and inode of the directory and is
+ * considered valid as long as the modification and status change times of the
+ * directory are unchanged. Note that modifying a file in place does not
+ * change the directory, so the cached size of such a file will be stale until
+ * the listing expires. Use a max age to get periodic full verification.
+ */
+class DirCache
+{
+public:
+  /// the kind of entries that are remembered
+  enum class entrytype : std::uint8_t
+  {
+    REGULAR_FILE = 0,
+    DIRECTORY = 1,
+    SYMLINK = 2,
+  };
+
+  /// a directory entry, with the stat information that rdfind uses
+  struct Entry
+  {
+    std::string name;
+    entrytype type{};
+    std::uint64_t size{};
+    std::uint64_t device{};
+    std::uint64_t inode{};
+  };
+
+  /**
+   * @param maxage listings verified this many seconds ago or earlier are
+   * not used, zero means none are used. negative means no limit.
+   */
+  explicit DirCache(std::int64_t maxage);
+
+  /**
+   * reads a cache file written by save(). a missing file is not an error.
+   * @return zero on success
+   */
+  int load(const std::string& filename);
+
+  /**
+   * writes the listings used or stored during this run. listings of
+   * directories that were not visited are dropped.
+   * @return zero on success
+   */
+  int save(const std::string& filename) const;
+
+  /**
+   * looks up the listing of a directory.
+   * @param dirinfo stat of the directory
+   * @return the entries, or nullptr if there is no valid listing.
+   */
+  const std::vector<Entry>* lookup(const struct stat& dirinfo);
+
+  /**
+   * stores the listing of a directory
+   * @param dirinfo stat of the directory, taken before it was listed.
+   * @param entries
+   */
+  void store(const struct stat& dirinfo, std::vector<Entry> entries);
+
+  /// number of directories that were replayed from the cache
+  std::size_t hits() const { return m_hits; }
+
+  /// number of directories that had to be listed
+  std::size_t misses() const { return m_misses; }
+
+private:
+  struct Listing
+  {
+    std::int64_t mtime_sec{};
+    std::int64_t mtime_nsec{};
+    std::int64_t ctime_sec{};
+    std::int64_t ctime_nsec{};
+    // when the listing was made, seconds since epoch
+    std::int64_t verified{};
+    std::vector<Entry> entries;
+  };
+
+  using key = std::pair<std::uint64_t, std::uint64_t>; // device, inode
+
+  std::int64_t m_maxage;
+  std::int64_t m_now;
+  // what was read by load()
+  std::map<key, Listing> m_previous;
+  // what will be written by save()
+  std::map<key, Listing> m_current;
+  std::size_t m_hits{};
+  std::size_t m_misses{};
+};
+
+#endif /* RDFIND_DIRCACHE_HH_ */
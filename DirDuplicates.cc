@@ -0,0 +1,557 @@
+/*
+   copyright 2026 Paul Dreik
+   Distributed under GPL v 2.0 or later, at your option.
+   See LICENSE for further details.
+*/
+
+#include "config.h"
+
+// std
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <tuple>
+
+// os
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h> //for renameat
+#include <unistd.h>
+
+// project
+#include "Checksum.hh"
+#include "DirDuplicates.hh"
+#include "EasyRandom.hh"
+#include "Options.hh"
+#include "Rdutil.hh"
+
+namespace {
+/// splits path into the directory it is in and its name there
+bool
+splitpath(const std::string& path, std::string& dir, std::string& entry)
+{
+  const auto last_sep = path.find_last_of('/');
+  if (last_sep == std::string::npos) {
+    return false;
+  }
+  dir = last_sep == 0 ? "/" : path.substr(0, last_sep);
+  entry = path.substr(last_sep + 1);
+  return true;
+}
+
+std::string
+join(const std::string& dir, const std::string& entry)
+{
+  return dir == "/" ? "/" + entry : dir + "/" + entry;
+}
+
+/**
+ * compares paths one name at a time, so a directory and the same path
+ * within it compare like the directory does against another.
+ */
+bool
+cmpPath(const std::string& a, const std::string& b)
+{
+  return std::lexicographical_compare(
+    a.begin(), a.end(), b.begin(), b.end(), [](char x, char y) {
+      const auto ux = x == '/' ? 0 : static_cast<unsigned char>(x) + 1;
+      const auto uy = y == '/' ? 0 : static_cast<unsigned char>(y) + 1;
+      return ux < uy;
+    });
+}
+
+/// true if name in dirfd is an empty directory, of which info is filled in
+bool
+emptydirectory(int dirfd, const char* name, struct stat& info)
+{
+  const int fd =
+    openat(dirfd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+  if (0 != fstat(fd, &info)) {
+    close(fd);
+    return false;
+  }
+  DIR* dirp = fdopendir(fd);
+  if (dirp == nullptr) {
+    close(fd);
+    return false;
+  }
+  bool empty = true;
+  while (const struct dirent* dp = readdir(dirp)) {
+    if (0 != std::strcmp(".", dp->d_name) &&
+        0 != std::strcmp("..", dp->d_name)) {
+      empty = false;
+      break;
+    }
+  }
+  (void)closedir(dirp);
+  return empty;
+}
+
+/**
+ * invokes f(dirfd, entry) with the directory path is in opened, and the name
+ * of path in it.
+ */
+template<typename Function>
+int
+inparent(const std::string& path, Function f)
+{
+  std::string dir;
+  std::string entry;
+  if (!splitpath(path, dir, entry)) {
+    return f(AT_FDCWD, path);
+  }
+  const int dirfd = open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (dirfd < 0) {
+    std::cerr << "Failed opening directory " << dir << ": "
+              << std::strerror(errno) << '\n';
+    return -1;
+  }
+  const int ret = f(dirfd, entry);
+  close(dirfd);
+  return ret;
+}
+} // namespace
+
+std::size_t
+DirDuplicates::find(const std::vector<Fileinfo>& list, const Options& options)
+{
+  m_nodes.clear();
+  m_directories.clear();
+  m_files = 0;
+  m_bytes = 0;
+
+  // the directories of the files, and the ones above them up to the one the
+  // files were found in
+  std::int64_t maxidentity = 0;
+  for (std::size_t i = 0; i < list.size(); ++i) {
+    const auto& file = list[i];
+    maxidentity = std::max(maxidentity, file.getidentity());
+    std::string dir;
+    std::string entry;
+    if (!splitpath(file.name(), dir, entry)) {
+      continue;
+    }
+    const auto inserted = m_nodes.emplace(dir, Node{});
+    Node& node = inserted.first->second;
+    node.files.emplace(entry, i);
+    if (!inserted.second) {
+      if (node.cmdline_index != file.get_cmdline_index() ||
+          node.depth != file.depth()) {
+        node.consistent = false;
+      }
+      // the directories above are known already
+      continue;
+    }
+    node.cmdline_index = file.get_cmdline_index();
+    node.depth = file.depth();
+    for (int depth = file.depth() - 1; depth >= 0; --depth) {
+      std::string parent;
+      if (!splitpath(dir, parent, entry)) {
+        break;
+      }
+      const auto above = m_nodes.emplace(parent, Node{});
+      above.first->second.subdirs.insert(entry);
+      if (!above.second) {
+        break;
+      }
+      above.first->second.cmdline_index = file.get_cmdline_index();
+      above.first->second.depth = depth;
+      dir = parent;
+    }
+  }
+
+  // a name is longer than the name of the directory it is in, so the
+  // directories within come first.
+  using Iterator = decltype(m_nodes.begin());
+  std::vector<Iterator> order;
+  order.reserve(m_nodes.size());
+  for (auto it = m_nodes.begin(); it != m_nodes.end(); ++it) {
+    order.push_back(it);
+  }
+  std::sort(order.begin(), order.end(), [](Iterator a, Iterator b) {
+    return a->first.size() > b->first.size();
+  });
+
+  // the hash of the last stage, so the digest of a directory is as long as
+  // the digest of a file
+  const auto stages = Rdutil::stages(options);
+  Checksum checksum(stages.empty()
+                      ? options.checksum_for_firstlast_bytes
+                      : Rdutil::checksumtypefor(stages.back().first, options));
+  const auto digestlength =
+    static_cast<std::size_t>(checksum.getDigestLength());
+
+  std::map<std::string, std::vector<Iterator>> bydigest;
+  for (const auto it : order) {
+    const auto& path = it->first;
+    Node& node = it->second;
+    node.complete = node.consistent && listdirectory(path, node, list);
+    if (!node.complete) {
+      continue;
+    }
+
+    // the entries on name, both maps are sorted on it
+    checksum.reset();
+    auto file = node.files.cbegin();
+    auto subdir = node.subdirs.cbegin();
+    while (file != node.files.cend() || subdir != node.subdirs.cend()) {
+      const bool isfile = subdir == node.subdirs.cend() ||
+                          (file != node.files.cend() && file->first < *subdir);
+      const std::string& name = isfile ? file->first : *subdir;
+      checksum.update(name.size() + 1, name.c_str());
+      if (isfile) {
+        const auto& f = list[file->second];
+        const auto size = static_cast<std::uint64_t>(f.size());
+        checksum.update(1, "f");
+        checksum.update(sizeof(size), reinterpret_cast<const char*>(&size));
+        checksum.update(f.getbuffersize(), f.getbyteptr());
+        ++node.nfiles;
+        node.bytes += size;
+        ++file;
+      } else {
+        const Node& child = m_nodes.at(join(path, name));
+        // the empty directories found by listing have no digest
+        checksum.update(1, child.digest.empty() ? "e" : "d");
+        checksum.update(child.digest.size(), child.digest.data());
+        node.nfiles += child.nfiles;
+        node.bytes += child.bytes;
+        ++subdir;
+      }
+    }
+    node.digest.resize(digestlength);
+    checksum.printToBuffer(node.digest.data(), node.digest.size());
+    if (node.nfiles > 0) {
+      bydigest[node.digest].push_back(it);
+    }
+  }
+
+  // rank the directories of each set like files, and mark the duplicates
+  auto cmpRank = [](Iterator a, Iterator b) {
+    const auto ranka = std::tie(a->second.cmdline_index, a->second.depth);
+    const auto rankb = std::tie(b->second.cmdline_index, b->second.depth);
+    if (ranka != rankb) {
+      return ranka < rankb;
+    }
+    return cmpPath(a->first, b->first);
+  };
+  std::vector<std::vector<Iterator>> sets;
+  for (auto& entry : bydigest) {
+    auto& members = entry.second;
+    if (members.size() < 2) {
+      continue;
+    }
+    std::sort(members.begin(), members.end(), cmpRank);
+    for (auto it = members.begin() + 1; it != members.end(); ++it) {
+      (*it)->second.removed = true;
+    }
+    sets.push_back(std::move(members));
+  }
+
+  // the directories within a duplicate go with it, so the ones above come
+  // first here. a duplicate within another duplicate is not reported.
+  std::map<std::string, bool> reported;
+  for (auto it = order.rbegin(); it != order.rend(); ++it) {
+    std::string parent;
+    std::string entry;
+    const bool abovegone = splitpath((*it)->first, parent, entry) &&
+                           m_nodes.count(parent) != 0 &&
+                           m_nodes.at(parent).removed;
+    reported[(*it)->first] = (*it)->second.removed && !abovegone;
+    (*it)->second.removed = (*it)->second.removed || abovegone;
+  }
+
+  // the sets are written in the order of the size of the directories, like
+  // the files are
+  std::stable_sort(sets.begin(),
+                   sets.end(),
+                   [](const std::vector<Iterator>& a,
+                      const std::vector<Iterator>& b) {
+                     return a.front()->second.bytes < b.front()->second.bytes;
+                   });
+
+  auto record = [](Iterator it) {
+    const Node& node = it->second;
+    Fileinfo dir(it->first + "/", node.cmdline_index, node.depth);
+    auto info = node.info;
+    info.st_size = static_cast<off_t>(node.bytes);
+    dir.setfileinfo(info);
+    dir.setbytes(node.digest.data(), node.digest.size());
+    return dir;
+  };
+  std::size_t nreported = 0;
+  std::int64_t identity = maxidentity;
+  for (const auto& members : sets) {
+    const auto original = members.front();
+    // the original of a set is never within a duplicate: the original of
+    // that one has a copy of it, which ranks before it.
+    if (original->second.removed) {
+      continue;
+    }
+    const auto first = m_directories.size();
+    for (auto it = members.begin() + 1; it != members.end(); ++it) {
+      if (!reported[(*it)->first]) {
+        continue;
+      }
+      if (m_directories.size() == first) {
+        ++identity;
+        m_directories.push_back(record(original));
+        m_directories.back().setidentity(identity);
+        m_directories.back().setduptype(
+          Fileinfo::duptype::DUPTYPE_FIRST_OCCURRENCE);
+      }
+      m_directories.push_back(record(*it));
+      m_directories.back().setidentity(-identity);
+      m_directories.back().setduptype(
+        (*it)->second.cmdline_index == original->second.cmdline_index
+          ? Fileinfo::duptype::DUPTYPE_WITHIN_SAME_TREE
+          : Fileinfo::duptype::DUPTYPE_OUTSIDE_TREE);
+      m_files += (*it)->second.nfiles;
+      m_bytes += (*it)->second.bytes;
+      ++nreported;
+    }
+  }
+  return nreported;
+}
+
+bool
+DirDuplicates::listdirectory(const std::string& path,
+                             Node& node,
+                             const std::vector<Fileinfo>& list)
+{
+  // these can not be removed, or are in more than one place
+  const auto last_sep = path.find_last_of('/');
+  const auto name =
+    last_sep == std::string::npos ? path : path.substr(last_sep + 1);
+  if (name.empty() || name == "." || name == "..") {
+    return false;
+  }
+
+  // a directory within which is not complete makes this one incomplete, no
+  // need to list it
+  for (const auto& subdir : node.subdirs) {
+    const auto child = m_nodes.find(join(path, subdir));
+    if (child == m_nodes.end() || !child->second.complete) {
+      return false;
+    }
+  }
+
+  const int fd =
+    open(path.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+  if (0 != fstat(fd, &node.info)) {
+    close(fd);
+    return false;
+  }
+  DIR* dirp = fdopendir(fd);
+  if (dirp == nullptr) {
+    close(fd);
+    return false;
+  }
+
+  const auto expected = node.files.size() + node.subdirs.size();
+  std::size_t seen = 0;
+  bool complete = true;
+  while (complete) {
+    const struct dirent* dp = readdir(dirp);
+    if (dp == nullptr) {
+      break;
+    }
+    if (0 == std::strcmp(".", dp->d_name) ||
+        0 == std::strcmp("..", dp->d_name)) {
+      continue;
+    }
+
+    // the type and inode of the entry. the inode of a mount point is the
+    // one of the directory below it, so mount points do not match.
+    struct stat info
+    {};
+#ifdef _DIRENT_HAVE_D_TYPE
+    const bool known = dp->d_type != DT_UNKNOWN;
+#else
+    const bool known = false;
+#endif
+    if (known) {
+#ifdef _DIRENT_HAVE_D_TYPE
+      info.st_mode = DTTOIF(dp->d_type);
+#endif
+      info.st_ino = dp->d_ino;
+    } else if (0 != fstatat(fd, dp->d_name, &info, AT_SYMLINK_NOFOLLOW)) {
+      complete = false;
+      continue;
+    }
+
+    const auto file = node.files.find(dp->d_name);
+    if (file != node.files.end()) {
+      // it must still be the regular file which was compared
+      const auto& f = list[file->second];
+      complete = S_ISREG(info.st_mode) && info.st_ino == f.inode() &&
+                 f.device() == node.info.st_dev;
+      ++seen;
+    } else if (node.subdirs.count(dp->d_name) != 0) {
+      const Node& child = m_nodes.at(join(path, dp->d_name));
+      complete = S_ISDIR(info.st_mode) && info.st_ino == child.info.st_ino &&
+                 child.info.st_dev == node.info.st_dev;
+      ++seen;
+    } else if (S_ISDIR(info.st_mode)) {
+      // an empty directory is part of the tree, anything else is unknown
+      struct stat subinfo
+      {};
+      complete = emptydirectory(fd, dp->d_name, subinfo) &&
+                 subinfo.st_dev == node.info.st_dev &&
+                 subinfo.st_ino == info.st_ino;
+      if (complete) {
+        Node empty;
+        empty.cmdline_index = node.cmdline_index;
+        empty.depth = node.depth + 1;
+        empty.complete = true;
+        empty.info = subinfo;
+        m_nodes.emplace(join(path, dp->d_name), std::move(empty));
+        node.subdirs.insert(dp->d_name);
+      }
+    } else {
+      complete = false;
+    }
+  }
+  (void)closedir(dirp);
+  return complete && seen == expected;
+}
+
+std::size_t
+DirDuplicates::prune(std::vector<Fileinfo>& list) const
+{
+  const auto before = list.size();
+  list.erase(std::remove_if(list.begin(),
+                            list.end(),
+                            [this](const Fileinfo& file) {
+                              std::string dir;
+                              std::string entry;
+                              if (!splitpath(file.name(), dir, entry)) {
+                                return false;
+                              }
+                              const auto it = m_nodes.find(dir);
+                              return it != m_nodes.end() &&
+                                     it->second.removed;
+                            }),
+             list.end());
+  return before - list.size();
+}
+
+int
+DirDuplicates::removetree(int dirfd,
+                          const std::string& entry,
+                          const std::string& path) const
+{
+  const auto it = m_nodes.find(path);
+  if (it == m_nodes.end()) {
+    return -1;
+  }
+  const Node& node = it->second;
+  const int fd = openat(
+    dirfd, entry.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+  if (fd < 0) {
+    std::cerr << "Failed opening directory " << path << ": "
+              << std::strerror(errno) << '\n';
+    return -1;
+  }
+  int ret = 0;
+  for (const auto& file : node.files) {
+    if (0 != unlinkat(fd, file.first.c_str(), 0)) {
+      std::cerr << "Failed deleting file " << join(path, file.first) << '\n';
+      ret = -1;
+    }
+  }
+  for (const auto& subdir : node.subdirs) {
+    if (0 != removetree(fd, subdir, join(path, subdir))) {
+      ret = -1;
+    }
+  }
+  close(fd);
+  if (ret == 0 && 0 != unlinkat(dirfd, entry.c_str(), AT_REMOVEDIR)) {
+    std::cerr << "Failed deleting directory " << path << ": "
+              << std::strerror(errno) << '\n';
+    ret = -1;
+  }
+  return ret;
+}
+
+std::size_t
+DirDuplicates::deleteduplicates(bool dryrun) const
+{
+  std::size_t ndeleted = 0;
+  for (const auto& dir : m_directories) {
+    if (dir.getduptype() == Fileinfo::duptype::DUPTYPE_FIRST_OCCURRENCE) {
+      continue;
+    }
+    const auto path = dir.name().substr(0, dir.name().size() - 1);
+    if (dryrun) {
+      std::cout << "(DRYRUN MODE) delete directory " << path << '\n';
+      ++ndeleted;
+      continue;
+    }
+    const int ret = inparent(path, [&](int dirfd, const std::string& entry) {
+      return removetree(dirfd, entry, path);
+    });
+    if (ret == 0) {
+      ++ndeleted;
+    }
+  }
+  std::cout.flush();
+  return ndeleted;
+}
+
+std::size_t
+DirDuplicates::makesymlinks(bool dryrun) const
+{
+  // the targets are made absolute with the same directory for all
+  std::string cwd;
+  Fileinfo::currentdirectory(cwd);
+
+  std::size_t nreplaced = 0;
+  std::string original;
+  for (const auto& dir : m_directories) {
+    const auto path = dir.name().substr(0, dir.name().size() - 1);
+    if (dir.getduptype() == Fileinfo::duptype::DUPTYPE_FIRST_OCCURRENCE) {
+      original = path;
+      continue;
+    }
+    if (dryrun) {
+      std::cout << "(DRYRUN MODE) symlink directory " << path << " to "
+                << original << '\n';
+      ++nreplaced;
+      continue;
+    }
+    const std::string target =
+      original.front() == '/' || cwd.empty() ? original : cwd + "/" + original;
+    const int ret = inparent(path, [&](int dirfd, const std::string& entry) {
+      // the directory is moved aside first, so it can be put back if the
+      // symlink can not be made.
+      const std::string aside = EasyRandom().makeRandomFileString();
+      if (0 != renameat(dirfd, entry.c_str(), dirfd, aside.c_str())) {
+        std::cerr << "Failed renaming directory " << path << ": "
+                  << std::strerror(errno) << '\n';
+        return -1;
+      }
+      if (0 != symlinkat(target.c_str(), dirfd, entry.c_str())) {
+        std::cerr << "Failed to make symlink " << path << " to " << original
+                  << ": " << std::strerror(errno) << '\n';
+        if (0 != renameat(dirfd, aside.c_str(), dirfd, entry.c_str())) {
+          std::cerr << "Failed renaming directory " << path << " back from "
+                    << aside << '\n';
+        }
+        return -1;
+      }
+      return removetree(dirfd, aside, path);
+    });
+    if (ret == 0) {
+      ++nreplaced;
+    }
+  }
+  std::cout.flush();
+  return nreplaced;
+}
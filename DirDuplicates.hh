@@ -0,0 +1,117 @@
+/*
+   copyright 2026 Paul Dreik
+   Distributed under GPL v 2.0 or later, at your option.
+   See LICENSE for further details.
+*/
+#ifndef RDFIND_DIRDUPLICATES_HH_
+#define RDFIND_DIRDUPLICATES_HH_
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+// os
+#include <sys/stat.h>
+
+#include "Fileinfo.hh"
+
+struct Options;
+
+/**
+ * Finds directories with identical trees, once the files in them have been
+ * compared. Each directory gets a Merkle hash over its entries sorted on
+ * name: the name, size and buffer of each file, and the name and hash of
+ * each directory. Directories with the same hash have the same contents.
+ *
+ * Only a directory of which every entry is a file among the duplicates, or
+ * such a directory, can be a duplicate. It is listed again to make sure
+ * nothing else is in it: a file which was skipped or has no duplicate, a
+ * symlink, a mount point or anything else makes it and the directories
+ * above it unique.
+ *
+ * Directories are ranked like files, on the command line index, the depth
+ * and then the name. The duplicates within a duplicate directory are not
+ * reported on their own, they go with the directory.
+ */
+class DirDuplicates
+{
+public:
+  /**
+   * hashes the directories holding the files in list, which must be sorted
+   * on size and buffer with only duplicates left, as after the last stage.
+   * @return the number of duplicate directories, not counting the ones
+   * within another
+   */
+  std::size_t find(const std::vector<Fileinfo>& list, const Options& options);
+
+  /**
+   * removes the files within the duplicate directories from list. the
+   * files left without duplicates are not removed.
+   * @return the number of files removed
+   */
+  std::size_t prune(std::vector<Fileinfo>& list) const;
+
+  /**
+   * the sets of duplicate directories, marked like files with the original
+   * first. the names end with a slash, and the size is the sum of the sizes
+   * of the files within.
+   */
+  const std::vector<Fileinfo>& directories() const { return m_directories; }
+
+  /// the number of files and bytes within the duplicate directories
+  std::size_t files() const { return m_files; }
+  std::uint64_t bytes() const { return m_bytes; }
+
+  /**
+   * deletes the duplicate directories, with the files and directories they
+   * were found to have. anything else makes the deletion fail.
+   * @return the number of directories deleted
+   */
+  std::size_t deleteduplicates(bool dryrun) const;
+
+  /**
+   * replaces the duplicate directories with symlinks to their originals. the
+   * directory is renamed, a symlink made in its place and the renamed
+   * directory deleted as with deleteduplicates.
+   * @return the number of directories replaced
+   */
+  std::size_t makesymlinks(bool dryrun) const;
+
+private:
+  struct Node
+  {
+    // the entries which are files, by position in the list given to find
+    std::map<std::string, std::size_t> files;
+    std::set<std::string> subdirs; // the entries which are directories
+    int cmdline_index = 0;
+    int depth = 0;
+    bool consistent = true; // all files have the same rank above
+    bool complete = false;  // nothing else is in the directory
+    bool removed = false;   // it or a directory above is a duplicate
+    struct stat info
+    {};
+    std::size_t nfiles = 0;
+    std::uint64_t bytes = 0;
+    std::string digest;
+  };
+
+  /// lists the directory to see if it holds nothing but the known entries
+  bool listdirectory(const std::string& path,
+                     Node& node,
+                     const std::vector<Fileinfo>& list);
+
+  /// removes path, by the name entry in dirfd, and all it was found to have
+  int removetree(int dirfd,
+                 const std::string& entry,
+                 const std::string& path) const;
+
+  std::map<std::string, Node> m_nodes;
+  std::vector<Fileinfo> m_directories;
+  std::size_t m_files = 0;
+  std::uint64_t m_bytes = 0;
+};
+
+#endif /* RDFIND_DIRDUPLICATES_HH_ */
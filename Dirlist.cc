@@ -7,10 +7,13 @@
 #include "config.h"
 
 // std
+#include <algorithm>
 #include <cerrno>
+#include <cstdint>
 #include <cstring>
 #include <iostream>
 #include <string>
+#include <vector>
 
 // os
 #include <dirent.h>
@@ -22,8 +25,6 @@
 #include "Dirlist.hh"
 #include "RdfindDebug.hh" //debug macros
 
-static const int maxdepth = 50;
-
 int
 Dirlist::walk(const std::string& dir, const int recursionlevel)
 {
@@ -31,9 +32,80 @@ Dirlist::walk(const std::string& dir, const int recursionlevel)
   RDDEBUG("Now in walk with dir=" << dir.c_str() << " and recursionlevel="
                                   << recursionlevel << std::endl);
 
-  if (recursionlevel >= maxdepth) {
-    std::cerr << "recursion limit exceeded\n";
-    return -1;
+  // each walk enters a directory at most once, no matter how many symlinks
+  // lead to it.
+  m_visited.clear();
+
+  // the directories left to enter, depth first. the stack is used instead of
+  // recursion, so the depth is only limited by memory. each directory is
+  // closed before entering the next, so no file descriptors are kept open.
+  std::vector<Frame> stack;
+  const int ret = enter(dir, recursionlevel, stack);
+  while (!stack.empty()) {
+    auto& top = stack.back();
+    if (top.next == top.subdirs.size()) {
+      stack.pop_back();
+      continue;
+    }
+    const std::string subdir = top.dir + "/" + top.subdirs[top.next++];
+    const int depth = top.depth + 1;
+    // may push to the stack, invalidating top
+    enter(subdir, depth, stack);
+  }
+  return ret;
+}
+
+bool
+Dirlist::firstvisit(const struct stat& dirinfo)
+{
+  if (m_visited.emplace(dirinfo.st_dev, dirinfo.st_ino).second) {
+    return true;
+  }
+  RDDEBUG("directory was entered before, skipping it" << std::endl);
+  return false;
+}
+
+void
+Dirlist::push(Frame frame, std::vector<Frame>& stack) const
+{
+  if (frame.subdirs.empty()) {
+    return;
+  }
+  if (m_sortsubdirs) {
+    std::sort(frame.subdirs.begin(), frame.subdirs.end());
+  }
+  stack.push_back(std::move(frame));
+}
+
+int
+Dirlist::enter(const std::string& dir,
+               const int recursionlevel,
+               std::vector<Frame>& stack)
+{
+  RDDEBUG("Now entering dir=" << dir.c_str() << " with recursionlevel="
+                              << recursionlevel << std::endl);
+
+  Frame frame{ dir, recursionlevel, {}, 0 };
+
+  // if there is a valid cached listing, use it instead of reading the
+  // directory. the stat must be done before listing, so a change made while
+  // listing is detected next time.
+  struct stat dirinfo;
+  const bool usecache = m_dircache && stat(dir.c_str(), &dirinfo) == 0 &&
+                        S_ISDIR(dirinfo.st_mode);
+  if (usecache) {
+    if (const auto* entries = m_dircache->lookup(dirinfo)) {
+      RDDEBUG("using cached listing" << std::endl);
+      if (!firstvisit(dirinfo)) {
+        return 2;
+      }
+      if (m_dircallback) {
+        (*m_dircallback)(dir, recursionlevel);
+      }
+      replay(dir, *entries, recursionlevel, frame.subdirs);
+      push(std::move(frame), stack);
+      return 2; // it's a directory
+    }
   }
 
   // open the directory
@@ -46,6 +118,20 @@ Dirlist::walk(const std::string& dir, const int recursionlevel)
     return 1; // it's a file (or something else)
   }
 
+  // the directory may have been reached through a symlink before
+  struct stat openedinfo;
+  if (fstat(dirfd(dirp), &openedinfo) == 0 && !firstvisit(openedinfo)) {
+    (void)closedir(dirp);
+    return 2;
+  }
+
+  if (m_dircallback) {
+    (*m_dircallback)(dir, recursionlevel);
+  }
+
+  // the listing to store in the cache, if there is one.
+  std::vector<DirCache::Entry> listing;
+
   // we opened the directory. let us read the content.
   RDDEBUG("opened directory" << std::endl);
   struct dirent* dp{};
@@ -54,6 +140,19 @@ Dirlist::walk(const std::string& dir, const int recursionlevel)
     if (0 == strcmp(".", dp->d_name) || 0 == strcmp("..", dp->d_name)) {
       continue;
     }
+    // skip excluded entries without looking at them. with a cache, they are
+    // looked at anyway, so the cached listing is complete for other filters.
+    const bool excluded = isexcluded(dir, dp->d_name);
+    if (excluded && !usecache) {
+      continue;
+    }
+#ifdef _DIRENT_HAVE_D_TYPE
+    // files not included can be skipped likewise, if the type is known
+    if (!usecache && dp->d_type == DT_REG && !isincluded(dir, dp->d_name)) {
+      continue;
+    }
+#endif
+
     // investigate what kind of file it is, don't follow any
     // symlinks when doing this (lstat instead of stat).
     struct stat info;
@@ -69,30 +168,94 @@ Dirlist::walk(const std::string& dir, const int recursionlevel)
 
     if (S_ISLNK(info.st_mode)) {
       // symlink
-      if (m_followsymlinks) {
-        (*m_callback)(dir, std::string(dp->d_name), recursionlevel);
+      if (usecache) {
+        listing.push_back({ dp->d_name, DirCache::entrytype::SYMLINK });
+      }
+      if (m_followsymlinks && !excluded) {
+        if (isincluded(dir, dp->d_name)) {
+          (*m_callback)(dir, std::string(dp->d_name), recursionlevel, nullptr);
+        }
         dowalk = true;
       }
     } else if (S_ISDIR(info.st_mode)) {
       // directory
-      dowalk = true;
+      if (usecache) {
+        listing.push_back({ dp->d_name, DirCache::entrytype::DIRECTORY });
+      }
+      dowalk = !excluded;
     } else if (S_ISREG(info.st_mode)) {
-      // regular file
-      (*m_callback)(dir, std::string(dp->d_name), recursionlevel);
+      // regular file. lstat and stat give the same answer, pass it on.
+      if (usecache) {
+        DirCache::Entry entry{ dp->d_name, DirCache::entrytype::REGULAR_FILE };
+        entry.size = static_cast<std::uint64_t>(info.st_size);
+        entry.device = info.st_dev;
+        entry.inode = info.st_ino;
+        listing.push_back(std::move(entry));
+      }
+      if (!excluded && isincluded(dir, dp->d_name)) {
+        (*m_callback)(dir, std::string(dp->d_name), recursionlevel, &info);
+      }
     }
 
-    // try to open directory
+    // enter the directory later
     if (dowalk) {
-      walk(dir + "/" + dp->d_name, recursionlevel + 1);
+      frame.subdirs.emplace_back(dp->d_name);
     }
 
   } // while
 
   // close the directory
   (void)closedir(dirp);
+
+  if (usecache) {
+    m_dircache->store(dirinfo, std::move(listing));
+  }
+  push(std::move(frame), stack);
   return 2; // it's a directory
 }
 
+void
+Dirlist::replay(const std::string& dir,
+                const std::vector<DirCache::Entry>& entries,
+                int recursionlevel,
+                std::vector<std::string>& subdirs)
+{
+  for (const auto& entry : entries) {
+    if (isexcluded(dir, entry.name.c_str())) {
+      continue;
+    }
+    bool dowalk = false;
+    switch (entry.type) {
+      case DirCache::entrytype::SYMLINK:
+        if (m_followsymlinks) {
+          if (isincluded(dir, entry.name.c_str())) {
+            (*m_callback)(dir, entry.name, recursionlevel, nullptr);
+          }
+          dowalk = true;
+        }
+        break;
+      case DirCache::entrytype::DIRECTORY:
+        dowalk = true;
+        break;
+      case DirCache::entrytype::REGULAR_FILE: {
+        if (!isincluded(dir, entry.name.c_str())) {
+          break;
+        }
+        struct stat info
+        {};
+        info.st_mode = S_IFREG;
+        info.st_size = static_cast<off_t>(entry.size);
+        info.st_dev = static_cast<dev_t>(entry.device);
+        info.st_ino = static_cast<ino_t>(entry.inode);
+        (*m_callback)(dir, entry.name, recursionlevel, &info);
+      } break;
+    }
+    if (dowalk) {
+      subdirs.push_back(entry.name);
+    }
+  }
+}
+
 // splits inputstring into path and filename. if no / character is found,
 // empty string is returned as path and filename is set to inputstring.
 int
@@ -149,7 +312,7 @@ Dirlist::handlepossiblefile(const std::string& possiblefile, int recursionlevel)
   if (S_ISLNK(info.st_mode)) {
     RDDEBUG("found symlink" << std::endl);
     if (m_followsymlinks) {
-      (*m_callback)(path, filename, recursionlevel);
+      (*m_callback)(path, filename, recursionlevel, nullptr);
     }
     return 0;
   } else {
@@ -171,7 +334,7 @@ Dirlist::handlepossiblefile(const std::string& possiblefile, int recursionlevel)
 
   if (S_ISREG(info.st_mode)) {
     RDDEBUG("it is a regular file" << std::endl);
-    (*m_callback)(path, filename, recursionlevel);
+    (*m_callback)(path, filename, recursionlevel, &info);
     return 0;
   } else {
     RDDEBUG("not a regular file" << std::endl);
@@ -7,7 +7,17 @@
 #ifndef Dirlist_hh
 #define Dirlist_hh
 
+#include <set>
 #include <string>
+#include <utility>
+#include <vector>
+
+// os
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "DirCache.hh"
+#include "PathFilter.hh"
 
 /// class that traverses a directory
 class Dirlist
@@ -17,6 +27,10 @@ public:
   explicit Dirlist(bool followsymlinks)
     : m_followsymlinks(followsymlinks)
     , m_callback(nullptr)
+    , m_dircallback(nullptr)
+    , m_dircache(nullptr)
+    , m_filter(nullptr)
+    , m_sortsubdirs(false)
   {
   }
 
@@ -25,23 +39,104 @@ private:
   bool m_followsymlinks;
 
   // where to report found files. this is called for every item in all
-  // directories found by walk.
-  typedef int (*reportfcntype)(const std::string&, const std::string&, int);
+  // directories found by walk. the last argument is the stat information of
+  // the item if it is already known, otherwise nullptr.
+  typedef int (*reportfcntype)(const std::string&,
+                               const std::string&,
+                               int,
+                               const struct stat*);
 
   // called when a regular file or a symlink is encountered
   reportfcntype m_callback;
 
+  // where to report directories, before their content is reported. the
+  // arguments are the path of the directory and the recursion level.
+  typedef void (*dirreportfcntype)(const std::string&, int);
+
+  // called when a directory is entered, may be nullptr
+  dirreportfcntype m_dircallback;
+
+  // optional cache of directory listings
+  DirCache* m_dircache;
+
+  // optional filter deciding which entries to skip
+  const PathFilter* m_filter;
+
+  // enter subdirectories in name order instead of filesystem order
+  bool m_sortsubdirs;
+
+  // true if the entry shall be skipped entirely
+  bool isexcluded(const std::string& dir, const char* name) const
+  {
+    return m_filter && m_filter->excluded(dir, name);
+  }
+
+  // true if the file shall be reported, given that it is not excluded
+  bool isincluded(const std::string& dir, const char* name) const
+  {
+    return !m_filter || m_filter->included(dir, name);
+  }
+
+  // a directory entered during the walk, with the subdirectories to enter
+  struct Frame
+  {
+    std::string dir;
+    int depth;
+    std::vector<std::string> subdirs;
+    std::size_t next;
+  };
+
+  // the directories entered during the current walk, by device and inode
+  std::set<std::pair<dev_t, ino_t>> m_visited;
+
+  // true if the directory was not entered before during this walk
+  bool firstvisit(const struct stat& dirinfo);
+
+  // pushes the frame to the stack, if it has subdirectories to enter
+  void push(Frame frame, std::vector<Frame>& stack) const;
+
+  // reports the content of a directory, and pushes a frame with its
+  // subdirectories to the stack if there are any. returns like walk.
+  int enter(const std::string& dir,
+            int recursionlevel,
+            std::vector<Frame>& stack);
+
+  // reports the items of a directory listing taken from the cache, and adds
+  // the directories to enter to subdirs
+  void replay(const std::string& dir,
+              const std::vector<DirCache::Entry>& entries,
+              int recursionlevel,
+              std::vector<std::string>& subdirs);
+
   // a function that is called from walk when a non-directory is encountered
   // for instance,if walk("/path/to/a/file.ext") is called instead of
   // walk("/path/to/a/")
   int handlepossiblefile(const std::string& possiblefile, int recursionlevel);
 
 public:
-  // find all files on a specific place
+  // find all files on a specific place. every directory is entered at most
+  // once, so symlinks pointing back up the tree are harmless.
   int walk(const std::string& dir, const int recursionlevel = 0);
 
   // to set the report functions
   void setcallbackfcn(reportfcntype reportfcn) { m_callback = reportfcn; }
+  void setdircallbackfcn(dirreportfcntype reportfcn)
+  {
+    m_dircallback = reportfcn;
+  }
+
+  // to use a cache of directory listings. may be nullptr.
+  void setdircache(DirCache* dircache) { m_dircache = dircache; }
+
+  // to skip entries. may be nullptr.
+  void setfilter(const PathFilter* filter)
+  {
+    m_filter = filter && filter->active() ? filter : nullptr;
+  }
+
+  // to enter subdirectories in name order. a directory reached through
+  // several symlinks is then found under the same name in every run.
+  void setsortsubdirs(bool sortsubdirs) { m_sortsubdirs = sortsubdirs; }
 };
 
 #endif
@@ -54,8 +54,8 @@ private:
 EasyRandom::GlobalRandom&
 EasyRandom::getGlobalObject()
 {
-  // thread safe (magic static)
-  static GlobalRandom global{};
+  // one per thread, so threads making temporary names do not race
+  static thread_local GlobalRandom global{};
   return global;
 }
 
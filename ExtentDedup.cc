@@ -0,0 +1,249 @@
+/*
+   copyright 2026 Paul Dreik
+   Distributed under GPL v 2.0 or later, at your option.
+   See LICENSE for further details.
+*/
+
+#include "config.h"
+
+// std
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <ostream>
+
+// os
+#include <fcntl.h>
+#include <unistd.h>
+#ifdef HAVE_LINUX_FS_H
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#endif
+
+// project
+#include "ExtentDedup.hh"
+#include "Fileinfo.hh"
+
+std::string
+DedupOutcome::describe(std::uint64_t size) const
+{
+  if (shared == size && !differs && error == 0) {
+    return {};
+  }
+  std::string text = shared == 0 ? "not shared"
+                                 : "shared " + std::to_string(shared) +
+                                     " of " + std::to_string(size) + " bytes";
+  if (differs) {
+    text += ", the contents differ";
+  }
+  if (error != 0) {
+    text += ": ";
+    text += std::strerror(error);
+  }
+  return text;
+}
+
+void
+DedupSummary::add(const DedupOutcome& outcome, std::uint64_t size)
+{
+  if (outcome.shared == size && !outcome.differs && outcome.error == 0) {
+    ++shared;
+  } else if (outcome.shared > 0) {
+    ++partly;
+  } else {
+    ++failed;
+  }
+  bytes += outcome.shared;
+}
+
+void
+DedupSummary::add(const DedupSummary& other)
+{
+  shared += other.shared;
+  partly += other.partly;
+  failed += other.failed;
+  bytes += other.bytes;
+}
+
+void
+DedupSummary::report(std::ostream& out, const std::string& dryruntext) const
+{
+  out << dryruntext << "Shared all extents of " << shared << " files, some of "
+      << partly << " and none of " << failed << ". " << bytes
+      << " bytes are shared now." << std::endl;
+}
+
+#if defined(HAVE_LINUX_FS_H) && defined(FIDEDUPERANGE)
+namespace {
+// btrfs shares at most this much per call, xfs more.
+constexpr std::uint64_t ChunkSize = 16 << 20;
+// the request has to fit in a page
+constexpr std::size_t MaxBatch = 64;
+} // namespace
+
+std::vector<DedupOutcome>
+dedupextents(const Fileinfo& original,
+             const std::vector<const Fileinfo*>& duplicates)
+{
+  std::vector<DedupOutcome> outcomes(duplicates.size());
+
+  const int srcfd = open(original.name().c_str(), O_RDONLY | O_CLOEXEC);
+  if (srcfd < 0) {
+    const int error = errno;
+    for (auto& outcome : outcomes) {
+      outcome.error = error;
+    }
+    return outcomes;
+  }
+
+  // a read only destination is only allowed for the owner of the file, so
+  // try to open it for writing first. it is not written to.
+  std::vector<int> fds(duplicates.size());
+  for (std::size_t i = 0; i < duplicates.size(); ++i) {
+    const char* name = duplicates[i]->name().c_str();
+    fds[i] = open(name, O_RDWR | O_CLOEXEC);
+    if (fds[i] < 0) {
+      fds[i] = open(name, O_RDONLY | O_CLOEXEC);
+    }
+    if (fds[i] < 0) {
+      outcomes[i].error = errno;
+    }
+  }
+
+  // the request ends with an array of a size only known here
+  std::vector<std::uint64_t> storage(
+    (sizeof(file_dedupe_range) + MaxBatch * sizeof(file_dedupe_range_info) +
+     sizeof(std::uint64_t) - 1) /
+    sizeof(std::uint64_t));
+  auto range = reinterpret_cast<file_dedupe_range*>(storage.data());
+
+  std::vector<std::size_t> batch;
+  const auto size = static_cast<std::uint64_t>(original.size());
+  for (std::uint64_t offset = 0; offset < size; offset += ChunkSize) {
+    const auto length = std::min(ChunkSize, size - offset);
+    std::size_t next = 0;
+    while (next < duplicates.size()) {
+      // the duplicates which have not failed yet
+      batch.clear();
+      for (; next < duplicates.size() && batch.size() < MaxBatch; ++next) {
+        if (outcomes[next].error == 0) {
+          batch.push_back(next);
+        }
+      }
+      if (batch.empty()) {
+        continue;
+      }
+
+      std::fill(storage.begin(), storage.end(), std::uint64_t{ 0 });
+      range->src_offset = offset;
+      range->src_length = length;
+      range->dest_count = static_cast<__u16>(batch.size());
+      for (std::size_t j = 0; j < batch.size(); ++j) {
+        range->info[j].dest_fd = fds[batch[j]];
+        range->info[j].dest_offset = offset;
+      }
+
+      if (0 != ioctl(srcfd, FIDEDUPERANGE, range)) {
+        const int error = errno;
+        for (const auto i : batch) {
+          outcomes[i].error = error;
+        }
+        continue;
+      }
+      for (std::size_t j = 0; j < batch.size(); ++j) {
+        const auto& info = range->info[j];
+        auto& outcome = outcomes[batch[j]];
+        if (info.status < 0) {
+          outcome.error = -info.status;
+        } else if (info.status == FILE_DEDUPE_RANGE_DIFFERS) {
+          outcome.differs = true;
+        } else {
+          outcome.shared += info.bytes_deduped;
+        }
+      }
+    }
+  }
+
+  for (const int fd : fds) {
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+  close(srcfd);
+  return outcomes;
+}
+
+DedupOutcome
+dedupranges(const std::string& source,
+            const std::string& destination,
+            const std::vector<SharedRange>& ranges)
+{
+  DedupOutcome outcome;
+  const int srcfd = open(source.c_str(), O_RDONLY | O_CLOEXEC);
+  if (srcfd < 0) {
+    outcome.error = errno;
+    return outcome;
+  }
+  int fd = open(destination.c_str(), O_RDWR | O_CLOEXEC);
+  if (fd < 0) {
+    fd = open(destination.c_str(), O_RDONLY | O_CLOEXEC);
+  }
+  if (fd < 0) {
+    outcome.error = errno;
+    close(srcfd);
+    return outcome;
+  }
+
+  std::vector<std::uint64_t> storage(
+    (sizeof(file_dedupe_range) + sizeof(file_dedupe_range_info) +
+     sizeof(std::uint64_t) - 1) /
+    sizeof(std::uint64_t));
+  auto range = reinterpret_cast<file_dedupe_range*>(storage.data());
+
+  for (const auto& shared : ranges) {
+    for (std::uint64_t done = 0;
+         done < shared.length && outcome.error == 0;
+         done += ChunkSize) {
+      std::fill(storage.begin(), storage.end(), std::uint64_t{ 0 });
+      range->src_offset = shared.source + done;
+      range->src_length = std::min(ChunkSize, shared.length - done);
+      range->dest_count = 1;
+      range->info[0].dest_fd = fd;
+      range->info[0].dest_offset = shared.destination + done;
+
+      if (0 != ioctl(srcfd, FIDEDUPERANGE, range)) {
+        outcome.error = errno;
+      } else if (range->info[0].status < 0) {
+        outcome.error = -range->info[0].status;
+      } else if (range->info[0].status == FILE_DEDUPE_RANGE_DIFFERS) {
+        outcome.differs = true;
+      } else {
+        outcome.shared += range->info[0].bytes_deduped;
+      }
+    }
+  }
+
+  close(fd);
+  close(srcfd);
+  return outcome;
+}
+#else
+std::vector<DedupOutcome>
+dedupextents(const Fileinfo& /*original*/,
+             const std::vector<const Fileinfo*>& duplicates)
+{
+  DedupOutcome unsupported;
+  unsupported.error = EOPNOTSUPP;
+  return std::vector<DedupOutcome>(duplicates.size(), unsupported);
+}
+
+DedupOutcome
+dedupranges(const std::string& /*source*/,
+            const std::string& /*destination*/,
+            const std::vector<SharedRange>& /*ranges*/)
+{
+  DedupOutcome unsupported;
+  unsupported.error = EOPNOTSUPP;
+  return unsupported;
+}
+#endif
@@ -0,0 +1,75 @@
+/*
+   copyright 2026 Paul Dreik
+   Distributed under GPL v 2.0 or later, at your option.
+   See LICENSE for further details.
+*/
+#ifndef RDFIND_EXTENTDEDUP_HH_
+#define RDFIND_EXTENTDEDUP_HH_
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+class Fileinfo;
+
+/// how much of a duplicate was made to share the extents of its original
+struct DedupOutcome
+{
+  std::uint64_t shared = 0; // bytes now shared with the original
+  bool differs = false;     // the kernel found contents which differ
+  int error = 0;            // errno of the first failure, zero if none
+
+  /// the text for the results file, empty if all of size was shared
+  std::string describe(std::uint64_t size) const;
+};
+
+/// the sum of the outcomes of several duplicates
+struct DedupSummary
+{
+  std::size_t shared = 0; // files sharing all of their extents
+  std::size_t partly = 0; // files sharing some of their extents
+  std::size_t failed = 0; // files sharing nothing
+  std::uint64_t bytes = 0;
+
+  void add(const DedupOutcome& outcome, std::uint64_t size);
+  void add(const DedupSummary& other);
+
+  /// prints a line with the numbers
+  void report(std::ostream& out, const std::string& dryruntext) const;
+};
+
+/**
+ * Makes each of the duplicates share the extents of original, with the
+ * FIDEDUPERANGE ioctl. The kernel locks and compares the contents of each
+ * range before sharing it, so a file which changed since it was read is
+ * left as it is. Large files are given in ranges, and several duplicates
+ * are given in each call. Without support from the system or the file
+ * system, all fail with EOPNOTSUPP.
+ * @return the outcome of each duplicate, in the same order
+ */
+std::vector<DedupOutcome>
+dedupextents(const Fileinfo& original,
+             const std::vector<const Fileinfo*>& duplicates);
+
+/// a part of a file with the same contents as a part of another file
+struct SharedRange
+{
+  std::uint64_t source = 0;      // offset in the file with the original
+  std::uint64_t destination = 0; // offset in the file to share it
+  std::uint64_t length = 0;
+};
+
+/**
+ * Makes the ranges of destination share the extents of the same contents in
+ * source, as dedupextents does for whole files. The kernel only shares
+ * whole blocks, so the offsets and lengths have to be multiples of the
+ * block size of the file system.
+ */
+DedupOutcome
+dedupranges(const std::string& source,
+            const std::string& destination,
+            const std::vector<SharedRange>& ranges);
+
+#endif /* RDFIND_EXTENTDEDUP_HH_ */
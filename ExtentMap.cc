@@ -0,0 +1,246 @@
+/*
+   copyright 2026 Paul Dreik
+   Distributed under GPL v 2.0 or later, at your option.
+   See LICENSE for further details.
+*/
+
+#include "config.h"
+
+// std
+#include <algorithm>
+
+// os
+#include <fcntl.h>
+#include <unistd.h>
+#ifdef HAVE_LINUX_FS_H
+#include <linux/fiemap.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#endif
+
+// project
+#include "ExtentMap.hh"
+
+#if defined(HAVE_LINUX_FS_H) && defined(FS_IOC_FIEMAP)
+int
+readextentmap(const std::string& filename,
+              std::vector<Extent>& extents,
+              std::size_t maxextents)
+{
+  extents.clear();
+  const int fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return -1;
+  }
+
+  // the request ends with an array of a size only known here
+  constexpr std::size_t batch = 64;
+  std::vector<std::uint64_t> storage(
+    (sizeof(fiemap) + batch * sizeof(fiemap_extent) + sizeof(std::uint64_t) -
+     1) /
+    sizeof(std::uint64_t));
+  auto map = reinterpret_cast<fiemap*>(storage.data());
+
+  std::uint64_t start = 0;
+  int ret = 0;
+  for (;;) {
+    std::fill(storage.begin(), storage.end(), std::uint64_t{ 0 });
+    map->fm_start = start;
+    map->fm_length = FIEMAP_MAX_OFFSET - start;
+    map->fm_extent_count = batch;
+    // delayed allocations have no place yet, they get one by syncing first
+    map->fm_flags = FIEMAP_FLAG_SYNC;
+    if (0 != ioctl(fd, FS_IOC_FIEMAP, map)) {
+      ret = -1;
+      break;
+    }
+    if (map->fm_mapped_extents == 0) {
+      // no more data, the rest is a hole
+      break;
+    }
+    for (std::size_t i = 0; i < map->fm_mapped_extents; ++i) {
+      const auto& e = map->fm_extents[i];
+      extents.push_back(
+        { e.fe_logical, e.fe_physical, e.fe_length, e.fe_flags });
+    }
+    const auto& last = extents.back();
+    if ((last.flags & FIEMAP_EXTENT_LAST) != 0) {
+      break;
+    }
+    if (extents.size() > maxextents) {
+      ret = -1;
+      break;
+    }
+    start = last.logical + last.length;
+  }
+  close(fd);
+  return ret;
+}
+
+namespace {
+/**
+ * the physical place of the byte at offset in fd or, if it is in a hole, of
+ * the data after it. this asks for one extent only, where readextentmap
+ * would read the whole map of a file to find two places in it. the file is
+ * not synced, data which has no place yet is not known.
+ * @return zero on success, nonzero if there is no data from offset on
+ */
+int
+physicalof(int fd, std::uint64_t offset, std::uint64_t& physical)
+{
+  std::vector<std::uint64_t> storage(
+    (sizeof(fiemap) + sizeof(fiemap_extent) + sizeof(std::uint64_t) - 1) /
+    sizeof(std::uint64_t));
+  auto map = reinterpret_cast<fiemap*>(storage.data());
+  map->fm_start = offset;
+  // up to the end, so the extent after a hole is found
+  map->fm_length = FIEMAP_MAX_OFFSET - offset;
+  map->fm_extent_count = 1;
+  if (0 != ioctl(fd, FS_IOC_FIEMAP, map) || map->fm_mapped_extents == 0 ||
+      (map->fm_extents[0].fe_flags & FIEMAP_EXTENT_UNKNOWN) != 0) {
+    return -1;
+  }
+  const auto& e = map->fm_extents[0];
+  physical = e.fe_physical;
+  if (offset > e.fe_logical) {
+    physical += offset - e.fe_logical;
+  }
+  return 0;
+}
+} // namespace
+
+int
+readphysicalrange(const std::string& filename,
+                  std::uint64_t size,
+                  std::uint64_t& first,
+                  std::uint64_t& last)
+{
+  const int fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return -1;
+  }
+  int ret = physicalof(fd, 0, first);
+  if (ret == 0) {
+    ret = physicalof(fd, size > 0 ? size - 1 : 0, last);
+  }
+  close(fd);
+  return ret;
+}
+#else
+int
+readextentmap(const std::string& /*filename*/,
+              std::vector<Extent>& extents,
+              std::size_t /*maxextents*/)
+{
+  extents.clear();
+  return -1;
+}
+
+int
+readphysicalrange(const std::string& /*filename*/,
+                  std::uint64_t /*size*/,
+                  std::uint64_t& /*first*/,
+                  std::uint64_t& /*last*/)
+{
+  return -1;
+}
+#endif
+
+namespace {
+/**
+ * makes a key which is equal for files with the same contents in the same
+ * place, or an empty key if the map does not tell that.
+ */
+std::string
+sharedkey(const Fileinfo& file, const std::vector<Extent>& extents)
+{
+#if defined(HAVE_LINUX_FS_H) && defined(FS_IOC_FIEMAP)
+  if (extents.empty() ||
+      (extents.back().flags & FIEMAP_EXTENT_LAST) == 0) {
+    return {};
+  }
+  // the data of these is not where the physical offset says, or it is not
+  // known yet.
+  constexpr std::uint32_t unusable =
+    FIEMAP_EXTENT_UNKNOWN | FIEMAP_EXTENT_DELALLOC | FIEMAP_EXTENT_ENCODED |
+    FIEMAP_EXTENT_DATA_ENCRYPTED | FIEMAP_EXTENT_NOT_ALIGNED |
+    FIEMAP_EXTENT_DATA_INLINE | FIEMAP_EXTENT_DATA_TAIL;
+  std::string key;
+  auto append = [&key](std::uint64_t value) {
+    key.append(reinterpret_cast<const char*>(&value), sizeof(value));
+  };
+  append(file.device());
+  append(static_cast<std::uint64_t>(file.size()));
+  for (const auto& e : extents) {
+    if ((e.flags & FIEMAP_EXTENT_SHARED) == 0 || (e.flags & unusable) != 0) {
+      return {};
+    }
+    append(e.logical);
+    append(e.physical);
+    append(e.length);
+    // unwritten extents read as zeros
+    append(e.flags & FIEMAP_EXTENT_UNWRITTEN);
+  }
+  return key;
+#else
+  (void)file;
+  (void)extents;
+  return {};
+#endif
+}
+} // namespace
+
+std::size_t
+SharedExtents::scan(const std::vector<Fileinfo>& files)
+{
+  std::unordered_map<std::string, std::vector<std::int64_t>> byextents;
+  std::vector<Extent> extents;
+  for (const auto& file : files) {
+    if (0 != readextentmap(file.name(), extents)) {
+      continue;
+    }
+    auto key = sharedkey(file, extents);
+    if (!key.empty()) {
+      byextents[std::move(key)].push_back(file.getidentity());
+    }
+  }
+
+  std::size_t nclasses = 0;
+  for (const auto& entry : byextents) {
+    if (entry.second.size() < 2) {
+      continue;
+    }
+    for (const auto identity : entry.second) {
+      m_classof[identity] = nclasses;
+    }
+    ++nclasses;
+  }
+  return m_classof.size();
+}
+
+bool
+SharedExtents::restorebuffer(Fileinfo& file,
+                             Fileinfo::readtobuffermode mode) const
+{
+  const auto cls = m_classof.find(file.getidentity());
+  if (cls == m_classof.end()) {
+    return false;
+  }
+  const auto it = m_buffers.find({ cls->second, mode });
+  if (it == m_buffers.end() || it->second.size() != file.getbuffersize()) {
+    return false;
+  }
+  file.setbytes(it->second.data(), it->second.size());
+  return true;
+}
+
+void
+SharedExtents::recordbuffer(const Fileinfo& file,
+                            Fileinfo::readtobuffermode mode)
+{
+  const auto cls = m_classof.find(file.getidentity());
+  if (cls != m_classof.end()) {
+    m_buffers.emplace(std::make_pair(cls->second, mode),
+                      std::string(file.getbyteptr(), file.getbuffersize()));
+  }
+}
@@ -0,0 +1,85 @@
+/*
+   copyright 2026 Paul Dreik
+   Distributed under GPL v 2.0 or later, at your option.
+   See LICENSE for further details.
+*/
+#ifndef RDFIND_EXTENTMAP_HH_
+#define RDFIND_EXTENTMAP_HH_
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Fileinfo.hh"
+
+/// where a part of a file is stored, as told by FIEMAP
+struct Extent
+{
+  std::uint64_t logical;  // offset in the file
+  std::uint64_t physical; // offset on the device
+  std::uint64_t length;
+  std::uint32_t flags; // FIEMAP_EXTENT_*
+};
+
+/**
+ * reads where the data of a file is stored, with the FS_IOC_FIEMAP ioctl.
+ * holes are left out. files with more than maxextents extents are not
+ * read.
+ * @return zero on success, nonzero if the file system can not tell or the
+ * file has too many extents
+ */
+int
+readextentmap(const std::string& filename,
+              std::vector<Extent>& extents,
+              std::size_t maxextents = 1024);
+
+/**
+ * looks up where on the device the first and the last byte of a file are
+ * stored, with one FS_IOC_FIEMAP ioctl each. a byte in a hole is taken to
+ * be where the data after it is.
+ * @return zero on success, nonzero if the file system can not tell or the
+ * file ends in a hole
+ */
+int
+readphysicalrange(const std::string& filename,
+                  std::uint64_t size,
+                  std::uint64_t& first,
+                  std::uint64_t& last);
+
+/**
+ * Finds files which share all of their extents, for instance after they
+ * were deduplicated or copied with reflinks. Such files have the same
+ * contents, so only one of them needs to be read in each stage: the buffer
+ * read from the first one is given to the others.
+ */
+class SharedExtents
+{
+public:
+  /**
+   * reads the extent maps of the files. files of the same size on the same
+   * device, with identical maps where every extent is shared, belong
+   * together.
+   * @return the number of files which share all extents with another
+   */
+  std::size_t scan(const std::vector<Fileinfo>& files);
+
+  /// a buffer provider, see Rdutil
+  bool restorebuffer(Fileinfo& file, Fileinfo::readtobuffermode mode) const;
+
+  /// a buffer observer, see Rdutil
+  void recordbuffer(const Fileinfo& file, Fileinfo::readtobuffermode mode);
+
+private:
+  // the files which share extents with another, by identity, to the number
+  // of the files they share with
+  std::unordered_map<std::int64_t, std::size_t> m_classof;
+  // the first buffer read, by class and mode
+  std::map<std::pair<std::size_t, Fileinfo::readtobuffermode>, std::string>
+    m_buffers;
+};
+
+#endif /* RDFIND_EXTENTMAP_HH_ */
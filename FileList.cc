@@ -0,0 +1,158 @@
+/*
+   copyright 2026 Paul Dreik
+   Distributed under GPL v 2.0 or later, at your option.
+   See LICENSE for further details.
+*/
+
+#include "config.h"
+
+// std
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <limits>
+
+// os
+#include <sys/stat.h>
+#include <sys/types.h>
+
+// project
+#include "FileList.hh"
+
+namespace {
+/**
+ * parses a number up to the next tab in record, starting at pos. on
+ * success, pos is moved past the tab.
+ */
+bool
+parsenumber(const std::string& record,
+            std::size_t& pos,
+            unsigned long long& value)
+{
+  const auto tab = record.find('\t', pos);
+  if (tab == std::string::npos || tab == pos) {
+    return false;
+  }
+  const std::string field = record.substr(pos, tab - pos);
+  if (field.find_first_not_of("0123456789") != std::string::npos) {
+    return false;
+  }
+  errno = 0;
+  value = std::strtoull(field.c_str(), nullptr, 10);
+  if (errno != 0) {
+    return false;
+  }
+  pos = tab + 1;
+  return true;
+}
+
+/**
+ * the depth of a file in the list, as if it was found by traversing from
+ * the current directory: the number of directories in its name.
+ */
+int
+depthof(const std::string& name)
+{
+  std::size_t first = 0;
+  while (name.compare(first, 2, "./") == 0) {
+    first += 2;
+  }
+  while (first < name.size() && name[first] == '/') {
+    ++first;
+  }
+  return static_cast<int>(std::count(name.begin() +
+                                       static_cast<std::ptrdiff_t>(first),
+                                     name.end(),
+                                     '/'));
+}
+} // namespace
+
+int
+FileList::read(const std::string& filename, const callback& report)
+{
+  std::ifstream file;
+  if (filename != "-") {
+    file.open(filename, std::ios::binary);
+    if (!file) {
+      std::cerr << "could not open file list \"" << filename << "\"\n";
+      return -1;
+    }
+  }
+  std::istream& in = filename == "-" ? std::cin : file;
+
+  // the first record decides the separator: if there is no NUL character in
+  // the whole list, it is the entire list, separated by newlines.
+  std::string record;
+  std::getline(in, record, '\0');
+  const char separator = in.eof() ? '\n' : '\0';
+  if (separator == '\n') {
+    std::size_t begin = 0;
+    while (begin < record.size()) {
+      auto end = record.find('\n', begin);
+      if (end == std::string::npos) {
+        end = record.size();
+      }
+      if (end > begin && 0 != parserecord(record.substr(begin, end - begin),
+                                          report)) {
+        return -1;
+      }
+      begin = end + 1;
+    }
+    return 0;
+  }
+
+  do {
+    if (!record.empty() && 0 != parserecord(record, report)) {
+      return -1;
+    }
+  } while (std::getline(in, record, '\0'));
+  if (in.bad()) {
+    std::cerr << "failed reading file list \"" << filename << "\"\n";
+    return -1;
+  }
+  return 0;
+}
+
+int
+FileList::parserecord(const std::string& record, const callback& report)
+{
+  ++m_recordno;
+  std::size_t pos = 0;
+  unsigned long long group = 1;
+  bool haveinfo = false;
+  struct stat info
+  {};
+  bool ok = true;
+  if (m_format != format::NAMES) {
+    ok = parsenumber(record, pos, group) && group > 0 &&
+         group < std::numeric_limits<int>::max() / 2;
+  }
+  if (ok && m_format == format::STAT) {
+    unsigned long long size{};
+    unsigned long long device{};
+    unsigned long long inode{};
+    ok = parsenumber(record, pos, size) && parsenumber(record, pos, device) &&
+         parsenumber(record, pos, inode) &&
+         size <= static_cast<unsigned long long>(
+                   std::numeric_limits<off_t>::max());
+    // the list only has regular files, as found by find -type f
+    info.st_mode = S_IFREG;
+    info.st_size = static_cast<off_t>(size);
+    info.st_dev = static_cast<dev_t>(device);
+    info.st_ino = static_cast<ino_t>(inode);
+    haveinfo = true;
+  }
+  if (!ok || pos == record.size()) {
+    std::cerr << "bad record " << m_recordno << " in file list: \"" << record
+              << "\"\n";
+    return -1;
+  }
+
+  const std::string name = record.substr(pos);
+  const int groupindex = static_cast<int>(group);
+  m_maxgroup = std::max(m_maxgroup, groupindex);
+  report(name, groupindex, depthof(name), haveinfo ? &info : nullptr);
+  return 0;
+}
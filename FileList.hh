@@ -0,0 +1,69 @@
+/*
+   copyright 2026 Paul Dreik
+   Distributed under GPL v 2.0 or later, at your option.
+   See LICENSE for further details.
+*/
+#ifndef RDFIND_FILELIST_HH_
+#define RDFIND_FILELIST_HH_
+
+#include <functional>
+#include <string>
+
+/**
+ * Reads the files to look at from a list, instead of traversing
+ * directories. The records of the list are separated by NUL characters, as
+ * made by find -print0, or by newlines if the list has no NUL characters.
+ *
+ * Depending on the format, a record is
+ *
+ *   NAME                              the name of a file
+ *   GROUP<tab>NAME                    also its group
+ *   GROUP<tab>SIZE<tab>DEV<tab>INO<tab>NAME
+ *                                     also its size, device and inode, which
+ *                                     are used instead of looking them up
+ *
+ * The group is a positive number ranking the file as if it was found under
+ * the command line argument with that position, so a lower group ranks
+ * higher. Without groups, all files are in group 1.
+ */
+class FileList
+{
+public:
+  enum class format
+  {
+    NAMES,
+    GROUPS,
+    STAT
+  };
+
+  explicit FileList(format fmt)
+    : m_format(fmt)
+  {
+  }
+
+  /**
+   * invoked for each file in the list, with its name, group and depth. the
+   * stat information is given if it was in the list, otherwise nullptr.
+   */
+  using callback = std::function<
+    int(const std::string&, int, int, const struct stat*)>;
+
+  /**
+   * reads the list and reports each file in it.
+   * @param filename the list, or "-" for standard input
+   * @return zero on success
+   */
+  int read(const std::string& filename, const callback& report);
+
+  /// the highest group found by read
+  int maxgroup() const { return m_maxgroup; }
+
+private:
+  int parserecord(const std::string& record, const callback& report);
+
+  format m_format;
+  int m_maxgroup = 0;
+  std::size_t m_recordno = 0;
+};
+
+#endif /* RDFIND_FILELIST_HH_ */
@@ -11,18 +11,157 @@
 #include <cassert>
 #include <cerrno>   //for errno
 #include <cstring>  //for strerror
-#include <fstream>  //for file reading
 #include <iostream> //for cout etc
+#include <optional>
 
 // os
+#include <fcntl.h>    //for AT_FDCWD
 #include <sys/stat.h> //for file info
+#include <stdio.h>    //for renameat
 #include <unistd.h>   //for unlink etc.
 
 // project
 #include "Checksum.hh" //checksum calculation
+#include "EasyRandom.hh"
 #include "Fileinfo.hh"
 #include "Options.hh"
-#include "UndoableUnlink.hh"
+#include "PageCache.hh" //to leave the page cache as it was
+#include "Throttle.hh"  //to limit the rate of reading
+
+namespace {
+// hashes length zeros, with buffer as scratch space
+void
+hashzeros(std::uint64_t length, std::vector<char>& buffer, Checksum& chk)
+{
+  std::fill(buffer.begin(), buffer.end(), '\0');
+  while (length > 0) {
+    const auto n = static_cast<std::size_t>(
+      std::min<std::uint64_t>(length, buffer.size()));
+    chk.update(n, buffer.data());
+    length -= n;
+  }
+}
+
+// hashes the file from begin up to end, or where it ends if that is first,
+// at the rate the options allow. the pages read are handed back to keeper,
+// if given.
+// @return the offset it was read up to, negative on error
+off_t
+hashdata(int fd,
+         off_t begin,
+         off_t end,
+         std::vector<char>& buffer,
+         Checksum& chk,
+         CacheKeeper* keeper,
+         const Options& options)
+{
+  while (begin < end) {
+    const auto wanted = static_cast<std::size_t>(
+      std::min<std::uint64_t>(static_cast<std::uint64_t>(end - begin),
+                              buffer.size()));
+    throttleread(options, wanted);
+    const auto n = pread(fd, buffer.data(), wanted, begin);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n < 0) {
+      return -1;
+    }
+    if (n == 0) {
+      break;
+    }
+    chk.update(static_cast<std::size_t>(n), buffer.data());
+    begin += n;
+    if (keeper) {
+      keeper->release(static_cast<std::uint64_t>(begin));
+    }
+  }
+  return begin;
+}
+
+/**
+ * hashes a part of the file, the first or last bytes of it.
+ * @return zero on success
+ */
+int
+hashpart(int fd,
+         std::uint64_t begin,
+         std::uint64_t end,
+         std::vector<char>& buffer,
+         Checksum& chk,
+         const Options& options)
+{
+  std::optional<CacheKeeper> keeper;
+  if (options.cacheneutral) {
+    keeper.emplace(fd, begin, end, false);
+  }
+  const off_t done = hashdata(fd,
+                              static_cast<off_t>(begin),
+                              static_cast<off_t>(end),
+                              buffer,
+                              chk,
+                              keeper ? &*keeper : nullptr,
+                              options);
+  return done < 0 ? -1 : 0;
+}
+
+/**
+ * hashes the entire file. a file with fewer blocks than its size needs
+ * has holes, which are hashed as zeros without reading them: SEEK_DATA and
+ * SEEK_HOLE tell where the data is. without support for them, the whole
+ * file is one piece of data.
+ * @return zero on success
+ */
+int
+hashentirefile(int fd,
+               std::vector<char>& buffer,
+               Checksum& chk,
+               const Options& options)
+{
+  struct stat info;
+  if (fstat(fd, &info) != 0) {
+    return -1;
+  }
+  const off_t size = info.st_size;
+  std::optional<CacheKeeper> optkeeper;
+  if (options.cacheneutral) {
+    optkeeper.emplace(fd, 0, static_cast<std::uint64_t>(size), true);
+  }
+  CacheKeeper* keeper = optkeeper ? &*optkeeper : nullptr;
+  const bool sparse = static_cast<std::uint64_t>(info.st_blocks) * 512 <
+                      static_cast<std::uint64_t>(size);
+  if (!sparse) {
+    return hashdata(fd, 0, size, buffer, chk, keeper, options) < 0 ? -1 : 0;
+  }
+
+  off_t pos = 0;
+  while (pos < size) {
+    off_t data = lseek(fd, pos, SEEK_DATA);
+    if (data < 0) {
+      // ENXIO means the rest is a hole
+      data = errno == ENXIO ? size : pos;
+    }
+    hashzeros(static_cast<std::uint64_t>(data - pos), buffer, chk);
+    if (data >= size) {
+      break;
+    }
+    off_t hole = lseek(fd, data, SEEK_HOLE);
+    if (hole < 0 || hole > size) {
+      hole = size;
+    }
+    const off_t done = hashdata(fd, data, hole, buffer, chk, keeper, options);
+    if (done < 0) {
+      return -1;
+    }
+    if (done < hole) {
+      // the file was truncated while reading it
+      break;
+    }
+    pos = hole;
+  }
+  return 0;
+}
+} // namespace
 
 int
 Fileinfo::fillwithbytes(enum readtobuffermode filltype,
@@ -48,52 +187,46 @@ Fileinfo::fillwithbytes(enum readtobuffermode filltype,
     }
   }
 
-  std::fstream f1;
-  f1.open(m_filename, std::ios_base::in);
-  if (!f1.is_open()) {
+  // set memory to zero
+  m_somebytes.fill('\0');
+
+  // ensure the checksum object is in a good state
+  chk.reset();
+
+  throttleopen(options);
+  const int fd = open(m_filename.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
     std::cerr << "fillwithbytes.cc: Could not open file \"" << m_filename
               << "\"" << std::endl;
     return -1;
   }
 
-  bool read_entire_file = true;
-  std::streamsize bytes_to_read{};
+  int ret;
   if (filltype == readtobuffermode::READ_FIRST_BYTES) {
-    bytes_to_read = static_cast<std::streamsize>(options.first_bytes_size);
-    if (filesize > bytes_to_read) {
-      read_entire_file = false;
-    }
+    // a file no longer than the first bytes is read entirely
+    const auto end = std::min(ufilesize, options.first_bytes_size);
+    ret = hashpart(fd, 0, end, buffer, chk, options);
   } else if (filltype == readtobuffermode::READ_LAST_BYTES) {
-    bytes_to_read = static_cast<std::streamsize>(options.last_bytes_size);
-    if (filesize > bytes_to_read) {
-      read_entire_file = false;
-      f1.seekg(-static_cast<std::ofstream::off_type>(options.last_bytes_size),
-               std::ios_base::end);
-    }
-  }
-
-  // set memory to zero
-  m_somebytes.fill('\0');
-
-  // ensure the checksum object is in a good state
-  chk.reset();
-
-  if (read_entire_file) {
-    while (f1) {
-      f1.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
-      // gcount is never negative, the cast is safe.
-      chk.update(static_cast<std::size_t>(f1.gcount()), buffer.data());
-    }
+    const auto begin = ufilesize > options.last_bytes_size
+                         ? ufilesize - options.last_bytes_size
+                         : 0;
+    ret = hashpart(fd, begin, ufilesize, buffer, chk, options);
   } else {
-    const auto bufsize = static_cast<std::streamsize>(buffer.size());
-    while (f1 && bytes_to_read > 0) {
-      f1.read(buffer.data(), std::min(bufsize, bytes_to_read));
-      // gcount is never negative, the cast is safe.
-      bytes_to_read -= f1.gcount();
-      chk.update(static_cast<std::size_t>(f1.gcount()), buffer.data());
-    }
+    ret = hashentirefile(fd, buffer, chk, options);
+  }
+  close(fd);
+  if (ret != 0) {
+    std::cerr << "fillwithbytes.cc: Could not read file \"" << m_filename
+              << "\"" << std::endl;
+    return -1;
   }
 
+  return storedigest(chk);
+}
+
+int
+Fileinfo::storedigest(Checksum& chk)
+{
   // store the result of the checksum calculation in somebytes
   assert(chk.getDigestLength() > 0);
   assert(static_cast<std::size_t>(chk.getDigestLength()) <= m_somebytes.size());
@@ -104,6 +237,14 @@ Fileinfo::fillwithbytes(enum readtobuffermode filltype,
   return 0;
 }
 
+void
+Fileinfo::setbytes(const char* bytes, std::size_t length)
+{
+  assert(length <= m_somebytes.size());
+  m_somebytes.fill('\0');
+  std::copy_n(bytes, length, m_somebytes.begin());
+}
+
 bool
 Fileinfo::readfileinfo()
 {
@@ -126,6 +267,13 @@ Fileinfo::readfileinfo()
     return false;
   }
 
+  setfileinfo(info);
+  return true;
+}
+
+void
+Fileinfo::setfileinfo(const struct stat& info)
+{
   // only keep the relevant information
   m_info.stat_size = info.st_size;
   m_info.stat_ino = info.st_ino;
@@ -133,7 +281,6 @@ Fileinfo::readfileinfo()
 
   m_info.is_file = S_ISREG(info.st_mode);
   m_info.is_directory = S_ISDIR(info.st_mode);
-  return true;
 }
 
 const char*
@@ -169,7 +316,13 @@ Fileinfo::Fileinfostat::Fileinfostat()
 int
 Fileinfo::deletefile()
 {
-  const int ret = unlink(name().c_str());
+  return deletefileat(AT_FDCWD, name());
+}
+
+int
+Fileinfo::deletefileat(int dirfd, const std::string& entry)
+{
+  const int ret = unlinkat(dirfd, entry.c_str(), 0);
   if (ret) {
     std::cerr << "Failed deleting file " << name() << '\n';
   }
@@ -204,61 +357,71 @@ simplifyPath(std::string& path)
 }
 
 // prepares target, so that location can point to target in
-// the best way possible
-int
-makeAbsolute(std::string& target)
+// the best way possible, given the current working directory cwd.
+void
+makeAbsolute(std::string& target, const std::string& cwd)
 {
   // if target is not absolute, let us make it absolute
   if (target.length() > 0 && target.at(0) == '/') {
     // absolute. do nothing.
   } else {
     // not absolute. make it absolute.
+    target = cwd + std::string("/") + target;
+  }
+}
 
-    // yes, this is possible to do with dynamically allocated memory,
-    // but it is not portable then (and more work).
-    // hmm, would it be possible to cache this and gain some speedup?
-    const size_t buflength = 256;
-    char buf[buflength];
-    if (buf != getcwd(buf, buflength)) {
-      std::cerr << "failed to get current working directory" << std::endl;
-      return -1;
-    }
-    target = std::string(buf) + std::string("/") + target;
+/**
+ * makes a random name in the same directory as entry. to avoid getting
+ * ENAMETOOLONG, the filename is replaced instead of appended to.
+ * this will fail if the directory name is really long, but there is not
+ * much to do about that without going into parsing mount points etc.
+ */
+std::string
+temporaryname(const std::string& entry)
+{
+  const auto last_sep = entry.find_last_of('/');
+  if (last_sep == std::string::npos) {
+    // bare filename - replace it.
+    return EasyRandom().makeRandomFileString();
   }
-  return 0;
+  // found. keep the directory, switch out the filename.
+  return entry.substr(0, last_sep + 1) + EasyRandom().makeRandomFileString();
 }
 
 /**
- * helper for transactional operation on a file. It will move the file to a
- * temporary, then invoke f with the filename as argument, then delete the
- * temporary. In case of failure at any point, it will do it's best to restore
- * the temporary back to the filename.
- * @param filename
- * @param f
+ * helper for replacing a file with a link. makelink is invoked to make the
+ * link under a temporary name, which is then renamed over the file. The
+ * rename is atomic, so the file name refers to either the file or the link
+ * at any point, also if the program is interrupted. On failure, the file
+ * is left as it was.
+ * @param dirfd the directory of entry, or AT_FDCWD
+ * @param entry the file, relative to dirfd
+ * @param filename the file, for messages
+ * @param makelink called with the temporary name, relative to dirfd
  * @return zero on success.
  */
 template<typename Func>
 int
-transactional_operation(const std::string& filename, const Func& f)
+replace_with_link(int dirfd,
+                  const std::string& entry,
+                  const std::string& filename,
+                  const Func& makelink)
 {
-  // move the file to a temporary.
-  UndoableUnlink restorer(filename);
-
-  // did the move to a temporary go ok?
-  if (!restorer.file_is_moved()) {
-    return 1;
-  }
-
-  // yes, apply whatever the caller wanted.
-  const int ret = f(filename);
+  const std::string temporary = temporaryname(entry);
 
+  const int ret = makelink(temporary);
   if (0 != ret) {
-    // operation failed! rollback time (made by restorer at scope exit)
+    // nothing has been changed.
     return ret;
   }
 
-  // operation succeeded, go ahead and unlink the temporary.
-  if (0 != restorer.unlink()) {
+  if (0 != renameat(dirfd, temporary.c_str(), dirfd, entry.c_str())) {
+    std::cerr << "Failed replacing " << filename << ": "
+              << std::strerror(errno) << '\n';
+    if (0 != unlinkat(dirfd, temporary.c_str(), 0)) {
+      std::cerr << "Failed unlinking temporary file made for " << filename
+                << '\n';
+    }
     return 1;
   }
 
@@ -266,22 +429,52 @@ transactional_operation(const std::string& filename, const Func& f)
 }
 } // namespace
 
+bool
+Fileinfo::currentdirectory(std::string& cwd)
+{
+  // yes, this is possible to do with dynamically allocated memory,
+  // but it is not portable then (and more work).
+  const size_t buflength = 256;
+  char buf[buflength];
+  if (buf != getcwd(buf, buflength)) {
+    std::cerr << "failed to get current working directory" << std::endl;
+    return false;
+  }
+  cwd = buf;
+  return true;
+}
+
 // makes a symlink that points to A
 int
 Fileinfo::makesymlink(const Fileinfo& A)
 {
-  const int retval =
-    transactional_operation(name(), [&](const std::string& filename) {
-      // The tricky thing is that the path must be correct, as seen from
-      // the directory where *this is. Making the path absolute solves this
-      // problem. Doing string manipulations to find how to make the path
-      // relative is prone to error because directories can be symlinks.
-      std::string target = A.name();
-      makeAbsolute(target);
-      // clean up the path, so it does not contain sequences "/./" or "//"
-      simplifyPath(target);
-      return symlink(target.c_str(), filename.c_str());
-    });
+  std::string cwd;
+  if (A.name().empty() || A.name().at(0) != '/') {
+    currentdirectory(cwd);
+  }
+  return makesymlinkat(AT_FDCWD, name(), A, cwd);
+}
+
+int
+Fileinfo::makesymlinkat(int dirfd,
+                        const std::string& entry,
+                        const Fileinfo& A,
+                        const std::string& cwd)
+{
+  auto makelink = [&](const std::string& temporary) {
+    // The tricky thing is that the path must be correct, as seen from
+    // the directory where *this is. Making the path absolute solves this
+    // problem. Doing string manipulations to find how to make the path
+    // relative is prone to error because directories can be symlinks.
+    std::string target = A.name();
+    if (!cwd.empty()) {
+      makeAbsolute(target, cwd);
+    }
+    // clean up the path, so it does not contain sequences "/./" or "//"
+    simplifyPath(target);
+    return symlinkat(target.c_str(), dirfd, temporary.c_str());
+  };
+  const int retval = replace_with_link(dirfd, entry, name(), makelink);
 
   if (retval) {
     std::cerr << "Failed to make symlink " << name() << " to " << A.name()
@@ -294,15 +487,28 @@ Fileinfo::makesymlink(const Fileinfo& A)
 int
 Fileinfo::makehardlink(const Fileinfo& A)
 {
-  return transactional_operation(name(), [&](const std::string& filename) {
+  return makehardlinkat(AT_FDCWD, name(), A);
+}
+
+int
+Fileinfo::makehardlinkat(int dirfd, const std::string& entry, const Fileinfo& A)
+{
+  if (device() == A.device() && inode() == A.inode()) {
+    // already a hard link to A. renaming a link over another link to the
+    // same file does nothing, which would leave the temporary behind.
+    return 0;
+  }
+  auto makelink = [&](const std::string& temporary) {
     // make a hardlink.
-    const int retval = link(A.name().c_str(), filename.c_str());
+    const int retval =
+      linkat(AT_FDCWD, A.name().c_str(), dirfd, temporary.c_str(), 0);
     if (retval) {
-      std::cerr << "Failed to make hardlink " << filename << " to " << A.name()
+      std::cerr << "Failed to make hardlink " << name() << " to " << A.name()
                 << '\n';
     }
     return retval;
-  });
+  };
+  return replace_with_link(dirfd, entry, name(), makelink);
 }
 
 int
@@ -17,6 +17,7 @@
 
 class Checksum;
 struct Options;
+struct stat;
 
 /**
  Holds information about a file.
@@ -81,6 +82,12 @@ public:
    */
   bool readfileinfo();
 
+  /**
+   * sets info about the file from an already made stat call, instead of
+   * querying the filesystem.
+   */
+  void setfileinfo(const struct stat& info);
+
   duptype getduptype() const { return m_duptype; }
 
   /// makes a symlink of "this" that points to A.
@@ -95,6 +102,23 @@ public:
    */
   int deletefile();
 
+  /**
+   * as makesymlink, makehardlink and deletefile, for the entry in the
+   * directory dirfd which is this file. this saves looking up the directory
+   * for each file, when acting on many files in the same directory.
+   * makesymlinkat makes the target absolute with the current working
+   * directory cwd, unless it is empty.
+   */
+  int makesymlinkat(int dirfd,
+                    const std::string& entry,
+                    const Fileinfo& A,
+                    const std::string& cwd);
+  int makehardlinkat(int dirfd, const std::string& entry, const Fileinfo& A);
+  int deletefileat(int dirfd, const std::string& entry);
+
+  /// gets the current working directory, for makesymlinkat
+  static bool currentdirectory(std::string& cwd);
+
   // makes a symlink of A that points to B
   static int static_makesymlink(Fileinfo& A, const Fileinfo& B);
 
@@ -153,6 +177,14 @@ public:
   /// get a pointer to the bytes read from the file
   const char* getbyteptr() const { return m_somebytes.data(); }
 
+  /**
+   * sets the bytes, as if they were read from the file by fillwithbytes.
+   * this is useful when they are known from somewhere else.
+   * @param bytes
+   * @param length at most getbuffersize(), the rest is zero filled.
+   */
+  void setbytes(const char* bytes, std::size_t length);
+
   std::size_t getbuffersize() const { return m_somebytes.size(); }
 
   /// returns true if file is a regular file. call readfileinfo first!
@@ -208,6 +240,9 @@ private:
 
   /// a buffer that will be filled with some bytes of the file or a hash
   std::array<char, SomeByteSize> m_somebytes;
+
+  /// stores the digest of chk in m_somebytes. @return zero on success
+  int storedigest(Checksum& chk);
 };
 
 #endif
@@ -0,0 +1,452 @@
+/*
+   copyright 2026 Paul Dreik
+   Distributed under GPL v 2.0 or later, at your option.
+   See LICENSE for further details.
+*/
+
+#include "config.h"
+
+// std
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <numeric>
+#include <tuple>
+
+// os
+#include <sys/stat.h>
+
+// project
+#include "BinaryIO.hh"
+#include "Checksum.hh"
+#include "Manifest.hh"
+#include "Options.hh"
+#include "Rdutil.hh"
+#include "ResultsFile.hh"
+
+namespace {
+// identifies the file formats. bump the version if the layout changes.
+constexpr char sizesmagic[] = "RDFINDSZ";
+constexpr char manifestmagic[] = "RDFINDMF";
+constexpr std::uint32_t version = 1;
+
+/// reads and checks the magic and version of a file
+bool
+readmagic(BinaryReader& reader, const char* magic, std::size_t length)
+{
+  std::string filemagic(length, '\0');
+  std::uint32_t fileversion{};
+  return reader.readBytes(filemagic.data(), length) &&
+         filemagic == std::string(magic, length) &&
+         reader.readU32(fileversion) && fileversion == version;
+}
+
+/// how a stage was made, it has to be the same on all nodes
+struct Stage
+{
+  std::uint8_t mode;
+  std::uint8_t checksumtype;
+  std::uint8_t length;
+
+  bool operator==(const Stage& other) const
+  {
+    return std::tie(mode, checksumtype, length) ==
+           std::tie(other.mode, other.checksumtype, other.length);
+  }
+};
+
+std::vector<Stage>
+stagesfor(const Options& options)
+{
+  std::vector<Stage> stages;
+  for (const auto& stage : Rdutil::stages(options)) {
+    const auto type = Rdutil::checksumtypefor(stage.first, options);
+    stages.push_back(
+      { static_cast<std::uint8_t>(static_cast<signed char>(stage.first)),
+        static_cast<std::uint8_t>(type),
+        static_cast<std::uint8_t>(Checksum(type).getDigestLength()) });
+  }
+  return stages;
+}
+
+/// a node, as read from its manifest
+struct Node
+{
+  std::string name;
+  // the command line indices of its files are shifted by this much, so the
+  // nodes rank in the order given.
+  int offset;
+};
+} // namespace
+
+int
+writesizes(const std::string& filename, const std::vector<Fileinfo>& list)
+{
+  std::map<Fileinfo::filesizetype, std::uint64_t> counts;
+  for (const auto& file : list) {
+    ++counts[file.size()];
+  }
+
+  std::ofstream out(filename, std::ios_base::binary | std::ios_base::trunc);
+  if (!out.is_open()) {
+    std::cerr << "could not open \"" << filename << "\" for writing\n";
+    return -1;
+  }
+  BinaryWriter writer(out);
+  writer.writeBytes(sizesmagic, sizeof(sizesmagic) - 1);
+  writer.writeU32(version);
+  writer.writeU64(counts.size());
+  for (const auto& [size, count] : counts) {
+    writer.writeI64(size);
+    writer.writeU64(count);
+  }
+  out.flush();
+  if (!writer.good()) {
+    std::cerr << "failed writing \"" << filename << "\"\n";
+    return -1;
+  }
+  return 0;
+}
+
+int
+readcollidingsizes(const std::vector<std::string>& filenames,
+                   std::set<Fileinfo::filesizetype>& sizes)
+{
+  std::map<Fileinfo::filesizetype, std::uint64_t> counts;
+  for (const auto& filename : filenames) {
+    std::ifstream in(filename, std::ios_base::binary);
+    BinaryReader reader(in);
+    std::uint64_t entries{};
+    if (!in.is_open() || !readmagic(reader, sizesmagic, 8) ||
+        !reader.readU64(entries)) {
+      std::cerr << "\"" << filename << "\" is not a list of sizes\n";
+      return -1;
+    }
+    for (std::uint64_t i = 0; i < entries; ++i) {
+      std::int64_t size{};
+      std::uint64_t count{};
+      if (!reader.readI64(size) || !reader.readU64(count)) {
+        std::cerr << "list of sizes \"" << filename << "\" is damaged\n";
+        return -1;
+      }
+      counts[size] += count;
+    }
+  }
+  sizes.clear();
+  for (const auto& [size, count] : counts) {
+    if (count > 1) {
+      sizes.insert(size);
+    }
+  }
+  return 0;
+}
+
+ManifestWriter::ManifestWriter(const Options& options)
+  : m_options(options)
+{
+  // worked out once, since this is needed for every file read
+  for (const auto& stage : stagesfor(options)) {
+    m_stages.emplace_back(static_cast<Fileinfo::readtobuffermode>(
+                            static_cast<signed char>(stage.mode)),
+                          stage.length);
+  }
+}
+
+void
+ManifestWriter::recordbuffer(const Fileinfo& file,
+                             Fileinfo::readtobuffermode mode)
+{
+  const auto stage =
+    std::find_if(m_stages.begin(), m_stages.end(), [mode](const auto& s) {
+      return s.first == mode;
+    });
+  if (stage == m_stages.end() || file.getidentity() < 1) {
+    return;
+  }
+  const auto index = static_cast<std::size_t>(file.getidentity() - 1);
+  if (m_buffers.size() <= index) {
+    m_buffers.resize(index + 1);
+  }
+  auto& buffers = m_buffers[index];
+  buffers.resize(m_stages.size());
+  buffers[static_cast<std::size_t>(stage - m_stages.begin())].assign(
+    file.getbyteptr(), stage->second);
+}
+
+int
+ManifestWriter::write(const std::string& filename,
+                      const std::string& nodename,
+                      const std::vector<Fileinfo>& list) const
+{
+  const auto stages = stagesfor(m_options);
+
+  // in identity order, so the nodes which merge the manifests rank the
+  // files the same way as this node.
+  std::vector<const Fileinfo*> files;
+  for (const auto& file : list) {
+    const auto index = static_cast<std::size_t>(file.getidentity() - 1);
+    const bool complete =
+      index < m_buffers.size() &&
+      std::all_of(m_buffers[index].begin(),
+                  m_buffers[index].end(),
+                  [](const std::string& b) { return !b.empty(); }) &&
+      m_buffers[index].size() == stages.size();
+    if (complete) {
+      files.push_back(&file);
+    }
+  }
+  std::sort(files.begin(), files.end(), [](const auto* a, const auto* b) {
+    return a->getidentity() < b->getidentity();
+  });
+
+  std::ofstream out(filename, std::ios_base::binary | std::ios_base::trunc);
+  if (!out.is_open()) {
+    std::cerr << "could not open manifest \"" << filename
+              << "\" for writing\n";
+    return -1;
+  }
+  BinaryWriter writer(out);
+  writer.writeBytes(manifestmagic, sizeof(manifestmagic) - 1);
+  writer.writeU32(version);
+  writer.writeString(nodename);
+  writer.writeU64(m_options.first_bytes_size);
+  writer.writeU64(m_options.last_bytes_size);
+  writer.writeU8(static_cast<std::uint8_t>(stages.size()));
+  for (const auto& stage : stages) {
+    writer.writeU8(stage.mode);
+    writer.writeU8(stage.checksumtype);
+    writer.writeU8(stage.length);
+  }
+  writer.writeU64(files.size());
+  for (const auto* file : files) {
+    writer.writeI64(file->size());
+    writer.writeU64(file->device());
+    writer.writeU64(file->inode());
+    writer.writeI64(file->get_cmdline_index());
+    writer.writeI64(file->depth());
+    writer.writeString(file->name());
+    for (const auto& buffer :
+         m_buffers[static_cast<std::size_t>(file->getidentity() - 1)]) {
+      writer.writeBytes(buffer.data(), buffer.size());
+    }
+  }
+  out.flush();
+  if (!writer.good()) {
+    std::cerr << "failed writing manifest \"" << filename << "\"\n";
+    return -1;
+  }
+  return 0;
+}
+
+int
+mergemanifests(const std::vector<std::string>& filenames,
+               const Options& options)
+{
+  std::vector<Node> nodes;
+  std::vector<Fileinfo> list;
+  // the buffers of all stages per file, by identity - 1
+  std::vector<std::string> buffers;
+
+  std::uint64_t first_bytes_size{}, last_bytes_size{};
+  std::vector<Stage> stages;
+  int offset = 0;
+  for (const auto& filename : filenames) {
+    std::ifstream in(filename, std::ios_base::binary);
+    BinaryReader reader(in);
+    Node node{ {}, offset };
+    std::uint64_t firstsize{}, lastsize{};
+    std::uint8_t stagecount{};
+    if (!in.is_open() || !readmagic(reader, manifestmagic, 8) ||
+        !reader.readString(node.name) || !reader.readU64(firstsize) ||
+        !reader.readU64(lastsize) || !reader.readU8(stagecount)) {
+      std::cerr << "\"" << filename << "\" is not a manifest\n";
+      return -1;
+    }
+    std::vector<Stage> nodestages(stagecount);
+    for (auto& stage : nodestages) {
+      if (!reader.readU8(stage.mode) || !reader.readU8(stage.checksumtype) ||
+          !reader.readU8(stage.length)) {
+        std::cerr << "manifest \"" << filename << "\" is damaged\n";
+        return -1;
+      }
+    }
+    if (nodes.empty()) {
+      first_bytes_size = firstsize;
+      last_bytes_size = lastsize;
+      stages = nodestages;
+    } else if (first_bytes_size != firstsize || last_bytes_size != lastsize ||
+               stages != nodestages) {
+      std::cerr << "manifest \"" << filename
+                << "\" was made with different checksum or first/last bytes "
+                   "options than \""
+                << filenames.front() << "\"\n";
+      return -1;
+    }
+    const bool nameinuse =
+      std::any_of(nodes.begin(), nodes.end(), [&](const Node& n) {
+        return n.name == node.name;
+      });
+    if (node.name.empty() || nameinuse ||
+        node.name.find('/') != std::string::npos) {
+      std::cerr << "manifest \"" << filename << "\" has the node name \""
+                << node.name
+                << "\", which is empty, used twice or has a slash. give each "
+                   "node a unique name with -nodename.\n";
+      return -1;
+    }
+
+    std::uint64_t count{};
+    if (!reader.readU64(count)) {
+      std::cerr << "manifest \"" << filename << "\" is damaged\n";
+      return -1;
+    }
+    const std::size_t bufferlength = std::accumulate(
+      stages.begin(), stages.end(), std::size_t{ 0 }, [](auto sum, auto s) {
+        return sum + s.length;
+      });
+    int maxcmdline = 0;
+    for (std::uint64_t i = 0; i < count; ++i) {
+      std::int64_t size{}, cmdline_index{}, depth{};
+      std::uint64_t device{}, inode{};
+      std::string path;
+      std::string buffer(bufferlength, '\0');
+      if (!reader.readI64(size) || !reader.readU64(device) ||
+          !reader.readU64(inode) || !reader.readI64(cmdline_index) ||
+          !reader.readI64(depth) || !reader.readString(path) ||
+          !reader.readBytes(buffer.data(), buffer.size())) {
+        std::cerr << "manifest \"" << filename << "\" is damaged\n";
+        return -1;
+      }
+      maxcmdline = std::max(maxcmdline, static_cast<int>(cmdline_index));
+      Fileinfo file(node.name + ":" + path,
+                    static_cast<int>(cmdline_index) + offset,
+                    static_cast<int>(depth));
+      struct stat info
+      {};
+      info.st_mode = S_IFREG;
+      info.st_size = size;
+      info.st_dev = device;
+      info.st_ino = inode;
+      file.setfileinfo(info);
+      list.push_back(std::move(file));
+      buffers.push_back(std::move(buffer));
+    }
+    offset += maxcmdline;
+    nodes.push_back(std::move(node));
+  }
+  std::cout << "Read " << list.size() << " files from " << nodes.size()
+            << " manifests." << std::endl;
+
+  // the node a file is on, by its command line index
+  auto nodeof = [&nodes](const Fileinfo& file) -> const Node& {
+    auto it = std::upper_bound(
+      nodes.begin(),
+      nodes.end(),
+      file.get_cmdline_index(),
+      [](int index, const Node& n) { return index <= n.offset; });
+    return *(it - 1);
+  };
+
+  // the usual elimination, with the buffers taken from the manifests. the
+  // device and inode numbers are only meaningful within a node, so files
+  // with the same are not removed.
+  Rdutil gswd(list);
+  gswd.addbufferprovider(
+    [&](Fileinfo& file, Fileinfo::readtobuffermode mode) {
+      const auto identity = file.getidentity();
+      if (identity < 1 ||
+          static_cast<std::size_t>(identity) > buffers.size()) {
+        return false;
+      }
+      std::size_t start = 0;
+      for (const auto& stage : stages) {
+        if (stage.mode == static_cast<std::uint8_t>(
+                            static_cast<signed char>(mode))) {
+          file.setbytes(
+            buffers[static_cast<std::size_t>(identity - 1)].data() + start,
+            stage.length);
+          return true;
+        }
+        start += stage.length;
+      }
+      return false;
+    });
+  gswd.markitems();
+  gswd.removeUniqueSizes();
+  auto lastmode = Fileinfo::readtobuffermode::NOT_DEFINED;
+  for (const auto& stage : stages) {
+    const auto mode = static_cast<Fileinfo::readtobuffermode>(
+      static_cast<signed char>(stage.mode));
+    gswd.fillwithbytes(mode, lastmode, options, {});
+    gswd.removeUniqSizeAndBuffer();
+    lastmode = mode;
+  }
+  gswd.markduplicates();
+
+  std::cout << "It seems like you have " << list.size()
+            << " files that are not unique\n";
+  std::cout << "Totally, ";
+  gswd.saveablespace(std::cout) << " can be reduced." << std::endl;
+
+  if (options.makeresultsfile) {
+    std::cout << "Now making results file " << options.resultsfile
+              << std::endl;
+    gswd.printtofile(options.resultsfile);
+  }
+
+  // the results of each node, with the names and priorities of the node
+  std::cout << "Now making results files for " << nodes.size() << " nodes"
+            << std::endl;
+  std::vector<std::unique_ptr<std::ofstream>> outputs;
+  for (const auto& node : nodes) {
+    const std::string filename = options.resultsfile + "." + node.name;
+    outputs.push_back(std::make_unique<std::ofstream>(filename));
+    if (!outputs.back()->is_open()) {
+      std::cerr << "could not open file \"" << filename << "\"\n";
+      return -1;
+    }
+    *outputs.back() << "# Automatically generated\n";
+    *outputs.back() << "# duptype id depth size device inode priority name\n";
+  }
+  auto first = list.begin();
+  while (first != list.end()) {
+    // markduplicates put the original first in each group
+    auto last = std::find_if(first + 1, list.end(), [](const Fileinfo& f) {
+      return f.getduptype() == Fileinfo::duptype::DUPTYPE_FIRST_OCCURRENCE;
+    });
+    const Node& originalnode = nodeof(*first);
+    for (std::size_t n = 0; n < nodes.size(); ++n) {
+      const Node& node = nodes[n];
+      auto& out = *outputs[n];
+      bool any = false;
+      for (auto it = first; it != last; ++it) {
+        if (&nodeof(*it) != &node) {
+          continue;
+        }
+        if (!any && &originalnode != &node) {
+          // the original is elsewhere, so only deleting makes sense here.
+          // it is listed with its node in the name, for -apply.
+          out << ResultEntry::RemoteOriginal << " " << first->getidentity()
+              << " " << first->depth() << " " << first->size() << " "
+              << first->device() << " " << first->inode() << " "
+              << first->get_cmdline_index() - originalnode.offset << " "
+              << first->name() << '\n';
+        }
+        any = true;
+        Rdutil::printresultline(out,
+                                *it,
+                                it->get_cmdline_index() - node.offset,
+                                it->name().substr(node.name.size() + 1));
+      }
+    }
+    first = last;
+  }
+  for (auto& out : outputs) {
+    *out << "# end of file\n";
+  }
+  return 0;
+}
@@ -0,0 +1,79 @@
+/*
+   copyright 2026 Paul Dreik
+   Distributed under GPL v 2.0 or later, at your option.
+   See LICENSE for further details.
+
+   finding duplicates spread over several machines without a shared file
+   system. each node exports the sizes of its files, then the buffers of the
+   files with a size found more than once among all nodes (a manifest), and
+   the manifests are merged into a list of actions per node.
+ */
+#ifndef RDFIND_MANIFEST_HH_
+#define RDFIND_MANIFEST_HH_
+
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Fileinfo.hh"
+
+struct Options;
+
+/**
+ * writes how many files there are of each size.
+ * @return zero on success
+ */
+int
+writesizes(const std::string& filename, const std::vector<Fileinfo>& list);
+
+/**
+ * reads size histograms written by writesizes, for all nodes.
+ * @param sizes receives the sizes found more than once in total
+ * @return zero on success
+ */
+int
+readcollidingsizes(const std::vector<std::string>& filenames,
+                   std::set<Fileinfo::filesizetype>& sizes);
+
+/**
+ * collects the buffers of the files during the elimination stages, and
+ * writes them out as a manifest.
+ */
+class ManifestWriter
+{
+public:
+  explicit ManifestWriter(const Options& options);
+
+  /// records the buffer of a file, after it was read in the given mode
+  void recordbuffer(const Fileinfo& file, Fileinfo::readtobuffermode mode);
+
+  /**
+   * writes the manifest of all files in the list, which must have been given
+   * identities with Rdutil::markitems.
+   * @return zero on success
+   */
+  int write(const std::string& filename,
+            const std::string& nodename,
+            const std::vector<Fileinfo>& list) const;
+
+private:
+  const Options& m_options;
+  // the mode and the length of the digest of each stage
+  std::vector<std::pair<Fileinfo::readtobuffermode, std::size_t>> m_stages;
+  // the buffers per identity, one per stage
+  std::vector<std::vector<std::string>> m_buffers;
+};
+
+/**
+ * finds the duplicates among the files in the manifests, without reading
+ * any file. the nodes rank in the order the manifests are given. writes the
+ * results for all nodes to the results file, and the results of each node
+ * to the results file name followed by a dot and the node name.
+ * @return zero on success
+ */
+int
+mergemanifests(const std::vector<std::string>& filenames,
+               const Options& options);
+
+#endif /* RDFIND_MANIFEST_HH_ */
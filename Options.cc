@@ -29,6 +29,27 @@ options are (default choice within parentheses)
                                   (use 0 to disable this check).
  -followsymlinks    true |(false) follow symlinks
  -removeidentinode (true)| false  ignore files with nonunique device and inode
+ -exclude GLOB                    skip files and directories with a name
+                                  matching GLOB, without looking at them.
+                                  a GLOB with a slash matches the path.
+ -include GLOB                    only look at files matching GLOB
+ -excluderegex RE                 as -exclude, with an extended regular
+                                  expression matching the path
+ -includeregex RE                 as -include, with an extended regular
+                                  expression matching the path
+ -filesfrom FILE                  also look at the files listed in FILE, or
+                                  standard input if FILE is -, separated by
+                                  NUL or newline characters
+ -filesfromformat (names)| groups | stat
+                                  what each record of the -filesfrom list
+                                  holds before the name: nothing, a group
+                                  ranking like the command line position, or
+                                  group, size, device and inode, tab separated
+ -dircache FILE                   remember directory listings in FILE and
+                                  reuse them for unchanged directories
+ -dircachemaxage N                list cached directories again if the listing
+                                  is N seconds old or more. 0 forces a full
+                                  rescan. default is no limit.
 
  Processing options:
 
@@ -46,22 +67,105 @@ options are (default choice within parentheses)
                                   to 128 MiB.
  -deterministic    (true)| false  makes results independent of order
                                   from listing the filesystem
+ -streamscan        true |(false) read the first and last bytes of files while
+                                  still traversing the directories
+ -checkextents      true |(false) look up where the candidates are stored,
+                                  and read files sharing all of their
+                                  extents only once
+ -dirduplicates     true |(false) also find directories with identical
+                                  trees, and report and act on each of
+                                  them as a whole
+ -threads N                       read files with N threads. with more than
+                                  one, each group of files of the same size
+                                  goes through the stages on its own, and
+                                  the actions are taken on N directories
+                                  at a time. default is 1.
+ -shard I/N                       only process the files with a size
+                                  belonging to shard I out of N (1 to N), so
+                                  N runs can split the work between them
+ -buildindex FILE                 write an index of the given files to FILE,
+                                  for use with -referenceindex, instead of
+                                  looking for duplicates
+ -referenceindex FILE             also look for duplicates among the files in
+                                  the index FILE, which rank before the given
+                                  files. duplicates within the index are not
+                                  reported.
 
  Action options:
 
  -makeresultsfile  (true)| false  makes a results file
+ -streamresults     true |(false) write each set of duplicates to the
+                                  results file and take the action on it as
+                                  soon as it is confirmed. most useful
+                                  with -threads.
  -makesymlinks      true |(false) replace duplicate files with symbolic links
  -makehardlinks     true |(false) replace duplicate files with hard links
  -deleteduplicates  true |(false) delete duplicate files
-                                  Default is 0. Only a few values
-                                  are supported; 0, 1-5, 10, 25, 50, 100
+ -dedupextents      true |(false) let duplicate files share the storage of
+                                  the original, on btrfs and xfs
  -dryrun|-n         true |(false) print to stdout instead of changing anything
 
  General options:
 
  -outputname NAME                 sets the results file name to NAME,
                                   default is results.txt
+ -readorder (inode)| physical     order the reads of each stage on inode, or
+                                  on where the data is stored on the disk
+ -outputformat (text)| nul | jsonl | binary
+                                  how the results file is written: lines,
+                                  NUL terminated records, JSON lines with
+                                  the digest, or binary with an index on
+                                  the names, see the man page
+ -checkpoint FILE                 journal the progress to FILE, so the run
+                                  can be resumed if it is interrupted
+ -resume FILE                     resume the interrupted run which made the
+                                  checkpoint FILE. no files or directories
+                                  should be given.
+ -exportsizes FILE                write how many files there are of each size
+                                  to FILE, instead of looking for duplicates
+ -exportmanifest FILE             write the sizes and checksums of the files to
+                                  FILE, instead of looking for duplicates
+ -collidingsizes FILE             with -exportmanifest, only export files with
+                                  a size found more than once in the
+                                  -exportsizes files of all nodes. may be
+                                  given several times.
+ -nodename NAME                   name of this node in the manifest, default is
+                                  the host name
+ -chunkreport FILE                cut the files into chunks on their contents,
+                                  and write how many bytes each pair of files
+                                  has in common to FILE, instead of looking
+                                  for duplicates. with -dedupextents, the
+                                  parts in common share their storage.
+ -chunksize N                     average size of the chunks of -chunkreport,
+                                  a power of two. default is 8192.
+ -mergemanifests    true |(false) find duplicates among the manifests given
+                                  instead of files. writes the results of each
+                                  node to the results file name followed by
+                                  a dot and the node name.
+ -mergeresults      true |(false) combine the results files of all shards,
+                                  given instead of files, into one
+ -apply FILE                      take the action on the duplicates in the
+                                  results file FILE of an earlier run,
+                                  instead of looking for duplicates
+ -applyverify       true |(false) with -apply, compare the contents of each
+                                  duplicate to its original first
+ -watch SOCKET                    keep running, follow changes to the files and
+                                  answer questions on the unix socket SOCKET
+ -query SOCKET                    ask the rdfind watching with SOCKET what
+                                  is given instead of files: DUPLICATES or
+                                  ISDUP NAME
  -sleep             Xms           sleep for X milliseconds between file reads.
+                                  Default is 0. Only a few values
+                                  are supported; 0, 1-5, 10, 25, 50, 100
+ -cacheneutral      true |(false) drop the pages read from the page cache,
+                                  unless they were cached before
+ -maxreadrate N                   read at most N bytes per second, shared by
+                                  all threads. default is no limit.
+ -maxopenrate N                   open at most N files per second for
+                                  reading. default is no limit.
+ -ioclass (default)| besteffort | idle
+                                  the I/O scheduling class to run in, idle
+                                  only reads when no one else does
  -progress          true |(false) output progress information
  -h|-help|--help                  show this help and exit
  -v|--version                     display version number and exit
@@ -104,8 +208,105 @@ parseOptions(Parser& parser)
       o.makehardlinks = parser.get_parsed_bool();
     } else if (parser.try_parse_bool("-makeresultsfile")) {
       o.makeresultsfile = parser.get_parsed_bool();
+    } else if (parser.try_parse_bool("-streamresults")) {
+      o.streamresults = parser.get_parsed_bool();
     } else if (parser.try_parse_string("-outputname")) {
       o.resultsfile = parser.get_parsed_string();
+    } else if (parser.try_parse_string("-readorder")) {
+      if (parser.parsed_string_is("inode")) {
+        o.readorder = readordering::INODE;
+      } else if (parser.parsed_string_is("physical")) {
+        o.readorder = readordering::PHYSICAL;
+      } else {
+        std::cerr << "expected inode/physical, not \""
+                  << parser.get_parsed_string() << "\"\n";
+        std::exit(EXIT_FAILURE);
+      }
+    } else if (parser.try_parse_string("-outputformat")) {
+      if (parser.parsed_string_is("text")) {
+        o.outputformat = resultsformat::TEXT;
+      } else if (parser.parsed_string_is("nul")) {
+        o.outputformat = resultsformat::NUL;
+      } else if (parser.parsed_string_is("jsonl")) {
+        o.outputformat = resultsformat::JSONL;
+      } else if (parser.parsed_string_is("binary")) {
+        o.outputformat = resultsformat::BINARY;
+      } else {
+        std::cerr << "expected text/nul/jsonl/binary, not \""
+                  << parser.get_parsed_string() << "\"\n";
+        std::exit(EXIT_FAILURE);
+      }
+    } else if (parser.try_parse_string("-checkpoint")) {
+      o.checkpointfile = parser.get_parsed_string();
+    } else if (parser.try_parse_string("-resume")) {
+      o.resumefile = parser.get_parsed_string();
+    } else if (parser.try_parse_string("-buildindex")) {
+      o.buildindexfile = parser.get_parsed_string();
+    } else if (parser.try_parse_string("-referenceindex")) {
+      o.referenceindexfile = parser.get_parsed_string();
+    } else if (parser.try_parse_string("-exportsizes")) {
+      o.exportsizesfile = parser.get_parsed_string();
+    } else if (parser.try_parse_string("-exportmanifest")) {
+      o.exportmanifestfile = parser.get_parsed_string();
+    } else if (parser.try_parse_string("-collidingsizes")) {
+      o.collidingsizesfiles.emplace_back(parser.get_parsed_string());
+    } else if (parser.try_parse_string("-nodename")) {
+      o.nodename = parser.get_parsed_string();
+    } else if (parser.try_parse_string("-chunkreport")) {
+      o.chunkreportfile = parser.get_parsed_string();
+    } else if (parser.try_parse_string("-chunksize")) {
+      const long chunksize = std::stoll(parser.get_parsed_string());
+      constexpr long min_chunksize = 64;
+      constexpr long max_chunksize = 4 << 20;
+      if (chunksize < min_chunksize || chunksize > max_chunksize ||
+          (chunksize & (chunksize - 1)) != 0) {
+        std::cerr << "the chunk size has to be a power of two from "
+                  << min_chunksize << " to " << max_chunksize << ", got "
+                  << chunksize << '\n';
+        std::exit(EXIT_FAILURE);
+      }
+      o.chunksize = static_cast<std::size_t>(chunksize);
+    } else if (parser.try_parse_bool("-mergemanifests")) {
+      o.mergemanifests = parser.get_parsed_bool();
+    } else if (parser.try_parse_bool("-streamscan")) {
+      o.streamscan = parser.get_parsed_bool();
+    } else if (parser.try_parse_bool("-checkextents")) {
+      o.checkextents = parser.get_parsed_bool();
+    } else if (parser.try_parse_bool("-dirduplicates")) {
+      o.dirduplicates = parser.get_parsed_bool();
+    } else if (parser.try_parse_string("-threads")) {
+      const long long threads = std::stoll(parser.get_parsed_string());
+      constexpr long long max_threads = 256;
+      if (threads < 1 || threads > max_threads) {
+        std::cerr << "the number of threads must be between 1 and "
+                  << max_threads << ", got " << threads << "\n";
+        std::exit(EXIT_FAILURE);
+      }
+      o.threads = static_cast<std::size_t>(threads);
+    } else if (parser.try_parse_string("-shard")) {
+      const std::string shard = parser.get_parsed_string();
+      const auto slash = shard.find('/');
+      const long long index =
+        slash == std::string::npos ? 0 : std::stoll(shard.substr(0, slash));
+      const long long count =
+        slash == std::string::npos ? 0 : std::stoll(shard.substr(slash + 1));
+      if (index < 1 || index > count) {
+        std::cerr << "expected -shard I/N with 1<=I<=N, not \"" << shard
+                  << "\"\n";
+        std::exit(EXIT_FAILURE);
+      }
+      o.shardindex = static_cast<std::uint64_t>(index - 1);
+      o.shardcount = static_cast<std::uint64_t>(count);
+    } else if (parser.try_parse_bool("-mergeresults")) {
+      o.mergeresults = parser.get_parsed_bool();
+    } else if (parser.try_parse_string("-apply")) {
+      o.applyfile = parser.get_parsed_string();
+    } else if (parser.try_parse_bool("-applyverify")) {
+      o.applyverify = parser.get_parsed_bool();
+    } else if (parser.try_parse_string("-watch")) {
+      o.watchsocket = parser.get_parsed_string();
+    } else if (parser.try_parse_string("-query")) {
+      o.querysocket = parser.get_parsed_string();
     } else if (parser.try_parse_bool("-ignoreempty")) {
       if (parser.get_parsed_bool()) {
         o.minimumfilesize =
@@ -125,8 +326,41 @@ parseOptions(Parser& parser)
         throw std::runtime_error("negative value of maxsize not allowed");
       }
       o.maximumfilesize = maxsize;
+    } else if (parser.try_parse_string("-exclude")) {
+      o.excludeglobs.emplace_back(parser.get_parsed_string());
+    } else if (parser.try_parse_string("-include")) {
+      o.includeglobs.emplace_back(parser.get_parsed_string());
+    } else if (parser.try_parse_string("-excluderegex")) {
+      o.excluderegexes.emplace_back(parser.get_parsed_string());
+    } else if (parser.try_parse_string("-includeregex")) {
+      o.includeregexes.emplace_back(parser.get_parsed_string());
+    } else if (parser.try_parse_string("-filesfrom")) {
+      o.filesfrom = parser.get_parsed_string();
+    } else if (parser.try_parse_string("-filesfromformat")) {
+      if (parser.parsed_string_is("names")) {
+        o.filesfromformat = FileList::format::NAMES;
+      } else if (parser.parsed_string_is("groups")) {
+        o.filesfromformat = FileList::format::GROUPS;
+      } else if (parser.parsed_string_is("stat")) {
+        o.filesfromformat = FileList::format::STAT;
+      } else {
+        std::cerr << "expected names/groups/stat, not \""
+                  << parser.get_parsed_string() << "\"\n";
+        std::exit(EXIT_FAILURE);
+      }
+    } else if (parser.try_parse_string("-dircache")) {
+      o.dircachefile = parser.get_parsed_string();
+    } else if (parser.try_parse_string("-dircachemaxage")) {
+      const long long maxage = std::stoll(parser.get_parsed_string());
+      if (maxage < 0) {
+        throw std::runtime_error(
+          "negative value of dircachemaxage not allowed");
+      }
+      o.dircachemaxage = maxage;
     } else if (parser.try_parse_bool("-deleteduplicates")) {
       o.deleteduplicates = parser.get_parsed_bool();
+    } else if (parser.try_parse_bool("-dedupextents")) {
+      o.dedupextents = parser.get_parsed_bool();
     } else if (parser.try_parse_bool("-followsymlinks")) {
       o.followsymlinks = parser.get_parsed_bool();
     } else if (parser.try_parse_bool("-dryrun")) {
@@ -189,6 +423,34 @@ parseOptions(Parser& parser)
         std::exit(EXIT_FAILURE);
       }
       o.buffersize = static_cast<std::size_t>(buffersize);
+    } else if (parser.try_parse_bool("-cacheneutral")) {
+      o.cacheneutral = parser.get_parsed_bool();
+    } else if (parser.try_parse_string("-maxreadrate")) {
+      const long long rate = std::stoll(parser.get_parsed_string());
+      if (rate < 0) {
+        std::cerr << "a negative -maxreadrate is not allowed\n";
+        std::exit(EXIT_FAILURE);
+      }
+      o.maxreadrate = static_cast<std::uint64_t>(rate);
+    } else if (parser.try_parse_string("-maxopenrate")) {
+      const long long rate = std::stoll(parser.get_parsed_string());
+      if (rate < 0) {
+        std::cerr << "a negative -maxopenrate is not allowed\n";
+        std::exit(EXIT_FAILURE);
+      }
+      o.maxopenrate = static_cast<std::uint64_t>(rate);
+    } else if (parser.try_parse_string("-ioclass")) {
+      if (parser.parsed_string_is("default")) {
+        o.ioclass = ioschedclass::DEFAULT;
+      } else if (parser.parsed_string_is("besteffort")) {
+        o.ioclass = ioschedclass::BESTEFFORT;
+      } else if (parser.parsed_string_is("idle")) {
+        o.ioclass = ioschedclass::IDLE;
+      } else {
+        std::cerr << "expected default/besteffort/idle, not \""
+                  << parser.get_parsed_string() << "\"\n";
+        std::exit(EXIT_FAILURE);
+      }
     } else if (parser.try_parse_string("-sleep")) {
       const auto nextarg = std::string(parser.get_parsed_string());
       if (nextarg == "1ms") {
@@ -246,6 +508,197 @@ parseOptions(Parser& parser)
     std::exit(EXIT_FAILURE);
   }
 
+  if (!o.checkpointfile.empty() && !o.resumefile.empty()) {
+    std::cerr << "-checkpoint and -resume can not be combined, the resumed "
+                 "run keeps using the checkpoint it resumes from\n";
+    std::exit(EXIT_FAILURE);
+  }
+
+  if (!o.buildindexfile.empty()) {
+    if (o.makesymlinks || o.makehardlinks || o.deleteduplicates ||
+        o.dedupextents) {
+      std::cerr << "-buildindex does not look for duplicates, it can not be "
+                   "combined with actions\n";
+      std::exit(EXIT_FAILURE);
+    }
+    if (!o.referenceindexfile.empty() || !o.checkpointfile.empty() ||
+        !o.resumefile.empty()) {
+      std::cerr << "-buildindex can not be combined with -referenceindex, "
+                   "-checkpoint or -resume\n";
+      std::exit(EXIT_FAILURE);
+    }
+    // the index is made instead of a results file
+    o.makeresultsfile = false;
+  }
+
+  if (!o.referenceindexfile.empty() && !o.resumefile.empty()) {
+    std::cerr << "-referenceindex can not be combined with -resume\n";
+    std::exit(EXIT_FAILURE);
+  }
+
+  if (!o.watchsocket.empty() || !o.querysocket.empty()) {
+    if (o.makesymlinks || o.makehardlinks || o.deleteduplicates ||
+        o.dedupextents || !o.dircachefile.empty() ||
+        !o.checkpointfile.empty() || !o.resumefile.empty() ||
+        !o.buildindexfile.empty() || !o.referenceindexfile.empty()) {
+      std::cerr << "-watch and -query can not be combined with actions, "
+                   "-dircache, -checkpoint, -resume, -buildindex or "
+                   "-referenceindex\n";
+      std::exit(EXIT_FAILURE);
+    }
+    // the answers are given on the socket instead
+    o.makeresultsfile = false;
+  }
+
+  const bool exporting =
+    !o.exportsizesfile.empty() || !o.exportmanifestfile.empty();
+  if (exporting || o.mergemanifests) {
+    const int modes = !o.exportsizesfile.empty() +
+                      !o.exportmanifestfile.empty() + o.mergemanifests;
+    if (modes > 1 || o.makesymlinks || o.makehardlinks ||
+        o.deleteduplicates || o.dedupextents || !o.checkpointfile.empty() ||
+        !o.resumefile.empty() || !o.buildindexfile.empty() ||
+        !o.referenceindexfile.empty() || !o.watchsocket.empty() ||
+        !o.querysocket.empty()) {
+      std::cerr << "only one of -exportsizes, -exportmanifest and "
+                   "-mergemanifests can be given, and not together with "
+                   "actions, -checkpoint, -resume, -buildindex, "
+                   "-referenceindex, -watch or -query\n";
+      std::exit(EXIT_FAILURE);
+    }
+  }
+  if (!o.collidingsizesfiles.empty() && o.exportmanifestfile.empty()) {
+    std::cerr << "-collidingsizes is only used with -exportmanifest\n";
+    std::exit(EXIT_FAILURE);
+  }
+  if (exporting) {
+    // the exported file is made instead of a results file
+    o.makeresultsfile = false;
+  }
+
+  if (!o.filesfrom.empty() &&
+      (!o.resumefile.empty() || !o.watchsocket.empty() ||
+       !o.querysocket.empty() || o.mergemanifests || o.mergeresults)) {
+    std::cerr << "-filesfrom can not be combined with -resume, -watch, "
+                 "-query, -mergemanifests or -mergeresults\n";
+    std::exit(EXIT_FAILURE);
+  }
+  if (o.streamscan &&
+      (!o.resumefile.empty() || !o.buildindexfile.empty() ||
+       !o.watchsocket.empty() || !o.querysocket.empty() || exporting ||
+       o.mergemanifests || o.mergeresults)) {
+    std::cerr << "-streamscan is only used when looking for duplicates, it "
+                 "can not be combined with -resume, -buildindex, -watch, "
+                 "-query, -exportsizes, -exportmanifest, -mergemanifests or "
+                 "-mergeresults\n";
+    std::exit(EXIT_FAILURE);
+  }
+  if (o.streamresults &&
+      (!o.buildindexfile.empty() || !o.watchsocket.empty() ||
+       !o.querysocket.empty() || exporting || o.mergemanifests ||
+       o.mergeresults)) {
+    std::cerr << "-streamresults is only used when looking for duplicates, "
+                 "it can not be combined with -buildindex, -watch, -query, "
+                 "-exportsizes, -exportmanifest, -mergemanifests or "
+                 "-mergeresults\n";
+    std::exit(EXIT_FAILURE);
+  }
+  if (o.streamresults && o.outputformat == resultsformat::BINARY) {
+    std::cerr << "the binary output format is written when all files are "
+                 "known, it can not be combined with -streamresults\n";
+    std::exit(EXIT_FAILURE);
+  }
+  if (o.outputformat != resultsformat::TEXT &&
+      (o.mergemanifests || o.mergeresults)) {
+    std::cerr << "-mergemanifests and -mergeresults only write the text "
+                 "output format\n";
+    std::exit(EXIT_FAILURE);
+  }
+  if (o.shardcount != 0 &&
+      (o.makesymlinks || o.makehardlinks || o.deleteduplicates ||
+       o.dedupextents || !o.buildindexfile.empty() ||
+       !o.watchsocket.empty() || exporting || o.mergemanifests)) {
+    std::cerr << "-shard only finds the duplicates of one shard, it can not "
+                 "be combined with actions, -buildindex, -watch, "
+                 "-exportsizes, -exportmanifest or -mergemanifests\n";
+    std::exit(EXIT_FAILURE);
+  }
+  if (o.mergeresults &&
+      (o.makesymlinks || o.makehardlinks || o.deleteduplicates ||
+       o.dedupextents || o.shardcount != 0 || !o.buildindexfile.empty() ||
+       !o.referenceindexfile.empty() || !o.checkpointfile.empty() ||
+       !o.resumefile.empty() || !o.watchsocket.empty() ||
+       !o.querysocket.empty() || exporting || o.mergemanifests)) {
+    std::cerr << "-mergeresults only combines results files, it can not be "
+                 "combined with other modes or actions\n";
+    std::exit(EXIT_FAILURE);
+  }
+
+  if (o.dedupextents &&
+      (o.makesymlinks || o.makehardlinks || o.deleteduplicates)) {
+    std::cerr << "-dedupextents can not be combined with the other actions\n";
+    std::exit(EXIT_FAILURE);
+  }
+
+  if (o.dirduplicates &&
+      (o.makehardlinks || o.dedupextents || o.streamresults ||
+       o.shardcount != 0 || !o.referenceindexfile.empty() ||
+       !o.applyfile.empty() || !o.buildindexfile.empty() ||
+       !o.watchsocket.empty() || !o.querysocket.empty() || exporting ||
+       o.mergemanifests || o.mergeresults)) {
+    std::cerr << "-dirduplicates needs all files compared, and directories "
+                 "can only be deleted or replaced with symlinks. it can not "
+                 "be combined with -makehardlinks, -dedupextents, "
+                 "-streamresults, -shard, -referenceindex, -apply or other "
+                 "modes\n";
+    std::exit(EXIT_FAILURE);
+  }
+
+  if (!o.chunkreportfile.empty()) {
+    if (o.makesymlinks || o.makehardlinks || o.deleteduplicates ||
+        o.streamresults || o.streamscan || o.dirduplicates ||
+        o.shardcount != 0 || !o.checkpointfile.empty() ||
+        !o.resumefile.empty() || !o.buildindexfile.empty() ||
+        !o.referenceindexfile.empty() || !o.applyfile.empty() ||
+        !o.watchsocket.empty() || !o.querysocket.empty() || exporting ||
+        o.mergemanifests || o.mergeresults) {
+      std::cerr << "-chunkreport compares parts of files instead of whole "
+                   "files, it can only be combined with -dedupextents and "
+                   "not with other actions or modes\n";
+      std::exit(EXIT_FAILURE);
+    }
+    // the report is made instead of a results file
+    o.makeresultsfile = false;
+  } else if (o.chunksize != Options{}.chunksize) {
+    std::cerr << "-chunksize is only used with -chunkreport\n";
+    std::exit(EXIT_FAILURE);
+  }
+
+  if (!o.applyfile.empty()) {
+    const int actions = o.makesymlinks + o.makehardlinks +
+                        o.deleteduplicates + o.dedupextents;
+    if (actions != 1) {
+      std::cerr << "-apply needs one of -makesymlinks, -makehardlinks, "
+                   "-deleteduplicates and -dedupextents\n";
+      std::exit(EXIT_FAILURE);
+    }
+    if (o.shardcount != 0 || o.streamscan || o.streamresults ||
+        !o.filesfrom.empty() || !o.dircachefile.empty() ||
+        !o.checkpointfile.empty() || !o.resumefile.empty() ||
+        !o.buildindexfile.empty() || !o.referenceindexfile.empty() ||
+        !o.watchsocket.empty() || !o.querysocket.empty() || exporting ||
+        o.mergemanifests || o.mergeresults) {
+      std::cerr << "-apply only takes the action on an earlier results file, "
+                   "it can not be combined with other modes\n";
+      std::exit(EXIT_FAILURE);
+    }
+    // the results file is read, not written
+    o.makeresultsfile = false;
+  } else if (o.applyverify) {
+    std::cerr << "-applyverify is only used with -apply\n";
+    std::exit(EXIT_FAILURE);
+  }
+
   // done with parsing of options. remaining arguments are files and dirs.
 
   // decide what checksum to use, default to sha1
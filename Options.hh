@@ -3,24 +3,50 @@
 #include "config.h"
 
 #include <cstddef>
+#include <cstdint>
 #include <string>
+#include <vector>
 
 #include "ChecksumTypes.hh"
+#include "FileList.hh"
 #include "Fileinfo.hh"
+#include "ResultsWriter.hh"
 
 class Parser;
 
+/// how the files are ordered before they are read in each stage
+enum class readordering
+{
+  /// on device and inode, which is cheap and often close to the disk order
+  INODE,
+  /// on where the part read by the stage is stored on the device
+  PHYSICAL
+};
+
+/// the I/O scheduling classes -ioclass can set
+enum class ioschedclass
+{
+  /// leave it as it is
+  DEFAULT,
+  /// the lowest level of best effort
+  BESTEFFORT,
+  /// only get disk time when no one else wants it
+  IDLE
+};
+
 struct Options
 {
   // operation mode and default values
   bool makesymlinks = false;   // turn duplicates into symbolic links
   bool makehardlinks = false;  // turn duplicates into hard links
   bool makeresultsfile = true; // write a results file
+  bool streamresults = false;  // write and act on each set once confirmed
   Fileinfo::filesizetype minimumfilesize =
     1; // minimum file size to be noticed (0 - include empty files)
   Fileinfo::filesizetype maximumfilesize =
     0; // if nonzero, files this size or larger are ignored
   bool deleteduplicates = false;      // delete duplicate files
+  bool dedupextents = false; // share the extents of duplicates with original
   bool followsymlinks = false;        // follow symlinks
   bool dryrun = false;                // only dryrun, don't destroy anything
   bool remove_identical_inode = true; // remove files with identical inodes
@@ -31,10 +57,52 @@ struct Options
   bool usexxh128 = false;    // use xxh128 checksum to check for similarity
   bool nochecksum = false;   // skip using checksumming (unsafe!)
   bool deterministic = true; // be independent of filesystem order
+  bool streamscan = false;   // read first and last bytes during traversal
+  bool checkextents = false; // read files sharing all extents only once
+  bool dirduplicates = false; // find directories with identical trees
+  std::size_t threads = 1;   // threads reading files, more than one runs
+                             // each group through the stages on its own
   bool showprogress = false; // show progress while reading file contents
   std::size_t buffersize = 1 << 20; // chunksize to use when reading files
   long nsecsleep = 0; // number of nanoseconds to sleep between each file read.
+  bool cacheneutral = false; // leave the page cache as it was found
+  std::uint64_t maxreadrate = 0; // bytes read per second, zero for no limit
+  std::uint64_t maxopenrate = 0; // files opened per second, zero for no limit
+  ioschedclass ioclass =
+    ioschedclass::DEFAULT; // the I/O scheduling class to run in
+  readordering readorder =
+    readordering::INODE; // how files are ordered before each stage
   std::string resultsfile = "results.txt"; // results file name.
+  resultsformat outputformat =
+    resultsformat::TEXT; // how the results file is written
+  std::string filesfrom; // read the files from this list, "-" is stdin
+  FileList::format filesfromformat =
+    FileList::format::NAMES; // what the records of the list contain
+  std::vector<std::string> excludeglobs;   // skip entries matching these
+  std::vector<std::string> includeglobs;   // only keep files matching these
+  std::vector<std::string> excluderegexes; // as excludeglobs, but regexes
+  std::vector<std::string> includeregexes; // as includeglobs, but regexes
+  std::string dircachefile; // where to keep directory listings, if nonempty
+  std::int64_t dircachemaxage =
+    -1; // rescan cached directories older than this (seconds), -1 disables
+  std::string checkpointfile; // where to journal progress, if nonempty
+  std::string resumefile;     // journal to resume from, if nonempty
+  std::string buildindexfile; // where to write a reference index, if nonempty
+  std::string referenceindexfile; // reference index to use, if nonempty
+  std::string watchsocket; // run as a daemon answering on this socket
+  std::string querysocket; // ask the daemon on this socket
+  std::string exportsizesfile;    // where to write the size histogram
+  std::string exportmanifestfile; // where to write the manifest
+  std::vector<std::string> collidingsizesfiles; // size histograms of all nodes
+  std::string nodename;        // name of this node in the manifest
+  std::string chunkreportfile; // where to write the chunks files share
+  std::size_t chunksize = 8192; // average size of the chunks of the report
+  bool mergemanifests = false; // merge the manifests given instead of files
+  std::uint64_t shardindex = 0; // which shard to process, counted from zero
+  std::uint64_t shardcount = 0; // number of shards, zero if not sharding
+  bool mergeresults = false;    // merge the results files given instead
+  std::string applyfile;        // take the action on this results file
+  bool applyverify = false;     // compare the contents before the action
   std::uint64_t first_bytes_size =
     4096; // how much to read during the "read first bytes" step
   std::uint64_t last_bytes_size =
@@ -0,0 +1,113 @@
+/*
+   copyright 2026 Paul Dreik
+   Distributed under GPL v 2.0 or later, at your option.
+   See LICENSE for further details.
+*/
+
+#include "config.h"
+
+// std
+#include <algorithm>
+
+// os
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// project
+#include "PageCache.hh"
+
+namespace {
+// how much is mapped at a time to look up the pages
+constexpr std::uint64_t WindowPages = 1 << 18;
+// the page cache keeps pages in folios of up to this size, which are only
+// dropped as a whole, so the pages read are dropped in pieces aligned to it
+constexpr std::uint64_t FolioSize = 2 << 20;
+} // namespace
+
+CacheKeeper::CacheKeeper(int fd,
+                         std::uint64_t begin,
+                         std::uint64_t end,
+                         bool sequential)
+  : m_fd(fd)
+  , m_pagesize(static_cast<std::uint64_t>(sysconf(_SC_PAGESIZE)))
+  , m_firstpage(begin / m_pagesize)
+  , m_endpage((end + m_pagesize - 1) / m_pagesize)
+  , m_released(m_firstpage)
+{
+  if (m_endpage <= m_firstpage) {
+    return;
+  }
+  posix_fadvise(fd,
+                static_cast<off_t>(begin),
+                static_cast<off_t>(end - begin),
+                sequential ? POSIX_FADV_SEQUENTIAL : POSIX_FADV_RANDOM);
+
+  // mapping the file does not read it, and mincore only tells which pages
+  // are cached
+  const auto npages = m_endpage - m_firstpage;
+  std::vector<unsigned char> vec(std::min(npages, WindowPages));
+  m_resident.reserve(npages);
+  for (std::uint64_t page = m_firstpage; page < m_endpage;
+       page += WindowPages) {
+    const auto count = std::min(WindowPages, m_endpage - page);
+    const auto length = count * m_pagesize;
+    void* addr = mmap(nullptr,
+                      length,
+                      PROT_READ,
+                      MAP_SHARED,
+                      fd,
+                      static_cast<off_t>(page * m_pagesize));
+    if (addr == MAP_FAILED) {
+      m_resident.clear();
+      return;
+    }
+    const int ret = mincore(addr, length, vec.data());
+    munmap(addr, length);
+    if (ret != 0) {
+      m_resident.clear();
+      return;
+    }
+    for (std::uint64_t i = 0; i < count; ++i) {
+      m_resident.push_back((vec[i] & 1) != 0);
+    }
+  }
+}
+
+void
+CacheKeeper::release(std::uint64_t offset)
+{
+  drop(offset / FolioSize * FolioSize / m_pagesize);
+}
+
+CacheKeeper::~CacheKeeper()
+{
+  drop(m_endpage);
+}
+
+void
+CacheKeeper::drop(std::uint64_t upto)
+{
+  upto = std::min(upto, m_endpage);
+  if (m_resident.empty()) {
+    m_released = std::max(m_released, upto);
+    return;
+  }
+  // the pages which were not cached are dropped in runs
+  std::uint64_t page = m_released;
+  while (page < upto) {
+    if (m_resident[page - m_firstpage]) {
+      ++page;
+      continue;
+    }
+    const auto start = page;
+    while (page < upto && !m_resident[page - m_firstpage]) {
+      ++page;
+    }
+    posix_fadvise(m_fd,
+                  static_cast<off_t>(start * m_pagesize),
+                  static_cast<off_t>((page - start) * m_pagesize),
+                  POSIX_FADV_DONTNEED);
+  }
+  m_released = std::max(m_released, upto);
+}
@@ -0,0 +1,51 @@
+/*
+   copyright 2026 Paul Dreik
+   Distributed under GPL v 2.0 or later, at your option.
+   See LICENSE for further details.
+*/
+#ifndef RDFIND_PAGECACHE_HH_
+#define RDFIND_PAGECACHE_HH_
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * Leaves the page cache as it was found, while a range of a file is read.
+ * Which pages of the range were cached before is looked up with mincore,
+ * and the others are dropped with POSIX_FADV_DONTNEED as the reading
+ * proceeds, so reading files does not push out the pages other programs
+ * use. The kernel is also told if the range is read sequentially, or if it
+ * is a short probe which readahead would only waste reads on.
+ *
+ * If the pages can not be looked up, none are dropped.
+ */
+class CacheKeeper
+{
+public:
+  /**
+   * @param fd the file, which has to stay open while this exists
+   * @param sequential true if the range is read from start to end
+   */
+  CacheKeeper(int fd, std::uint64_t begin, std::uint64_t end, bool sequential);
+  CacheKeeper(const CacheKeeper&) = delete;
+  CacheKeeper& operator=(const CacheKeeper&) = delete;
+
+  /// drops the pages of the range which was read up to offset
+  void release(std::uint64_t offset);
+
+  /// drops the rest of the pages of the range
+  ~CacheKeeper();
+
+private:
+  /// drops the pages which were not cached before, up to the page upto
+  void drop(std::uint64_t upto);
+
+  int m_fd;
+  std::uint64_t m_pagesize;
+  std::uint64_t m_firstpage; // the page holding the beginning of the range
+  std::uint64_t m_endpage;   // the page after the one holding the end
+  std::uint64_t m_released;  // the pages before this are done
+  std::vector<bool> m_resident; // for each page, if it was cached before
+};
+
+#endif /* RDFIND_PAGECACHE_HH_ */
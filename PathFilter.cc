@@ -0,0 +1,149 @@
+/*
+   copyright 2026 Paul Dreik
+   Distributed under GPL v 2.0 or later, at your option.
+   See LICENSE for further details.
+*/
+
+#include "config.h"
+
+// std
+#include <cstring>
+#include <iostream>
+#include <string_view>
+
+// os
+#include <fnmatch.h>
+
+// project
+#include "Options.hh"
+#include "PathFilter.hh"
+
+PathFilter::~PathFilter()
+{
+  for (auto& regex : m_exclude.regexes) {
+    regfree(&regex);
+  }
+  for (auto& regex : m_include.regexes) {
+    regfree(&regex);
+  }
+}
+
+int
+PathFilter::compile(const Options& options)
+{
+  for (const auto& glob : options.excludeglobs) {
+    if (0 != m_exclude.addglob(glob)) {
+      return -1;
+    }
+  }
+  for (const auto& glob : options.includeglobs) {
+    if (0 != m_include.addglob(glob)) {
+      return -1;
+    }
+  }
+  for (const auto& expression : options.excluderegexes) {
+    if (0 != m_exclude.addregex(expression)) {
+      return -1;
+    }
+  }
+  for (const auto& expression : options.includeregexes) {
+    if (0 != m_include.addregex(expression)) {
+      return -1;
+    }
+  }
+  m_active = !m_exclude.empty() || !m_include.empty();
+  return 0;
+}
+
+bool
+PathFilter::excluded(const std::string& dir, const char* name) const
+{
+  return m_exclude.matches(dir, name);
+}
+
+bool
+PathFilter::included(const std::string& dir, const char* name) const
+{
+  return m_include.empty() || m_include.matches(dir, name);
+}
+
+bool
+PathFilter::Patterns::empty() const
+{
+  return names.empty() && suffixes.empty() && nameglobs.empty() &&
+         pathglobs.empty() && regexes.empty();
+}
+
+int
+PathFilter::Patterns::addglob(const std::string& glob)
+{
+  constexpr const char* wildcards = "*?[\\";
+  if (glob.find('/') != std::string::npos) {
+    pathglobs.push_back(glob);
+  } else if (glob.find_first_of(wildcards) == std::string::npos) {
+    names.insert(glob);
+  } else if (glob.size() > 1 && glob[0] == '*' &&
+             glob.find_first_of(wildcards, 1) == std::string::npos) {
+    suffixes.push_back(glob.substr(1));
+  } else {
+    nameglobs.push_back(glob);
+  }
+  return 0;
+}
+
+int
+PathFilter::Patterns::addregex(const std::string& expression)
+{
+  regex_t regex;
+  const int ret =
+    regcomp(&regex, expression.c_str(), REG_EXTENDED | REG_NOSUB);
+  if (ret != 0) {
+    char message[256];
+    regerror(ret, &regex, message, sizeof(message));
+    std::cerr << "bad regular expression \"" << expression << "\": " << message
+              << '\n';
+    return -1;
+  }
+  regexes.push_back(regex);
+  return 0;
+}
+
+bool
+PathFilter::Patterns::matches(const std::string& dir, const char* name) const
+{
+  // the cheap checks on the name first
+  if (!names.empty() && names.count(std::string_view(name)) != 0) {
+    return true;
+  }
+  if (!suffixes.empty()) {
+    const auto length = std::strlen(name);
+    for (const auto& suffix : suffixes) {
+      if (length >= suffix.size() &&
+          0 == std::memcmp(
+                 name + length - suffix.size(), suffix.data(), suffix.size())) {
+        return true;
+      }
+    }
+  }
+  for (const auto& glob : nameglobs) {
+    if (0 == fnmatch(glob.c_str(), name, 0)) {
+      return true;
+    }
+  }
+  if (pathglobs.empty() && regexes.empty()) {
+    return false;
+  }
+
+  const std::string path = dir.empty() ? name : (dir + "/" + name);
+  for (const auto& glob : pathglobs) {
+    if (0 == fnmatch(glob.c_str(), path.c_str(), 0)) {
+      return true;
+    }
+  }
+  for (const auto& regex : regexes) {
+    if (0 == regexec(&regex, path.c_str(), 0, nullptr, 0)) {
+      return true;
+    }
+  }
+  return false;
+}
@@ -0,0 +1,77 @@
+/*
+   copyright 2026 Paul Dreik
+   Distributed under GPL v 2.0 or later, at your option.
+   See LICENSE for further details.
+*/
+#ifndef RDFIND_PATHFILTER_HH_
+#define RDFIND_PATHFILTER_HH_
+
+#include <functional>
+#include <set>
+#include <string>
+#include <vector>
+
+// os
+#include <regex.h>
+
+struct Options;
+
+/**
+ * Decides which entries of a directory to skip, from the -exclude and
+ * -include options. The decision is made from the name alone, so skipped
+ * entries need not be looked at and skipped directories are not entered.
+ *
+ * Globs without a slash match the name of the entry, globs with a slash and
+ * regular expressions the name rdfind gives it (the directory, a slash and
+ * the name). Excluded entries are skipped, files and directories alike. If
+ * there are include patterns, only files matching one of them are kept.
+ */
+class PathFilter
+{
+public:
+  PathFilter() = default;
+  PathFilter(const PathFilter&) = delete;
+  PathFilter& operator=(const PathFilter&) = delete;
+  ~PathFilter();
+
+  /**
+   * compiles the patterns given in the options.
+   * @return zero on success
+   */
+  int compile(const Options& options);
+
+  /// false if there is nothing to filter on
+  bool active() const { return m_active; }
+
+  /// true if the entry name in directory dir shall be skipped
+  bool excluded(const std::string& dir, const char* name) const;
+
+  /// true if the file name in directory dir shall be kept, if not excluded
+  bool included(const std::string& dir, const char* name) const;
+
+private:
+  /// the patterns of one kind, sorted on how they are matched
+  struct Patterns
+  {
+    // globs without wildcards, matched by lookup
+    std::set<std::string, std::less<>> names;
+    // globs like *.ext, matched on the end of the name
+    std::vector<std::string> suffixes;
+    // other globs without a slash, matched with fnmatch on the name
+    std::vector<std::string> nameglobs;
+    // globs with a slash, matched with fnmatch on the whole name
+    std::vector<std::string> pathglobs;
+    std::vector<regex_t> regexes;
+
+    bool empty() const;
+    int addglob(const std::string& glob);
+    int addregex(const std::string& expression);
+    bool matches(const std::string& dir, const char* name) const;
+  };
+
+  Patterns m_exclude;
+  Patterns m_include;
+  bool m_active = false;
+};
+
+#endif /* RDFIND_PATHFILTER_HH_ */
@@ -9,17 +9,28 @@
 
 // std
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <chrono>
+#include <condition_variable>
 #include <cstring>
+#include <deque>
 #include <fstream>  //for file writing
 #include <iostream> //for std::cerr
+#include <map>
+#include <memory>
+#include <mutex>
 #include <ostream>  //for output
 #include <string>   //for easier passing of string arguments
 #include <thread>   //sleep
 
+// os
+#include <fcntl.h>
+#include <unistd.h>
+
 // project
 #include "Checksum.hh"
+#include "ExtentMap.hh"
 #include "Fileinfo.hh" //file container
 #include "Options.hh"
 #include "RdfindDebug.hh"
@@ -27,6 +38,24 @@
 // class declaration
 #include "Rdutil.hh"
 
+void
+Rdutil::addbufferprovider(bufferprovider provider)
+{
+  m_bufferproviders.push_back(std::move(provider));
+}
+
+void
+Rdutil::addbufferobserver(bufferobserver observer)
+{
+  m_bufferobservers.push_back(std::move(observer));
+}
+
+void
+Rdutil::addgroupobserver(groupobserver observer)
+{
+  m_groupobservers.push_back(std::move(observer));
+}
+
 bool
 Rdutil::trywritetofile(const std::string& filename)
 {
@@ -34,33 +63,70 @@ Rdutil::trywritetofile(const std::string& filename)
 }
 
 int
-Rdutil::printtofile(const std::string& filename) const
+Rdutil::printtofile(const std::string& filename,
+                    resultsformat format,
+                    std::size_t digestlength,
+                    const std::vector<Fileinfo>& directories) const
 {
   // open a file to print to
-  std::ofstream f1(filename);
-  if (!f1.is_open()) {
-    std::cerr << "could not open file \"" << filename << "\"\n";
+  ResultsWriter writer(format, digestlength);
+  if (0 != writer.open(filename)) {
     return -1;
   }
 
-  // exchange f1 for cout to write to terminal instead of file
-  std::ostream& output(f1);
+  for (const auto& directory : directories) {
+    writer.add(directory);
+  }
+  writeto(writer);
+  return writer.close();
+}
 
+void
+Rdutil::writeto(ResultsWriter& writer) const
+{
+  for (std::size_t i = 0; i < m_list.size(); ++i) {
+    writer.add(m_list[i]);
+    if (i < m_notes.size() && !m_notes[i].empty()) {
+      writer.comment(m_notes[i]);
+    }
+  }
+}
+
+void
+Rdutil::printtostream(std::ostream& output) const
+{
+  printheader(output);
+  for (const auto& file : m_list) {
+    printresultline(output, file, file.get_cmdline_index(), file.name());
+  }
+  printfooter(output);
+}
+
+void
+Rdutil::printheader(std::ostream& output)
+{
   // This uses "priority" instead of "cmdlineindex". Change this the day
   // a change in output format is allowed (for backwards compatibility).
   output << "# Automatically generated\n";
   output << "# duptype id depth size device inode priority name\n";
+}
 
-  std::vector<Fileinfo>::iterator it;
-  for (it = m_list.begin(); it != m_list.end(); ++it) {
-    output << Fileinfo::getduptypestring(*it) << " " << it->getidentity() << " "
-           << it->depth() << " " << it->size() << " " << it->device() << " "
-           << it->inode() << " " << it->get_cmdline_index() << " " << it->name()
-           << '\n';
-  }
+void
+Rdutil::printfooter(std::ostream& output)
+{
   output << "# end of file\n";
-  f1.close();
-  return 0;
+}
+
+void
+Rdutil::printresultline(std::ostream& output,
+                        const Fileinfo& file,
+                        int cmdline_index,
+                        const std::string& name)
+{
+  output << Fileinfo::getduptypestring(file) << " " << file.getidentity()
+         << " " << file.depth() << " " << file.size() << " " << file.device()
+         << " " << file.inode() << " " << cmdline_index << " " << name
+         << '\n';
 }
 
 // applies int f(duplicate,const original) on every duplicate.
@@ -109,6 +175,83 @@ applyactiononfile(std::vector<Fileinfo>& m_list, Function f)
   return ntimesapplied;
 }
 
+namespace {
+/**
+ * applies int f(dirfd, entry, duplicate, const original) on every duplicate,
+ * like applyactiononfile, where entry is the name of the duplicate in the
+ * directory dirfd. the duplicates are grouped on their directory, which is
+ * opened once, and the directories are taken care of by nthreads threads.
+ * returns how many times the function succeeded.
+ */
+template<typename Function>
+std::size_t
+applyactionbydirectory(std::vector<Fileinfo>& m_list,
+                       std::size_t nthreads,
+                       Function f)
+{
+  struct Job
+  {
+    Fileinfo* duplicate;
+    const Fileinfo* original;
+    std::string entry;
+  };
+  std::map<std::string, std::vector<Job>> bydirectory;
+  applyactiononfile(m_list, [&](Fileinfo& duplicate, const Fileinfo& original) {
+    const auto& name = duplicate.name();
+    const auto last_sep = name.find_last_of('/');
+    if (last_sep == std::string::npos) {
+      bydirectory["."].push_back({ &duplicate, &original, name });
+    } else {
+      bydirectory[last_sep == 0 ? "/" : name.substr(0, last_sep)].push_back(
+        { &duplicate, &original, name.substr(last_sep + 1) });
+    }
+    return 0;
+  });
+
+  std::vector<std::pair<const std::string, std::vector<Job>>*> directories;
+  for (auto& directory : bydirectory) {
+    directories.push_back(&directory);
+  }
+  std::atomic<std::size_t> next{ 0 };
+  std::atomic<std::size_t> ntimesapplied{ 0 };
+  auto worker = [&]() {
+    for (auto i = next++; i < directories.size(); i = next++) {
+      auto& jobs = directories[i]->second;
+      const int dirfd =
+        open(directories[i]->first.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+      for (auto& job : jobs) {
+        // if the directory can not be opened, the files are still tried one
+        // by one, to report each of them as before.
+        const int ret =
+          dirfd >= 0 ? f(dirfd, job.entry, *job.duplicate, *job.original)
+                     : f(AT_FDCWD,
+                         job.duplicate->name(),
+                         *job.duplicate,
+                         *job.original);
+        if (ret) {
+          RDDEBUG(__FILE__ ": Failed to apply function f on it.\n");
+        } else {
+          ++ntimesapplied;
+        }
+      }
+      if (dirfd >= 0) {
+        close(dirfd);
+      }
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (std::size_t i = 1; i < std::min(nthreads, directories.size()); ++i) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  return ntimesapplied;
+}
+} // namespace
+
 // helper for dryruns
 namespace {
 template<bool outputBname>
@@ -144,7 +287,7 @@ public:
 } // namespace
 
 std::size_t
-Rdutil::deleteduplicates(bool dryrun) const
+Rdutil::deleteduplicates(bool dryrun, std::size_t nthreads) const
 {
   if (dryrun) {
     const bool outputBname = false;
@@ -153,12 +296,17 @@ Rdutil::deleteduplicates(bool dryrun) const
     std::cout.flush();
     return ret;
   } else {
-    return applyactiononfile(m_list, &Fileinfo::static_deletefile);
+    return applyactionbydirectory(
+      m_list,
+      nthreads,
+      [](int dirfd, const std::string& entry, Fileinfo& A, const Fileinfo&) {
+        return A.deletefileat(dirfd, entry);
+      });
   }
 }
 
 std::size_t
-Rdutil::makesymlinks(bool dryrun) const
+Rdutil::makesymlinks(bool dryrun, std::size_t nthreads) const
 {
   if (dryrun) {
     const bool outputBname = true;
@@ -167,12 +315,23 @@ Rdutil::makesymlinks(bool dryrun) const
     std::cout.flush();
     return ret;
   } else {
-    return applyactiononfile(m_list, &Fileinfo::static_makesymlink);
+    // the targets are made absolute with the same directory for all
+    std::string cwd;
+    Fileinfo::currentdirectory(cwd);
+    return applyactionbydirectory(
+      m_list,
+      nthreads,
+      [&cwd](int dirfd,
+             const std::string& entry,
+             Fileinfo& A,
+             const Fileinfo& B) {
+        return A.makesymlinkat(dirfd, entry, B, cwd);
+      });
   }
 }
 
 std::size_t
-Rdutil::makehardlinks(bool dryrun) const
+Rdutil::makehardlinks(bool dryrun, std::size_t nthreads) const
 {
   if (dryrun) {
     const bool outputBname = true;
@@ -181,7 +340,12 @@ Rdutil::makehardlinks(bool dryrun) const
     std::cout.flush();
     return ret;
   } else {
-    return applyactiononfile(m_list, &Fileinfo::static_makehardlink);
+    return applyactionbydirectory(
+      m_list,
+      nthreads,
+      [](int dirfd, const std::string& entry, Fileinfo& A, const Fileinfo& B) {
+        return A.makehardlinkat(dirfd, entry, B);
+      });
   }
 }
 
@@ -289,6 +453,61 @@ apply_on_range(Iterator first, Iterator last, Cmp cmp, Callback callback)
     }
   }
 }
+/**
+ * marks the files in [first,last) as one set of duplicates. the one with the
+ * lowest rank is the original, it is placed first.
+ */
+template<class Iterator>
+void
+markset(const Iterator first, const Iterator last)
+{
+  assert(first != last);
+
+  // the one with the lowest rank is the original
+  auto orig = std::min_element(first, last, cmpRank);
+  assert(orig != last);
+  // place it first, so later stages will find the original first.
+  std::iter_swap(first, orig);
+  orig = first;
+
+  // make sure they are all duplicates
+  assert(last == find_if_not(first, last, [orig](const Fileinfo& a) {
+           return orig->size() == a.size() && hasEqualBuffers(*orig, a);
+         }));
+
+  // mark the files with the appropriate tag.
+  auto marker = [orig](Fileinfo& elem) {
+    elem.setidentity(-orig->getidentity());
+    if (elem.get_cmdline_index() == orig->get_cmdline_index()) {
+      elem.setduptype(Fileinfo::duptype::DUPTYPE_WITHIN_SAME_TREE);
+    } else {
+      elem.setduptype(Fileinfo::duptype::DUPTYPE_OUTSIDE_TREE);
+    }
+  };
+  orig->setduptype(Fileinfo::duptype::DUPTYPE_FIRST_OCCURRENCE);
+  std::for_each(first + 1, last, marker);
+  assert(first->getduptype() == Fileinfo::duptype::DUPTYPE_FIRST_OCCURRENCE);
+}
+
+/**
+ * after marking, invokes callback(setfirst,setlast) on each set of
+ * duplicates in [first,last), which starts with its original.
+ */
+template<class Iterator, class Callback>
+void
+apply_on_sets(Iterator first, Iterator last, Callback callback)
+{
+  while (first != last) {
+    assert(first->getduptype() == Fileinfo::duptype::DUPTYPE_FIRST_OCCURRENCE);
+    const auto identity = first->getidentity();
+    const auto setlast =
+      std::find_if(first + 1, last, [identity](const Fileinfo& f) {
+        return f.getidentity() != -identity;
+      });
+    callback(first, setlast);
+    first = setlast;
+  }
+}
 } // namespace
 int
 Rdutil::sortOnDeviceAndInode()
@@ -298,6 +517,42 @@ Rdutil::sortOnDeviceAndInode()
   return 0;
 }
 
+void
+Rdutil::sortOnRank()
+{
+  std::sort(m_list.begin(), m_list.end(), cmpRank);
+}
+
+void
+Rdutil::sortOnDeviceAndPhysical(Fileinfo::readtobuffermode mode)
+{
+  for (const auto& file : m_list) {
+    if (m_physical.count(file.getidentity()) == 0) {
+      std::uint64_t first = 0;
+      std::uint64_t last = 0;
+      if (0 != readphysicalrange(file.name(),
+                                 static_cast<std::uint64_t>(file.size()),
+                                 first,
+                                 last)) {
+        first = last = 0;
+      }
+      m_physical.emplace(file.getidentity(), std::make_pair(first, last));
+    }
+  }
+
+  const bool readslast = mode == Fileinfo::readtobuffermode::READ_LAST_BYTES;
+  auto place = [&](const Fileinfo& file) {
+    const auto& range = m_physical.at(file.getidentity());
+    return std::make_tuple(
+      file.device(), readslast ? range.second : range.first, file.inode());
+  };
+  std::sort(m_list.begin(),
+            m_list.end(),
+            [&](const Fileinfo& a, const Fileinfo& b) {
+              return place(a) < place(b);
+            });
+}
+
 void
 Rdutil::sort_on_depth_and_name(std::size_t index_of_first)
 {
@@ -350,6 +605,30 @@ Rdutil::removeUniqueSizes()
   return cleanup();
 }
 
+std::uint64_t
+Rdutil::shardof(Fileinfo::filesizetype size, std::uint64_t count)
+{
+  // mix the bits of the size, so that sizes being multiples of a block size
+  // are spread over the shards as well.
+  auto x = static_cast<std::uint64_t>(size);
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9U;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebU;
+  x ^= x >> 31;
+  return x % count;
+}
+
+std::size_t
+Rdutil::removeOtherShards(std::uint64_t index, std::uint64_t count)
+{
+  assert(index < count);
+  for (auto& file : m_list) {
+    file.setdeleteflag(shardof(file.size(), count) != index);
+  }
+  return cleanup();
+}
+
 std::size_t
 Rdutil::removeUniqSizeAndBuffer()
 {
@@ -382,8 +661,8 @@ Rdutil::removeUniqSizeAndBuffer()
   return cleanup();
 }
 
-void
-Rdutil::markduplicates()
+std::size_t
+Rdutil::markduplicates(bool perdevice)
 {
   const auto cmp = cmpSizeThenBuffer;
   assert(std::is_sorted(m_list.begin(), m_list.end(), cmp));
@@ -394,36 +673,129 @@ Rdutil::markduplicates()
     m_list.begin(),
     m_list.end(),
     cmp,
-    [](const Iterator first, const Iterator last) {
+    [perdevice](const Iterator first, const Iterator last) {
       // size and buffer are equal in  [first,last) - all are duplicates!
       assert(std::distance(first, last) >= 2);
-
-      // the one with the lowest rank is the original
-      auto orig = std::min_element(first, last, cmpRank);
-      assert(orig != last);
-      // place it first, so later stages will find the original first.
-      std::iter_swap(first, orig);
-      orig = first;
-
-      // make sure they are all duplicates
-      assert(last == find_if_not(first, last, [orig](const Fileinfo& a) {
-               return orig->size() == a.size() && hasEqualBuffers(*orig, a);
-             }));
-
-      // mark the files with the appropriate tag.
-      auto marker = [orig](Fileinfo& elem) {
-        elem.setidentity(-orig->getidentity());
-        if (elem.get_cmdline_index() == orig->get_cmdline_index()) {
-          elem.setduptype(Fileinfo::duptype::DUPTYPE_WITHIN_SAME_TREE);
-        } else {
-          elem.setduptype(Fileinfo::duptype::DUPTYPE_OUTSIDE_TREE);
-        }
+      if (!perdevice) {
+        markset(first, last);
+        return;
+      }
+      // hard links can not cross devices, so each device gets a set with
+      // an original of its own.
+      auto cmpDevice = [](const Fileinfo& a, const Fileinfo& b) {
+        return a.device() < b.device();
       };
-      orig->setduptype(Fileinfo::duptype::DUPTYPE_FIRST_OCCURRENCE);
-      std::for_each(first + 1, last, marker);
-      assert(first->getduptype() ==
-             Fileinfo::duptype::DUPTYPE_FIRST_OCCURRENCE);
+      std::sort(first, last, cmpDevice);
+      apply_on_range(
+        first, last, cmpDevice, [](const Iterator d, const Iterator dlast) {
+          if (d + 1 == dlast) {
+            // nothing to link it with
+            d->setdeleteflag(true);
+          } else {
+            markset(d, dlast);
+          }
+        });
     });
+  return perdevice ? cleanup() : 0;
+}
+
+void
+Rdutil::observegroups() const
+{
+  if (m_groupobservers.empty()) {
+    return;
+  }
+  using Iterator = decltype(m_list.cbegin());
+  apply_on_range(m_list.cbegin(),
+                 m_list.cend(),
+                 cmpSizeThenBuffer,
+                 [this](Iterator first, Iterator last) {
+                   for (const auto& observer : m_groupobservers) {
+                     observer(std::vector<Fileinfo>(first, last));
+                   }
+                 });
+}
+
+std::size_t
+Rdutil::removereferenceduplicates(int lastreferenceindex)
+{
+  assert(std::is_sorted(m_list.begin(), m_list.end(), cmpSizeThenBuffer));
+
+  auto isreference = [lastreferenceindex](const Fileinfo& f) {
+    return f.get_cmdline_index() <= lastreferenceindex;
+  };
+
+  // loop over the sets of duplicates
+  using Iterator = decltype(m_list.begin());
+  apply_on_sets(
+    m_list.begin(), m_list.end(), [&](Iterator first, Iterator last) {
+      // the original is first. keep it, and the duplicates which are not in
+      // the reference, if there are any.
+      const bool allreference = std::all_of(first, last, isreference);
+      first->setdeleteflag(allreference);
+      std::for_each(first + 1, last, [&](Fileinfo& f) {
+        f.setdeleteflag(allreference || isreference(f));
+      });
+    });
+  return cleanup();
+}
+
+DedupSummary
+Rdutil::dedupextents(bool dryrun, std::size_t nthreads)
+{
+  DedupSummary summary;
+  if (dryrun) {
+    const bool outputBname = true;
+    dryrun_helper<outputBname> obj("share extents of ", " with ");
+    summary.shared = applyactiononfile(m_list, obj);
+    summary.bytes = static_cast<std::uint64_t>(totalsizeinbytes(0) -
+                                               totalsizeinbytes(1));
+    std::cout.flush();
+    return summary;
+  }
+
+  using Iterator = decltype(m_list.begin());
+  std::vector<std::pair<Iterator, Iterator>> sets;
+  apply_on_sets(
+    m_list.begin(), m_list.end(), [&](Iterator first, Iterator last) {
+      if (std::distance(first, last) >= 2) {
+        sets.emplace_back(first, last);
+      }
+    });
+
+  m_notes.assign(m_list.size(), std::string());
+  std::atomic<std::size_t> next{ 0 };
+  std::mutex summarymutex;
+  auto worker = [&]() {
+    DedupSummary mine;
+    for (auto i = next++; i < sets.size(); i = next++) {
+      const auto first = sets[i].first;
+      const auto last = sets[i].second;
+      std::vector<const Fileinfo*> duplicates;
+      for (auto it = first + 1; it != last; ++it) {
+        duplicates.push_back(&*it);
+      }
+      const auto outcomes = ::dedupextents(*first, duplicates);
+      const auto size = static_cast<std::uint64_t>(first->size());
+      auto note = m_notes.begin() + std::distance(m_list.begin(), first) + 1;
+      for (const auto& outcome : outcomes) {
+        mine.add(outcome, size);
+        *note++ = outcome.describe(size);
+      }
+    }
+    std::lock_guard<std::mutex> lock(summarymutex);
+    summary.add(mine);
+  };
+
+  std::vector<std::thread> threads;
+  for (std::size_t i = 1; i < std::min(nthreads, sets.size()); ++i) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  return summary;
 }
 
 std::size_t
@@ -546,45 +918,92 @@ Rdutil::saveablespace(std::ostream& out) const
   return out;
 }
 
-int
-Rdutil::fillwithbytes(enum Fileinfo::readtobuffermode type,
-                      enum Fileinfo::readtobuffermode lasttype,
-                      const Options& options,
-                      std::function<void(std::size_t)> progress_cb)
+checksumtypes
+Rdutil::checksumtypefor(Fileinfo::readtobuffermode type, const Options& options)
 {
-  // first sort on inode (to read efficiently from the hard drive)
-  sortOnDeviceAndInode();
-
-  // make a checksum object which can be reused to avoid creating an object
-  // per processed file
-  checksumtypes cktype{};
   switch (type) {
     case Fileinfo::readtobuffermode::READ_FIRST_BYTES:
-      cktype = options.checksum_for_firstlast_bytes;
-      break;
+      return options.checksum_for_firstlast_bytes;
     case Fileinfo::readtobuffermode::READ_LAST_BYTES:
-      cktype = options.checksum_for_firstlast_bytes;
-      break;
+      return options.checksum_for_firstlast_bytes;
     case Fileinfo::readtobuffermode::CREATE_XXH128_CHECKSUM:
-      cktype = checksumtypes::XXH128;
-      break;
+      return checksumtypes::XXH128;
     case Fileinfo::readtobuffermode::CREATE_SHA1_CHECKSUM:
-      cktype = checksumtypes::SHA1;
-      break;
+      return checksumtypes::SHA1;
     case Fileinfo::readtobuffermode::CREATE_SHA256_CHECKSUM:
-      cktype = checksumtypes::SHA256;
-      break;
+      return checksumtypes::SHA256;
     case Fileinfo::readtobuffermode::CREATE_SHA512_CHECKSUM:
-      cktype = checksumtypes::SHA512;
-      break;
+      return checksumtypes::SHA512;
     case Fileinfo::readtobuffermode::CREATE_MD5_CHECKSUM:
-      cktype = checksumtypes::MD5;
-      break;
+      return checksumtypes::MD5;
     default:
       throw std::runtime_error("bad readtobuffermode");
   }
+}
+
+std::size_t
+Rdutil::digestlength(const Options& options)
+{
+  const auto modes = stages(options);
+  if (modes.empty()) {
+    return 0;
+  }
+  const Checksum cksum(checksumtypefor(modes.back().first, options));
+  return static_cast<std::size_t>(cksum.getDigestLength());
+}
+
+std::vector<std::pair<Fileinfo::readtobuffermode, const char*>>
+Rdutil::stages(const Options& o)
+{
+  std::vector<std::pair<Fileinfo::readtobuffermode, const char*>> modes;
+  if (o.first_bytes_size > 0) {
+    modes.emplace_back(Fileinfo::readtobuffermode::READ_FIRST_BYTES,
+                       "first bytes");
+  }
+  if (o.last_bytes_size > 0) {
+    modes.emplace_back(Fileinfo::readtobuffermode::READ_LAST_BYTES,
+                       "last bytes");
+  }
+  if (o.usemd5) {
+    modes.emplace_back(Fileinfo::readtobuffermode::CREATE_MD5_CHECKSUM,
+                       "md5 checksum");
+  }
+  if (o.usesha1) {
+    modes.emplace_back(Fileinfo::readtobuffermode::CREATE_SHA1_CHECKSUM,
+                       "sha1 checksum");
+  }
+  if (o.usesha256) {
+    modes.emplace_back(Fileinfo::readtobuffermode::CREATE_SHA256_CHECKSUM,
+                       "sha256 checksum");
+  }
+  if (o.usesha512) {
+    modes.emplace_back(Fileinfo::readtobuffermode::CREATE_SHA512_CHECKSUM,
+                       "sha512 checksum");
+  }
+  if (o.usexxh128) {
+    modes.emplace_back(Fileinfo::readtobuffermode::CREATE_XXH128_CHECKSUM,
+                       "xxh128 checksum");
+  }
+  return modes;
+}
+
+int
+Rdutil::fillwithbytes(enum Fileinfo::readtobuffermode type,
+                      enum Fileinfo::readtobuffermode lasttype,
+                      const Options& options,
+                      std::function<void(std::size_t)> progress_cb)
+{
+  // first sort on where the files are (to read efficiently from the hard
+  // drive)
+  if (options.readorder == readordering::PHYSICAL) {
+    sortOnDeviceAndPhysical(type);
+  } else {
+    sortOnDeviceAndInode();
+  }
 
-  Checksum cksum(cktype);
+  // make a checksum object which can be reused to avoid creating an object
+  // per processed file
+  Checksum cksum(checksumtypefor(type, options));
 
   const auto duration = std::chrono::nanoseconds{ options.nsecsleep };
 
@@ -596,10 +1015,213 @@ Rdutil::fillwithbytes(enum Fileinfo::readtobuffermode type,
       ++progress_count;
       progress_cb(progress_count);
     }
-    elem.fillwithbytes(type, lasttype, buffer, cksum, options);
+    const bool known = std::any_of(
+      m_bufferproviders.begin(),
+      m_bufferproviders.end(),
+      [&](const bufferprovider& provider) { return provider(elem, type); });
+    if (known) {
+      continue;
+    }
+    // a file which could not be read has no buffer worth remembering
+    if (0 == elem.fillwithbytes(type, lasttype, buffer, cksum, options)) {
+      for (const auto& observer : m_bufferobservers) {
+        observer(elem, type);
+      }
+    }
     if (options.nsecsleep > 0) {
       std::this_thread::sleep_for(duration);
     }
   }
   return 0;
 }
+
+namespace {
+/// files of the same size, and the same buffers in all stages so far
+struct CandidateGroup
+{
+  std::vector<Fileinfo*> members;
+  std::size_t stage;
+  // the members not read yet in this stage, guarded by the scheduler mutex
+  std::size_t remaining;
+};
+} // namespace
+
+std::size_t
+Rdutil::pipelinestages(const std::vector<Fileinfo::readtobuffermode>& modes,
+                       const Options& options,
+                       std::size_t nthreads,
+                       std::function<void(std::size_t)> progress_cb)
+{
+  const auto size_before = m_list.size();
+  if (modes.empty()) {
+    // all files of the same size are duplicates
+    std::sort(m_list.begin(), m_list.end(), cmpSizeThenBuffer);
+    observegroups();
+    return 0;
+  }
+
+  // the files still being candidates after the last stage are kept
+  for (auto& file : m_list) {
+    file.setdeleteflag(true);
+  }
+
+  // one task is reading one file of a group in the group's current stage.
+  // a group is split up when the last of its files has been read, and the
+  // parts which still have duplicates go on to the next stage at once.
+  using Task = std::pair<std::shared_ptr<CandidateGroup>, std::size_t>;
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::deque<Task> tasks;
+  std::size_t pendinggroups = 0;
+  std::size_t progress_count = 0;
+  // the confirmed groups, for the group observers. those may act on the
+  // files, so they are called without the mutex held, one at a time.
+  std::deque<std::vector<Fileinfo>> confirmedgroups;
+  std::mutex observermutex;
+
+  // must be called with the mutex held
+  auto schedule = [&](std::shared_ptr<CandidateGroup> group) {
+    // read in inode order, to read efficiently from the hard drive
+    std::sort(group->members.begin(),
+              group->members.end(),
+              [](const Fileinfo* a, const Fileinfo* b) {
+                return cmpDeviceInode(*a, *b);
+              });
+    group->remaining = group->members.size();
+    ++pendinggroups;
+    for (std::size_t i = 0; i < group->members.size(); ++i) {
+      tasks.emplace_back(group, i);
+    }
+  };
+
+  // must be called with the mutex held, when all members are read
+  auto split = [&](const std::shared_ptr<CandidateGroup>& group) {
+    --pendinggroups;
+    auto& members = group->members;
+    auto bufless = [](const Fileinfo* a, const Fileinfo* b) {
+      return cmpBuffers(*a, *b);
+    };
+    std::sort(members.begin(), members.end(), bufless);
+    for (auto first = members.begin(); first != members.end();) {
+      const auto last = std::upper_bound(first, members.end(), *first, bufless);
+      if (last - first >= 2) {
+        if (group->stage + 1 == modes.size()) {
+          std::for_each(
+            first, last, [](Fileinfo* f) { f->setdeleteflag(false); });
+          if (!m_groupobservers.empty()) {
+            auto& confirmed = confirmedgroups.emplace_back();
+            std::for_each(first, last, [&](const Fileinfo* f) {
+              confirmed.push_back(*f);
+            });
+          }
+        } else {
+          auto next = std::make_shared<CandidateGroup>();
+          next->members.assign(first, last);
+          next->stage = group->stage + 1;
+          schedule(std::move(next));
+        }
+      }
+      first = last;
+    }
+    if (pendinggroups == 0) {
+      cv.notify_all();
+    }
+  };
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::sort(m_list.begin(), m_list.end(), cmpSize);
+    using Iterator = decltype(m_list.begin());
+    apply_on_range(
+      m_list.begin(),
+      m_list.end(),
+      cmpSize,
+      [&](Iterator first, Iterator last) {
+        if (last - first < 2) {
+          return;
+        }
+        auto group = std::make_shared<CandidateGroup>();
+        for (auto it = first; it != last; ++it) {
+          group->members.push_back(&*it);
+        }
+        group->stage = 0;
+        schedule(std::move(group));
+      });
+  }
+
+  const auto duration = std::chrono::nanoseconds{ options.nsecsleep };
+  auto worker = [&]() {
+    std::vector<char> buffer(options.buffersize, '\0');
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+      cv.wait(lock, [&]() { return !tasks.empty() || pendinggroups == 0; });
+      if (tasks.empty()) {
+        return;
+      }
+      // the newest tasks first, so groups are finished one by one
+      const Task task = std::move(tasks.back());
+      tasks.pop_back();
+      auto& elem = *task.first->members[task.second];
+      const auto stage = task.first->stage;
+      const auto type = modes[stage];
+      const auto lasttype =
+        stage == 0 ? Fileinfo::readtobuffermode::NOT_DEFINED : modes[stage - 1];
+      if (progress_cb) {
+        progress_cb(++progress_count);
+      }
+      // providers and buffer observers are not made for several threads, so
+      // they are called with the mutex held.
+      const bool known = std::any_of(
+        m_bufferproviders.begin(),
+        m_bufferproviders.end(),
+        [&](const bufferprovider& provider) { return provider(elem, type); });
+      if (!known) {
+        lock.unlock();
+        Checksum cksum(checksumtypefor(type, options));
+        const bool read =
+          0 == elem.fillwithbytes(type, lasttype, buffer, cksum, options);
+        if (options.nsecsleep > 0) {
+          std::this_thread::sleep_for(duration);
+        }
+        lock.lock();
+        if (read) {
+          for (const auto& observer : m_bufferobservers) {
+            observer(elem, type);
+          }
+        }
+      }
+      if (--task.first->remaining == 0) {
+        split(task.first);
+      }
+      if (!confirmedgroups.empty()) {
+        auto confirmed = std::move(confirmedgroups);
+        confirmedgroups.clear();
+        lock.unlock();
+        {
+          std::lock_guard<std::mutex> observerlock(observermutex);
+          for (const auto& group : confirmed) {
+            for (const auto& observer : m_groupobservers) {
+              observer(group);
+            }
+          }
+        }
+        lock.lock();
+      }
+      cv.notify_all();
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (std::size_t i = 1; i < nthreads; ++i) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  cleanup();
+  // the same order removeUniqSizeAndBuffer leaves, for markduplicates
+  std::sort(m_list.begin(), m_list.end(), cmpSizeThenBuffer);
+  return size_before - m_list.size();
+}
@@ -9,10 +9,18 @@
 #ifndef rdutil_hh
 #define rdutil_hh
 
+#include <cstdint>
 #include <functional>
+#include <iosfwd>
+#include <string>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
+#include "ChecksumTypes.hh"
+#include "ExtentDedup.hh"
 #include "Fileinfo.hh" //file container
+#include "ResultsWriter.hh"
 
 struct Options;
 
@@ -24,6 +32,54 @@ public:
   {
   }
 
+  /**
+   * a function that may know the buffer of a file for a given read mode
+   * without reading the file. it returns true if it filled in the buffer.
+   */
+  using bufferprovider =
+    std::function<bool(Fileinfo&, Fileinfo::readtobuffermode)>;
+
+  /// a function which is told about each buffer read from a file
+  using bufferobserver =
+    std::function<void(const Fileinfo&, Fileinfo::readtobuffermode)>;
+
+  /// providers are asked in the order they were added, by fillwithbytes
+  void addbufferprovider(bufferprovider provider);
+
+  /// observers are invoked by fillwithbytes after a file has been read,
+  /// not when reading it failed
+  void addbufferobserver(bufferobserver observer);
+
+  /**
+   * a function which is told about each set of duplicates as soon as it is
+   * confirmed, given copies of the files. the files are not marked yet.
+   */
+  using groupobserver = std::function<void(std::vector<Fileinfo>)>;
+
+  /// group observers are invoked by pipelinestages and observegroups
+  void addgroupobserver(groupobserver observer);
+
+  /**
+   * tells the group observers about each set of duplicates in the list,
+   * which must be sorted on size and buffer. used when the sets are all
+   * confirmed at once, by the last stage.
+   */
+  void observegroups() const;
+
+  /**
+   * the elimination stages the options ask for, in the order they shall be
+   * made, together with a description.
+   */
+  static std::vector<std::pair<Fileinfo::readtobuffermode, const char*>>
+  stages(const Options& options);
+
+  /// the checksum used for reading in the given mode
+  static checksumtypes checksumtypefor(Fileinfo::readtobuffermode type,
+                                       const Options& options);
+
+  /// how many bytes of the buffer are the digest after the last stage
+  static std::size_t digestlength(const Options& options);
+
   /**
    * opens the given file for writing and closes it again.
    * @param filename
@@ -34,9 +90,34 @@ public:
   /**
    * print file names to a file, with extra information.
    * @param filename
+   * @param format
+   * @param digestlength see ResultsWriter
+   * @param directories written before the files, see DirDuplicates
    * @return zero on success
    */
-  int printtofile(const std::string& filename) const;
+  int printtofile(const std::string& filename,
+                  resultsformat format = resultsformat::TEXT,
+                  std::size_t digestlength = 0,
+                  const std::vector<Fileinfo>& directories = {}) const;
+
+  /// adds the files to writer, with the notes from dedupextents
+  void writeto(ResultsWriter& writer) const;
+
+  /// prints file names in the results file format to the given stream
+  void printtostream(std::ostream& output) const;
+
+  /// prints the comment lines which start the results file format
+  static void printheader(std::ostream& output);
+
+  /// prints the comment line which ends the results file format
+  static void printfooter(std::ostream& output);
+
+  /// prints one line of the results file format, with the given priority
+  /// and name instead of the ones of the file.
+  static void printresultline(std::ostream& output,
+                              const Fileinfo& file,
+                              int cmdline_index,
+                              const std::string& name);
 
   /// mark files with a unique number
   void markitems();
@@ -47,6 +128,18 @@ public:
    */
   int sortOnDeviceAndInode();
 
+  /// sorts the list on rank, the best ranked file first
+  void sortOnRank();
+
+  /**
+   * sorts the list on device, then on where the part of the file read by
+   * mode is stored on the device: the last byte for READ_LAST_BYTES, the
+   * first byte otherwise. the places are looked up with FIEMAP the first
+   * time a file is sorted. files the file system can not tell about come
+   * first, on inode.
+   */
+  void sortOnDeviceAndPhysical(Fileinfo::readtobuffermode mode);
+
   /**
    * sorts from the given index to the end on depth, then name.
    * this is useful to be independent of the filesystem order.
@@ -66,6 +159,17 @@ public:
    */
   std::size_t removeUniqueSizes();
 
+  /**
+   * remove files with a size belonging to another shard than index, out of
+   * count shards. all files of the same size belong to the same shard.
+   * @return the number of removed elements
+   */
+  std::size_t removeOtherShards(std::uint64_t index, std::uint64_t count);
+
+  /// the shard, counted from zero, files of the given size belong to
+  [[gnu::const]] static std::uint64_t shardof(Fileinfo::filesizetype size,
+                                              std::uint64_t count);
+
   /**
    * remove files with unique combination of size and buffer from the list.
    * @return
@@ -78,9 +182,21 @@ public:
    * nature. Shall be used when everything is done, and sorted.
    * For each sequence of duplicates, the original will be placed first but no
    * other guarantee on ordering is given.
-   *
+   * @param perdevice if true, the files on each device form a set of their
+   * own, so hard links can be made within each set. a file without
+   * duplicates on its device is removed from the list.
+   * @return the number of files removed
    */
-  void markduplicates();
+  std::size_t markduplicates(bool perdevice = false);
+
+  /**
+   * after markduplicates, removes the files found in the reference (with a
+   * command line index up to lastreferenceindex) except for the originals,
+   * so no action is taken on them. groups without files outside the
+   * reference are removed entirely.
+   * @return the number of files removed
+   */
+  std::size_t removereferenceduplicates(int lastreferenceindex);
 
   /// removes all items from the list, that have the deleteflag set to true.
   std::size_t cleanup();
@@ -97,19 +213,50 @@ public:
   // and file is read anyway.
   // if there is trouble with too much disk reading, sleeping for nsecsleep
   // nanoseconds can be made between each file.
+  // files with a buffer known by a buffer provider are not read.
   int fillwithbytes(enum Fileinfo::readtobuffermode type,
                     enum Fileinfo::readtobuffermode lasttype,
                     const Options& options,
                     std::function<void(std::size_t)> progress_cb);
 
+  /**
+   * runs the given elimination stages, like fillwithbytes followed by
+   * removeUniqSizeAndBuffer for each of them, but each group of candidates
+   * advances to the next stage as soon as its own files are read instead of
+   * waiting for all groups. the files are read by nthreads threads.
+   * group observers are told about each set of duplicates after the last
+   * stage, without the scheduler lock held. a mutex of their own keeps them
+   * from being called by several threads at once.
+   * afterwards, the list is sorted on size and buffer.
+   * @return the number of files removed
+   */
+  std::size_t pipelinestages(
+    const std::vector<Fileinfo::readtobuffermode>& modes,
+    const Options& options,
+    std::size_t nthreads,
+    std::function<void(std::size_t)> progress_cb);
+
+  // the actions on the duplicates. unless it is a dryrun, the duplicates are
+  // grouped on their directory, which is opened once, and nthreads threads
+  // take care of different directories. they return the number of files the
+  // action succeeded on.
+
   /// make symlinks of duplicates.
-  std::size_t makesymlinks(bool dryrun) const;
+  std::size_t makesymlinks(bool dryrun, std::size_t nthreads = 1) const;
 
   /// make hardlinks of duplicates.
-  std::size_t makehardlinks(bool dryrun) const;
+  std::size_t makehardlinks(bool dryrun, std::size_t nthreads = 1) const;
 
   /// delete duplicates from file system.
-  std::size_t deleteduplicates(bool dryrun) const;
+  std::size_t deleteduplicates(bool dryrun, std::size_t nthreads = 1) const;
+
+  /**
+   * make the duplicates share the extents of their original, see
+   * ExtentDedup.hh. the threads take care of different sets instead of
+   * directories. a note is kept for each file which was not shared
+   * completely, for writeto.
+   */
+  DedupSummary dedupextents(bool dryrun, std::size_t nthreads = 1);
 
   /**
    * gets the total size, in bytes.
@@ -133,6 +280,14 @@ public:
 
 private:
   std::vector<Fileinfo>& m_list;
+  std::vector<bufferprovider> m_bufferproviders;
+  std::vector<bufferobserver> m_bufferobservers;
+  std::vector<groupobserver> m_groupobservers;
+  // by position in m_list, if dedupextents was run
+  std::vector<std::string> m_notes;
+  // by identity, where the first and last byte are stored, zero if unknown
+  std::unordered_map<std::int64_t, std::pair<std::uint64_t, std::uint64_t>>
+    m_physical;
 };
 
 #endif
@@ -0,0 +1,444 @@
+/*
+   copyright 2026 Paul Dreik
+   Distributed under GPL v 2.0 or later, at your option.
+   See LICENSE for further details.
+*/
+
+#include "config.h"
+
+// std
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <numeric>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+// os
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// project
+#include "Checksum.hh"
+#include "Options.hh"
+#include "Rdutil.hh"
+#include "ReferenceIndex.hh"
+
+/*
+ * The index is mapped into memory and used as is, so it is stored in the
+ * byte order of the machine which made it. It consists of a header, the
+ * entries sorted on size then rank, the digests of each entry in the same
+ * order and finally the file names.
+ */
+namespace {
+// identifies the file format. bump the version if the layout changes.
+constexpr char magic[] = "RDFINDIX";
+constexpr std::uint32_t version = 1;
+// tells if the index was made on a machine with another byte order
+constexpr std::uint32_t byteordermark = 0x01020304;
+constexpr std::size_t max_slots = 8;
+
+struct IndexSlot
+{
+  std::int8_t mode;
+  std::uint8_t checksumtype;
+  std::uint8_t length;
+  std::uint8_t reserved;
+  std::uint32_t offset;
+};
+
+struct IndexHeader
+{
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t byteorder;
+  std::uint64_t entrycount;
+  std::uint64_t stringsize;
+  std::uint64_t first_bytes_size;
+  std::uint64_t last_bytes_size;
+  std::int32_t maxcmdlineindex;
+  std::uint32_t slotcount;
+  std::uint32_t stride;
+  std::uint32_t reserved;
+  IndexSlot slots[max_slots];
+};
+
+struct IndexEntry
+{
+  std::int64_t size;
+  std::uint64_t device;
+  std::uint64_t inode;
+  std::uint64_t rank;
+  std::uint64_t nameoffset;
+  std::int32_t cmdline_index;
+  std::int32_t depth;
+  std::uint32_t namelength;
+  // bit i is set if the digest of slot i is known
+  std::uint32_t known;
+};
+
+static_assert(std::is_trivially_copyable_v<IndexHeader>);
+static_assert(std::is_trivially_copyable_v<IndexEntry>);
+static_assert(sizeof(IndexHeader) % 8 == 0);
+static_assert(sizeof(IndexEntry) % 8 == 0);
+
+template<class T>
+void
+writestruct(std::ostream& out, const T& t)
+{
+  out.write(reinterpret_cast<const char*>(&t), sizeof(T));
+}
+} // namespace
+
+ReferenceIndexWriter::ReferenceIndexWriter(const Options& options)
+  : m_first_bytes_size(options.first_bytes_size)
+  , m_last_bytes_size(options.last_bytes_size)
+{
+  for (const auto& stage : Rdutil::stages(options)) {
+    const auto type = Rdutil::checksumtypefor(stage.first, options);
+    Slot slot{};
+    slot.mode = stage.first;
+    slot.checksumtype = static_cast<std::uint8_t>(type);
+    slot.length =
+      static_cast<std::uint8_t>(Checksum(type).getDigestLength());
+    slot.offset = m_stride;
+    m_stride += slot.length;
+    m_slots.push_back(slot);
+  }
+  // keep the digests of each entry aligned
+  m_stride = (m_stride + 7U) & ~7U;
+}
+
+void
+ReferenceIndexWriter::recordbuffer(const Fileinfo& file,
+                                   Fileinfo::readtobuffermode mode)
+{
+  const auto slot =
+    std::find_if(m_slots.begin(), m_slots.end(), [mode](const Slot& s) {
+      return s.mode == mode;
+    });
+  if (slot == m_slots.end() || file.getidentity() < 1) {
+    return;
+  }
+  const auto index = static_cast<std::size_t>(file.getidentity() - 1);
+  if (m_known.size() <= index) {
+    m_known.resize(index + 1);
+    m_digests.resize((index + 1) * m_stride);
+  }
+  std::memcpy(m_digests.data() + index * m_stride + slot->offset,
+              file.getbyteptr(),
+              slot->length);
+  m_known[index] |= 1U << (slot - m_slots.begin());
+}
+
+int
+ReferenceIndexWriter::write(const std::string& filename,
+                            const std::vector<Fileinfo>& list) const
+{
+  if (m_slots.size() > max_slots) {
+    std::cerr << "too many stages to make an index\n";
+    return -1;
+  }
+
+  // the rank is the position in rank order, as described in RANKING on the
+  // man page.
+  std::vector<std::size_t> order(list.size());
+  std::iota(order.begin(), order.end(), std::size_t{ 0 });
+  std::sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) {
+    return std::make_tuple(list[a].get_cmdline_index(),
+                           list[a].depth(),
+                           list[a].getidentity()) <
+           std::make_tuple(list[b].get_cmdline_index(),
+                           list[b].depth(),
+                           list[b].getidentity());
+  });
+  std::vector<std::uint64_t> rank(list.size());
+  for (std::size_t i = 0; i < order.size(); ++i) {
+    rank[order[i]] = i;
+  }
+  std::sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) {
+    return std::make_tuple(list[a].size(), rank[a]) <
+           std::make_tuple(list[b].size(), rank[b]);
+  });
+
+  IndexHeader header{};
+  std::memcpy(header.magic, magic, sizeof(header.magic));
+  header.version = version;
+  header.byteorder = byteordermark;
+  header.entrycount = list.size();
+  header.first_bytes_size = m_first_bytes_size;
+  header.last_bytes_size = m_last_bytes_size;
+  header.slotcount = static_cast<std::uint32_t>(m_slots.size());
+  header.stride = m_stride;
+  for (std::size_t i = 0; i < m_slots.size(); ++i) {
+    header.slots[i].mode = static_cast<std::int8_t>(m_slots[i].mode);
+    header.slots[i].checksumtype = m_slots[i].checksumtype;
+    header.slots[i].length = m_slots[i].length;
+    header.slots[i].offset = m_slots[i].offset;
+  }
+  for (const auto& file : list) {
+    header.maxcmdlineindex =
+      std::max(header.maxcmdlineindex, file.get_cmdline_index());
+    header.stringsize += file.name().size();
+  }
+
+  // write to a temporary and rename it into place, so an interrupted run
+  // does not leave a damaged index behind.
+  const std::string tempname = filename + ".tmp";
+  {
+    std::ofstream out(tempname, std::ios_base::binary | std::ios_base::trunc);
+    if (!out.is_open()) {
+      std::cerr << "could not open index \"" << tempname << "\" for writing\n";
+      return -1;
+    }
+    writestruct(out, header);
+
+    std::uint64_t nameoffset = 0;
+    for (const auto i : order) {
+      const auto& file = list[i];
+      IndexEntry entry{};
+      entry.size = file.size();
+      entry.device = file.device();
+      entry.inode = file.inode();
+      entry.rank = rank[i];
+      entry.nameoffset = nameoffset;
+      entry.cmdline_index = file.get_cmdline_index();
+      entry.depth = file.depth();
+      entry.namelength = static_cast<std::uint32_t>(file.name().size());
+      const auto index = static_cast<std::size_t>(file.getidentity() - 1);
+      entry.known = index < m_known.size() ? m_known[index] : 0U;
+      writestruct(out, entry);
+      nameoffset += file.name().size();
+    }
+
+    const std::vector<char> missing(m_stride, '\0');
+    for (const auto i : order) {
+      const auto index = static_cast<std::size_t>(list[i].getidentity() - 1);
+      if (index < m_known.size()) {
+        out.write(m_digests.data() + index * m_stride,
+                  static_cast<std::streamsize>(m_stride));
+      } else {
+        out.write(missing.data(), static_cast<std::streamsize>(m_stride));
+      }
+    }
+
+    for (const auto i : order) {
+      out.write(list[i].name().data(),
+                static_cast<std::streamsize>(list[i].name().size()));
+    }
+    out.flush();
+    if (!out) {
+      std::cerr << "failed writing index \"" << tempname << "\"\n";
+      std::remove(tempname.c_str());
+      return -1;
+    }
+  }
+  if (0 != std::rename(tempname.c_str(), filename.c_str())) {
+    std::cerr << "failed moving index into place as \"" << filename << "\"\n";
+    return -1;
+  }
+  return 0;
+}
+
+ReferenceIndex::~ReferenceIndex()
+{
+  if (m_map) {
+    munmap(m_map, m_mapsize);
+  }
+}
+
+int
+ReferenceIndex::open(const std::string& filename, const Options& options)
+{
+  const int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    std::cerr << "could not open index \"" << filename
+              << "\": " << std::strerror(errno) << '\n';
+    return -1;
+  }
+  struct stat info
+  {};
+  if (0 != fstat(fd, &info) || info.st_size < 0 ||
+      static_cast<std::size_t>(info.st_size) < sizeof(IndexHeader)) {
+    std::cerr << "\"" << filename << "\" is not an index\n";
+    close(fd);
+    return -1;
+  }
+  m_mapsize = static_cast<std::size_t>(info.st_size);
+  void* map = mmap(nullptr, m_mapsize, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    std::cerr << "could not map index \"" << filename
+              << "\": " << std::strerror(errno) << '\n';
+    return -1;
+  }
+  m_map = map;
+  // lookups jump around in the index, reading ahead does not help.
+  madvise(m_map, m_mapsize, MADV_RANDOM);
+
+  const auto* base = static_cast<const char*>(m_map);
+  IndexHeader header{};
+  std::memcpy(&header, base, sizeof(header));
+  if (!std::equal(header.magic, header.magic + sizeof(header.magic), magic) ||
+      header.version != version) {
+    std::cerr << "\"" << filename << "\" is not an index\n";
+    return -1;
+  }
+  if (header.byteorder != byteordermark) {
+    std::cerr << "index \"" << filename
+              << "\" was made on a machine with another byte order\n";
+    return -1;
+  }
+  // guard against overflow before checking the size adds up
+  const std::uint64_t maxentries =
+    m_mapsize / (sizeof(IndexEntry) + header.stride);
+  if (header.slotcount > max_slots || header.entrycount > maxentries ||
+      sizeof(IndexHeader) +
+          header.entrycount * (sizeof(IndexEntry) + header.stride) +
+          header.stringsize !=
+        m_mapsize) {
+    std::cerr << "index \"" << filename << "\" is damaged\n";
+    return -1;
+  }
+
+  m_entrycount = header.entrycount;
+  m_stride = header.stride;
+  m_maxcmdlineindex = header.maxcmdlineindex;
+  m_entries = base + sizeof(IndexHeader);
+  m_digests = base + sizeof(IndexHeader) + m_entrycount * sizeof(IndexEntry);
+  m_strings = m_digests + m_entrycount * m_stride;
+
+  // checked so that no name can be read from outside of the strings
+  const auto* entries = static_cast<const IndexEntry*>(m_entries);
+  for (std::uint64_t i = 0; i < m_entrycount; ++i) {
+    const auto& entry = entries[i];
+    if (entry.nameoffset > header.stringsize ||
+        entry.namelength > header.stringsize - entry.nameoffset) {
+      std::cerr << "index \"" << filename << "\" is damaged\n";
+      m_entrycount = 0;
+      return -1;
+    }
+  }
+
+  // the stored buffers can only be used if they were made the same way as
+  // this run would make them.
+  for (const auto& stage : Rdutil::stages(options)) {
+    const auto mode = stage.first;
+    const auto type = Rdutil::checksumtypefor(mode, options);
+    if (mode == Fileinfo::readtobuffermode::READ_FIRST_BYTES &&
+        header.first_bytes_size != options.first_bytes_size) {
+      continue;
+    }
+    if (mode == Fileinfo::readtobuffermode::READ_LAST_BYTES &&
+        header.last_bytes_size != options.last_bytes_size) {
+      continue;
+    }
+    for (std::uint32_t i = 0; i < header.slotcount; ++i) {
+      const auto& slot = header.slots[i];
+      if (slot.mode == static_cast<std::int8_t>(mode) &&
+          slot.checksumtype == static_cast<std::uint8_t>(type) &&
+          std::uint64_t{ slot.offset } + slot.length <= m_stride) {
+        m_slots[mode] = Slot{ slot.offset, slot.length, 1U << i };
+      }
+    }
+  }
+  return 0;
+}
+
+int
+ReferenceIndex::maxcmdlineindex() const
+{
+  return m_maxcmdlineindex;
+}
+
+std::size_t
+ReferenceIndex::addcandidates(std::vector<Fileinfo>& list)
+{
+  std::vector<Fileinfo::filesizetype> sizes;
+  sizes.reserve(list.size());
+  for (const auto& file : list) {
+    sizes.push_back(file.size());
+  }
+  std::sort(sizes.begin(), sizes.end());
+  sizes.erase(std::unique(sizes.begin(), sizes.end()), sizes.end());
+
+  // the entries are sorted on size, find the ones with matching size.
+  const auto* first = static_cast<const IndexEntry*>(m_entries);
+  const auto* last = first + m_entrycount;
+  m_selected.clear();
+  for (const auto size : sizes) {
+    const auto range = std::make_pair(
+      std::lower_bound(first,
+                       last,
+                       size,
+                       [](const IndexEntry& entry,
+                          Fileinfo::filesizetype value) {
+                         return entry.size < value;
+                       }),
+      std::upper_bound(first,
+                       last,
+                       size,
+                       [](Fileinfo::filesizetype value,
+                          const IndexEntry& entry) {
+                         return value < entry.size;
+                       }));
+    for (auto it = range.first; it != range.second; ++it) {
+      m_selected.push_back(static_cast<std::uint64_t>(it - first));
+    }
+  }
+  std::sort(m_selected.begin(),
+            m_selected.end(),
+            [first](std::uint64_t a, std::uint64_t b) {
+              return first[a].rank < first[b].rank;
+            });
+
+  std::vector<Fileinfo> combined;
+  combined.reserve(m_selected.size() + list.size());
+  for (const auto i : m_selected) {
+    const auto& entry = first[i];
+    Fileinfo file(std::string(m_strings + entry.nameoffset, entry.namelength),
+                  entry.cmdline_index,
+                  entry.depth);
+    struct stat info
+    {};
+    info.st_mode = S_IFREG;
+    info.st_size = entry.size;
+    info.st_dev = entry.device;
+    info.st_ino = entry.inode;
+    file.setfileinfo(info);
+    combined.push_back(std::move(file));
+  }
+  std::move(list.begin(), list.end(), std::back_inserter(combined));
+  list = std::move(combined);
+  return m_selected.size();
+}
+
+bool
+ReferenceIndex::restorebuffer(Fileinfo& file,
+                              Fileinfo::readtobuffermode mode) const
+{
+  const auto identity = file.getidentity();
+  if (identity < 1 ||
+      static_cast<std::uint64_t>(identity) > m_selected.size()) {
+    return false;
+  }
+  const auto slot = m_slots.find(mode);
+  if (slot == m_slots.end() || slot->second.length > file.getbuffersize()) {
+    return false;
+  }
+  const auto entry = m_selected[static_cast<std::size_t>(identity - 1)];
+  const auto* entries = static_cast<const IndexEntry*>(m_entries);
+  if (0 == (entries[entry].known & slot->second.bit)) {
+    return false;
+  }
+  file.setbytes(m_digests + entry * m_stride + slot->second.offset,
+                slot->second.length);
+  return true;
+}
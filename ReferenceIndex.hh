@@ -0,0 +1,126 @@
+/*
+   copyright 2026 Paul Dreik
+   Distributed under GPL v 2.0 or later, at your option.
+   See LICENSE for further details.
+*/
+#ifndef RDFIND_REFERENCEINDEX_HH_
+#define RDFIND_REFERENCEINDEX_HH_
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Fileinfo.hh"
+
+struct Options;
+
+/**
+ * Collects the buffers of all files in a reference corpus while the
+ * elimination stages run over them, and writes them out as an index which
+ * can be given to later runs with ReferenceIndex.
+ */
+class ReferenceIndexWriter
+{
+public:
+  explicit ReferenceIndexWriter(const Options& options);
+
+  /// records the buffer of a file, after it was read in the given mode
+  void recordbuffer(const Fileinfo& file, Fileinfo::readtobuffermode mode);
+
+  /**
+   * writes the index of all files in the list, which must have been given
+   * identities with Rdutil::markitems.
+   * @return zero on success
+   */
+  int write(const std::string& filename,
+            const std::vector<Fileinfo>& list) const;
+
+private:
+  struct Slot
+  {
+    Fileinfo::readtobuffermode mode;
+    std::uint8_t checksumtype;
+    std::uint8_t length;
+    std::uint32_t offset;
+  };
+  std::vector<Slot> m_slots;
+  std::uint32_t m_stride = 0;
+  std::uint64_t m_first_bytes_size;
+  std::uint64_t m_last_bytes_size;
+  // the digests per identity, m_stride bytes each
+  std::vector<char> m_digests;
+  // which of the slots are known per identity, one bit per slot
+  std::vector<std::uint32_t> m_known;
+};
+
+/**
+ * A memory mapped index of a reference corpus, made by an earlier run with
+ * ReferenceIndexWriter.
+ *
+ * The files in the index are sorted on size, so the reference files which
+ * can be duplicates of the files in a new run are found without scanning the
+ * reference. Their buffers are taken from the index instead of reading the
+ * files, as long as the index was made with the same checksum and first/last
+ * bytes options. Otherwise, the reference files are read as usual.
+ */
+class ReferenceIndex
+{
+public:
+  ReferenceIndex() = default;
+  ReferenceIndex(const ReferenceIndex&) = delete;
+  ReferenceIndex& operator=(const ReferenceIndex&) = delete;
+  ~ReferenceIndex();
+
+  /**
+   * maps the index into memory.
+   * @return zero on success
+   */
+  int open(const std::string& filename, const Options& options);
+
+  /**
+   * the highest command line index among the reference files. files found
+   * in the new run must get a higher index, so reference files rank first.
+   */
+  int maxcmdlineindex() const;
+
+  /**
+   * puts the reference files with the same size as any of the files in the
+   * list first in the list, in rank order. must be done before
+   * Rdutil::markitems, and only once.
+   * @return the number of reference files added
+   */
+  std::size_t addcandidates(std::vector<Fileinfo>& list);
+
+  /**
+   * gives a reference file the buffer stored in the index.
+   * @return true if the index had it
+   */
+  bool restorebuffer(Fileinfo& file, Fileinfo::readtobuffermode mode) const;
+
+private:
+  struct Slot
+  {
+    std::uint32_t offset;
+    std::uint8_t length;
+    std::uint32_t bit;
+  };
+
+  void* m_map = nullptr;
+  std::size_t m_mapsize = 0;
+  std::uint64_t m_entrycount = 0;
+  std::uint32_t m_stride = 0;
+  int m_maxcmdlineindex = 0;
+  const void* m_entries = nullptr;
+  const char* m_digests = nullptr;
+  const char* m_strings = nullptr;
+  // where the buffer for each mode of this run is stored within the digests
+  // of an entry, as offset and length. only the modes which were indexed
+  // with the same settings as this run are present.
+  std::map<Fileinfo::readtobuffermode, Slot> m_slots;
+  // the entry of each reference file added, by identity - 1
+  std::vector<std::uint64_t> m_selected;
+};
+
+#endif /* RDFIND_REFERENCEINDEX_HH_ */
@@ -0,0 +1,94 @@
+/*
+   copyright 2026 Paul Dreik
+   Distributed under GPL v 2.0 or later, at your option.
+   See LICENSE for further details.
+*/
+
+#include "config.h"
+
+// std
+#include <utility>
+
+// project
+#include "Options.hh"
+#include "Rdutil.hh"
+#include "ResultStream.hh"
+
+ResultStream::ResultStream(const Options& options)
+  : m_options(options)
+  , m_writer(options.outputformat, Rdutil::digestlength(options))
+{
+}
+
+int
+ResultStream::open()
+{
+  if (!m_options.makeresultsfile) {
+    return 0;
+  }
+  if (0 != m_writer.open(m_options.resultsfile)) {
+    return -1;
+  }
+  m_open = true;
+  m_writer.flush();
+  return 0;
+}
+
+void
+ResultStream::setlastreferenceindex(int lastreferenceindex)
+{
+  m_hasreference = true;
+  m_lastreferenceindex = lastreferenceindex;
+}
+
+void
+ResultStream::add(std::vector<Fileinfo> group)
+{
+  // all files of the group have the same size and buffer, so it is sorted
+  // the way Rdutil expects.
+  Rdutil rdutil(group);
+  rdutil.markduplicates(m_options.makehardlinks || m_options.dedupextents);
+  if (group.empty()) {
+    return;
+  }
+  if (m_hasreference) {
+    rdutil.removereferenceduplicates(m_lastreferenceindex);
+    if (group.empty()) {
+      return;
+    }
+  }
+
+  if (m_options.dedupextents) {
+    // before writing, so the results file tells what was not shared
+    const auto summary = rdutil.dedupextents(m_options.dryrun);
+    m_dedup.add(summary);
+    m_acted += summary.shared + summary.partly;
+  }
+
+  if (m_open) {
+    // the group is written at once, so a reader does not see half of it,
+    // unless it is larger than the buffer of the writer.
+    rdutil.writeto(m_writer);
+    m_writer.endgroup();
+    m_writer.flush();
+    m_written += group.size();
+  }
+
+  if (m_options.makesymlinks) {
+    m_acted += rdutil.makesymlinks(m_options.dryrun);
+  } else if (m_options.makehardlinks) {
+    m_acted += rdutil.makehardlinks(m_options.dryrun);
+  } else if (m_options.deleteduplicates) {
+    m_acted += rdutil.deleteduplicates(m_options.dryrun);
+  }
+}
+
+int
+ResultStream::close()
+{
+  if (!m_open) {
+    return 0;
+  }
+  m_open = false;
+  return m_writer.close();
+}
@@ -0,0 +1,73 @@
+/*
+   copyright 2026 Paul Dreik
+   Distributed under GPL v 2.0 or later, at your option.
+   See LICENSE for further details.
+*/
+#ifndef RDFIND_RESULTSTREAM_HH_
+#define RDFIND_RESULTSTREAM_HH_
+
+#include <cstddef>
+#include <vector>
+
+#include "ExtentDedup.hh"
+#include "Fileinfo.hh"
+#include "ResultsWriter.hh"
+
+struct Options;
+
+/**
+ * Writes each set of duplicates to the results file as soon as it is
+ * confirmed, and takes the requested action on it right away, instead of
+ * waiting until all files have been compared.
+ *
+ * Each set is written with the original first, followed by the comment line
+ * "# end of group" in the text format, and flushed. The file can therefore
+ * be followed with tail, or be a fifo read by another program, while rdfind
+ * is still running. The sets come in the order they are confirmed, not
+ * ordered on size. The binary format can not be streamed.
+ */
+class ResultStream
+{
+public:
+  explicit ResultStream(const Options& options);
+
+  /**
+   * opens the results file and writes the header, if a results file is
+   * requested. a fifo blocks until it is opened for reading.
+   * @return zero on success
+   */
+  int open();
+
+  /// files with a command line index up to this are only compared against
+  void setlastreferenceindex(int lastreferenceindex);
+
+  /// marks, writes and acts on a confirmed set of duplicates
+  void add(std::vector<Fileinfo> group);
+
+  /**
+   * writes the end of the results file and closes it
+   * @return zero on success
+   */
+  int close();
+
+  /// the number of files written
+  std::size_t written() const { return m_written; }
+
+  /// the number of files the action was taken on
+  std::size_t acted() const { return m_acted; }
+
+  /// how the sharing of extents went, with -dedupextents
+  const DedupSummary& dedupsummary() const { return m_dedup; }
+
+private:
+  const Options& m_options;
+  ResultsWriter m_writer;
+  bool m_open = false;
+  bool m_hasreference = false;
+  int m_lastreferenceindex = 0;
+  std::size_t m_written = 0;
+  std::size_t m_acted = 0;
+  DedupSummary m_dedup;
+};
+
+#endif /* RDFIND_RESULTSTREAM_HH_ */
@@ -0,0 +1,341 @@
+/*
+   copyright 2026 Paul Dreik
+   Distributed under GPL v 2.0 or later, at your option.
+   See LICENSE for further details.
+*/
+
+#include "config.h"
+
+// std
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+
+// os
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// project
+#include "ResultsFile.hh"
+#include "ResultsWriter.hh"
+
+namespace {
+template<typename Integer>
+Integer
+fromLittleEndian(const unsigned char* bytes)
+{
+  std::make_unsigned_t<Integer> ret{};
+  for (std::size_t i = sizeof(Integer); i > 0; --i) {
+    ret = static_cast<decltype(ret)>(ret << 8);
+    ret = static_cast<decltype(ret)>(ret | bytes[i - 1]);
+  }
+  return static_cast<Integer>(ret);
+}
+
+// the names of Fileinfo::duptype, by value
+constexpr const char* duptypenames[] = { "DUPTYPE_UNKNOWN",
+                                         "DUPTYPE_FIRST_OCCURRENCE",
+                                         "DUPTYPE_WITHIN_SAME_TREE",
+                                         "DUPTYPE_OUTSIDE_TREE" };
+} // namespace
+
+MappedResults::~MappedResults()
+{
+  if (m_data) {
+    ::munmap(const_cast<unsigned char*>(m_data), m_length);
+  }
+}
+
+int
+MappedResults::open(const std::string& filename)
+{
+  const int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    std::cerr << "could not open results file \"" << filename << "\"\n";
+    return -1;
+  }
+  struct stat info
+  {};
+  if (0 != ::fstat(fd, &info) ||
+      info.st_size < static_cast<off_t>(ResultsWriter::BinaryHeaderSize)) {
+    ::close(fd);
+    std::cerr << "results file \"" << filename << "\" is too short\n";
+    return -1;
+  }
+  m_length = static_cast<std::size_t>(info.st_size);
+  void* const map = ::mmap(nullptr, m_length, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (map == MAP_FAILED) {
+    std::cerr << "could not map results file \"" << filename << "\"\n";
+    return -1;
+  }
+  m_data = static_cast<const unsigned char*>(map);
+
+  const auto& magic = ResultsWriter::BinaryMagic;
+  const auto count = fromLittleEndian<std::uint64_t>(m_data + 16);
+  m_recordsoffset = fromLittleEndian<std::uint64_t>(m_data + 24);
+  m_indexoffset = fromLittleEndian<std::uint64_t>(m_data + 32);
+  m_stringsoffset = fromLittleEndian<std::uint64_t>(m_data + 40);
+  m_stringssize = fromLittleEndian<std::uint64_t>(m_data + 48);
+  // checked so that no lookup can read outside of the file
+  const bool good =
+    0 == std::memcmp(m_data, magic.data(), magic.size()) &&
+    fromLittleEndian<std::uint32_t>(m_data + 8) ==
+      ResultsWriter::BinaryVersion &&
+    fromLittleEndian<std::uint32_t>(m_data + 12) ==
+      ResultsWriter::BinaryRecordSize &&
+    m_recordsoffset >= ResultsWriter::BinaryHeaderSize &&
+    m_recordsoffset <= m_indexoffset && m_indexoffset <= m_stringsoffset &&
+    m_stringsoffset <= m_length &&
+    count <= (m_indexoffset - m_recordsoffset) /
+               ResultsWriter::BinaryRecordSize &&
+    count <= (m_stringsoffset - m_indexoffset) / 8 &&
+    m_stringssize <= m_length - m_stringsoffset;
+  if (!good) {
+    std::cerr << "results file \"" << filename
+              << "\" is not in the binary format or is damaged\n";
+    return -1;
+  }
+  m_count = static_cast<std::size_t>(count);
+  for (std::size_t i = 0; i < m_count; ++i) {
+    const auto r = record(i);
+    const auto offset = fromLittleEndian<std::uint64_t>(r + 32);
+    const auto length = fromLittleEndian<std::uint32_t>(r + 40);
+    if (offset > m_stringssize || length > m_stringssize - offset ||
+        fromLittleEndian<std::uint64_t>(m_data + m_indexoffset + 8 * i) >=
+          count ||
+        fromLittleEndian<std::uint32_t>(r + 52) >= std::size(duptypenames)) {
+      std::cerr << "results file \"" << filename << "\" is damaged\n";
+      m_count = 0;
+      return -1;
+    }
+  }
+  return 0;
+}
+
+const unsigned char*
+MappedResults::record(std::size_t index) const
+{
+  return m_data + m_recordsoffset + index * ResultsWriter::BinaryRecordSize;
+}
+
+std::string_view
+MappedResults::nameof(std::size_t index) const
+{
+  const auto r = record(index);
+  return { reinterpret_cast<const char*>(m_data + m_stringsoffset) +
+             fromLittleEndian<std::uint64_t>(r + 32),
+           fromLittleEndian<std::uint32_t>(r + 40) };
+}
+
+ResultEntry
+MappedResults::entry(std::size_t index) const
+{
+  const auto r = record(index);
+  ResultEntry ret;
+  ret.duptype = duptypenames[fromLittleEndian<std::uint32_t>(r + 52)];
+  ret.identity = fromLittleEndian<std::int64_t>(r);
+  ret.depth = fromLittleEndian<std::int32_t>(r + 44);
+  ret.size = fromLittleEndian<Fileinfo::filesizetype>(r + 8);
+  ret.device = fromLittleEndian<std::uint64_t>(r + 16);
+  ret.inode = fromLittleEndian<std::uint64_t>(r + 24);
+  ret.cmdline_index = fromLittleEndian<std::int32_t>(r + 48);
+  ret.name = nameof(index);
+  ret.ctime = fromLittleEndian<std::int64_t>(r + 56);
+  return ret;
+}
+
+std::size_t
+MappedResults::find(std::string_view name) const
+{
+  // binary search in the index, which is ordered on the names
+  std::size_t first = 0;
+  std::size_t count = m_count;
+  while (count > 0) {
+    const auto step = count / 2;
+    const auto i = fromLittleEndian<std::uint64_t>(
+      m_data + m_indexoffset + 8 * (first + step));
+    if (nameof(i) < name) {
+      first += step + 1;
+      count -= step + 1;
+    } else {
+      count = step;
+    }
+  }
+  if (first == m_count) {
+    return m_count;
+  }
+  const std::size_t i =
+    fromLittleEndian<std::uint64_t>(m_data + m_indexoffset + 8 * first);
+  return nameof(i) == name ? i : m_count;
+}
+
+std::pair<std::size_t, std::size_t>
+MappedResults::group(std::size_t index) const
+{
+  // the duplicates have the negated identity of the original, which is
+  // before them.
+  auto identity = [this](std::size_t i) {
+    return fromLittleEndian<std::int64_t>(record(i));
+  };
+  const auto original =
+    identity(index) > 0 ? identity(index) : -identity(index);
+  std::size_t first = index;
+  while (first > 0 && identity(first) != original) {
+    --first;
+  }
+  std::size_t last = index + 1;
+  while (last < m_count && identity(last) == -original) {
+    ++last;
+  }
+  return { first, last };
+}
+
+int
+readresultsfile(const std::string& filename, std::vector<ResultEntry>& entries)
+{
+  std::ifstream in(filename);
+  if (!in) {
+    std::cerr << "could not open results file \"" << filename << "\"\n";
+    return -1;
+  }
+
+  const auto& magic = ResultsWriter::BinaryMagic;
+  std::string start(magic.size(), '\0');
+  if (in.read(start.data(), static_cast<std::streamsize>(start.size())) &&
+      start == magic) {
+    MappedResults mapped;
+    if (0 != mapped.open(filename)) {
+      return -1;
+    }
+    for (std::size_t i = 0; i < mapped.size(); ++i) {
+      entries.push_back(mapped.entry(i));
+    }
+    return 0;
+  }
+  in.clear();
+  in.seekg(0);
+
+  std::string line;
+  std::size_t lineno = 0;
+  while (std::getline(in, line)) {
+    ++lineno;
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+    // the name is the rest of the line, it may contain spaces.
+    std::istringstream iss(line);
+    ResultEntry entry;
+    if (!(iss >> entry.duptype >> entry.identity >> entry.depth >>
+          entry.size >> entry.device >> entry.inode >> entry.cmdline_index) ||
+        iss.get() != ' ' || !std::getline(iss, entry.name) ||
+        entry.name.empty()) {
+      std::cerr << "bad line " << lineno << " in results file \"" << filename
+                << "\"\n";
+      return -1;
+    }
+    entries.push_back(std::move(entry));
+  }
+  return 0;
+}
+
+int
+writeresultsfile(const std::string& filename,
+                 const std::vector<ResultEntry>& entries)
+{
+  std::ofstream out(filename);
+  if (!out.is_open()) {
+    std::cerr << "could not open file \"" << filename << "\"\n";
+    return -1;
+  }
+  out << "# Automatically generated\n";
+  out << "# duptype id depth size device inode priority name\n";
+  for (const auto& entry : entries) {
+    out << entry.duptype << " " << entry.identity << " " << entry.depth << " "
+        << entry.size << " " << entry.device << " " << entry.inode << " "
+        << entry.cmdline_index << " " << entry.name << '\n';
+  }
+  out << "# end of file\n";
+  out.close();
+  if (!out) {
+    std::cerr << "failed writing results file \"" << filename << "\"\n";
+    return -1;
+  }
+  return 0;
+}
+
+int
+mergeresults(const std::vector<std::string>& filenames,
+             const std::string& outputfile)
+{
+  if (filenames.empty()) {
+    std::cerr << "no results files given to merge\n";
+    return -1;
+  }
+
+  std::vector<std::vector<ResultEntry>> shards(filenames.size());
+  for (std::size_t i = 0; i < filenames.size(); ++i) {
+    if (0 != readresultsfile(filenames[i], shards[i])) {
+      return -1;
+    }
+  }
+
+  // a group of duplicates, [first,last) in a shard.
+  struct Group
+  {
+    Fileinfo::filesizetype size;
+    const ResultEntry* first;
+    const ResultEntry* last;
+  };
+  std::vector<Group> groups;
+  // the identities are the same as in a run over all files, so an original
+  // seen twice means a shard was given twice.
+  std::set<std::int64_t> originals;
+  for (std::size_t i = 0; i < shards.size(); ++i) {
+    const auto& entries = shards[i];
+    const auto end = entries.data() + entries.size();
+    for (auto it = entries.data(); it != end;) {
+      if (!it->isoriginal()) {
+        std::cerr << "results file \"" << filenames[i]
+                  << "\" has a duplicate without an original before it\n";
+        return -1;
+      }
+      if (!originals.insert(it->identity).second) {
+        std::cerr << "results file \"" << filenames[i] << "\" has \""
+                  << it->name
+                  << "\" which was already found, was a shard given twice?\n";
+        return -1;
+      }
+      const auto identity = it->identity;
+      const auto last = std::find_if(it + 1, end, [=](const ResultEntry& e) {
+        return e.identity != -identity;
+      });
+      groups.push_back({ it->size, it, last });
+      it = last;
+    }
+  }
+
+  // a run over all files lists the groups ordered on size. files of the same
+  // size are all in the same shard, so their order within it is kept.
+  std::stable_sort(
+    groups.begin(), groups.end(), [](const Group& a, const Group& b) {
+      return a.size < b.size;
+    });
+
+  std::vector<ResultEntry> merged;
+  for (const auto& group : groups) {
+    merged.insert(merged.end(), group.first, group.last);
+  }
+  if (0 != writeresultsfile(outputfile, merged)) {
+    return -1;
+  }
+  std::cout << "Merged " << groups.size() << " groups of " << merged.size()
+            << " files from " << filenames.size() << " results files into "
+            << outputfile << std::endl;
+  return 0;
+}
@@ -0,0 +1,114 @@
+/*
+   copyright 2026 Paul Dreik
+   Distributed under GPL v 2.0 or later, at your option.
+   See LICENSE for further details.
+
+   reading results files back, to combine the results of several runs.
+ */
+#ifndef RDFIND_RESULTSFILE_HH_
+#define RDFIND_RESULTSFILE_HH_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "Fileinfo.hh"
+
+/// one line of a results file, as written by Rdutil::printtostream
+struct ResultEntry
+{
+  std::string duptype;
+  std::int64_t identity{};
+  std::int64_t depth{};
+  Fileinfo::filesizetype size{};
+  std::uint64_t device{};
+  std::uint64_t inode{};
+  int cmdline_index{};
+  std::string name;
+  // the change time in nanoseconds since the epoch, when the results were
+  // written. only the binary format has it, zero if not known.
+  std::int64_t ctime{};
+
+  bool isoriginal() const { return duptype == "DUPTYPE_FIRST_OCCURRENCE"; }
+
+  /// the duptype of an original on another node, see -mergemanifests
+  static constexpr const char* RemoteOriginal = "DUPTYPE_REMOTE_ORIGINAL";
+  bool isremoteoriginal() const { return duptype == RemoteOriginal; }
+};
+
+/**
+ * A results file in the binary format, mapped into memory. Looking up a name
+ * and the set of duplicates it belongs to does not need to read the whole
+ * file. See ResultsWriter for the layout.
+ */
+class MappedResults
+{
+public:
+  MappedResults() = default;
+  MappedResults(const MappedResults&) = delete;
+  MappedResults& operator=(const MappedResults&) = delete;
+  ~MappedResults();
+
+  /**
+   * maps the file and checks the header.
+   * @return zero on success
+   */
+  int open(const std::string& filename);
+
+  /// the number of files in the results
+  std::size_t size() const { return m_count; }
+
+  /// the file at index, in the order of the text format
+  ResultEntry entry(std::size_t index) const;
+
+  /// the index of the file with the given name, or size() if there is none
+  std::size_t find(std::string_view name) const;
+
+  /// the range [first,last) of indices of the set of duplicates the file at
+  /// index belongs to. the original is at first.
+  std::pair<std::size_t, std::size_t> group(std::size_t index) const;
+
+private:
+  std::string_view nameof(std::size_t index) const;
+  const unsigned char* record(std::size_t index) const;
+
+  const unsigned char* m_data = nullptr;
+  std::size_t m_length = 0;
+  std::size_t m_count = 0;
+  std::uint64_t m_recordsoffset = 0;
+  std::uint64_t m_indexoffset = 0;
+  std::uint64_t m_stringsoffset = 0;
+  std::uint64_t m_stringssize = 0;
+};
+
+/**
+ * reads a results file, in the text or binary format. comments are skipped.
+ * @param entries receives the lines, in the order of the file
+ * @return zero on success
+ */
+int
+readresultsfile(const std::string& filename,
+                std::vector<ResultEntry>& entries);
+
+/**
+ * writes entries in the results file format.
+ * @return zero on success
+ */
+int
+writeresultsfile(const std::string& filename,
+                 const std::vector<ResultEntry>& entries);
+
+/**
+ * combines the results files of runs made with -shard into one, as if made by
+ * a single run over all files. all shards of the same run must be given,
+ * each exactly once.
+ * @return zero on success
+ */
+int
+mergeresults(const std::vector<std::string>& filenames,
+             const std::string& outputfile);
+
+#endif /* RDFIND_RESULTSFILE_HH_ */
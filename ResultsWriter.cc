@@ -0,0 +1,315 @@
+/*
+   copyright 2026 Paul Dreik
+   Distributed under GPL v 2.0 or later, at your option.
+   See LICENSE for further details.
+*/
+
+#include "config.h"
+
+// std
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <iostream>
+#include <numeric>
+#include <type_traits>
+
+// os
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// project
+#include "ResultsWriter.hh"
+
+namespace {
+// large enough to make the number of system calls irrelevant
+constexpr std::size_t WriteBufferSize = 1 << 20;
+} // namespace
+
+ResultsWriter::ResultsWriter(resultsformat format, std::size_t digestlength)
+  : m_format(format)
+  , m_digestlength(digestlength)
+{
+}
+
+ResultsWriter::~ResultsWriter()
+{
+  if (m_fd >= 0) {
+    ::close(m_fd);
+  }
+}
+
+int
+ResultsWriter::open(const std::string& filename)
+{
+  m_filename = filename;
+  m_fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                0666);
+  if (m_fd < 0) {
+    std::cerr << "could not open file \"" << filename
+              << "\": " << std::strerror(errno) << '\n';
+    return -1;
+  }
+  m_buffer.resize(WriteBufferSize);
+  if (m_format == resultsformat::TEXT) {
+    // This uses "priority" instead of "cmdlineindex", see
+    // Rdutil::printheader.
+    append("# Automatically generated\n");
+    append("# duptype id depth size device inode priority name\n");
+  }
+  return 0;
+}
+
+void
+ResultsWriter::add(const Fileinfo& file)
+{
+  switch (m_format) {
+    case resultsformat::TEXT:
+    case resultsformat::NUL:
+      append(Fileinfo::getduptypestring(file));
+      append(' ');
+      appendnumber(file.getidentity());
+      append(' ');
+      appendnumber(file.depth());
+      append(' ');
+      appendnumber(file.size());
+      append(' ');
+      appendnumber(file.device());
+      append(' ');
+      appendnumber(file.inode());
+      append(' ');
+      appendnumber(file.get_cmdline_index());
+      append(' ');
+      append(file.name());
+      append(m_format == resultsformat::TEXT ? '\n' : '\0');
+      break;
+    case resultsformat::JSONL: {
+      append("{\"duptype\":\"");
+      append(Fileinfo::getduptypestring(file));
+      append("\",\"id\":");
+      appendnumber(file.getidentity());
+      append(",\"depth\":");
+      appendnumber(file.depth());
+      append(",\"size\":");
+      appendnumber(file.size());
+      append(",\"device\":");
+      appendnumber(file.device());
+      append(",\"inode\":");
+      appendnumber(file.inode());
+      append(",\"priority\":");
+      appendnumber(file.get_cmdline_index());
+      append(",\"name\":");
+      appendjsonstring(file.name());
+      append(",\"digest\":\"");
+      static constexpr char hex[] = "0123456789abcdef";
+      const auto digest = reinterpret_cast<const unsigned char*>(
+        file.getbyteptr());
+      for (std::size_t i = 0; i < m_digestlength; ++i) {
+        append(hex[digest[i] >> 4]);
+        append(hex[digest[i] & 0xF]);
+      }
+      append("\"}\n");
+    } break;
+    case resultsformat::BINARY: {
+      // -apply tells a file changed after this by its change time
+      struct stat info
+      {};
+      std::int64_t ctime = 0;
+      if (0 == lstat(file.name().c_str(), &info)) {
+        ctime = std::int64_t{ info.st_ctim.tv_sec } * 1000000000 +
+                info.st_ctim.tv_nsec;
+      }
+      m_records.push_back({ file.getidentity(),
+                            static_cast<std::uint64_t>(file.size()),
+                            file.device(),
+                            file.inode(),
+                            m_strings.size(),
+                            static_cast<std::uint32_t>(file.name().size()),
+                            file.depth(),
+                            file.get_cmdline_index(),
+                            static_cast<std::uint32_t>(file.getduptype()),
+                            ctime });
+      m_strings += file.name();
+      m_strings += '\0';
+    } break;
+  }
+}
+
+void
+ResultsWriter::endgroup()
+{
+  if (m_format == resultsformat::TEXT) {
+    append("# end of group\n");
+  }
+}
+
+void
+ResultsWriter::comment(std::string_view text)
+{
+  if (m_format == resultsformat::TEXT) {
+    append("# ");
+    append(text);
+    append('\n');
+  }
+}
+
+void
+ResultsWriter::flush()
+{
+  std::size_t written = 0;
+  while (!m_failed && written < m_used) {
+    const auto ret = ::write(m_fd, m_buffer.data() + written, m_used - written);
+    if (ret < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      std::cerr << "failed writing results file \"" << m_filename
+                << "\": " << std::strerror(errno) << '\n';
+      m_failed = true;
+    } else {
+      written += static_cast<std::size_t>(ret);
+    }
+  }
+  m_used = 0;
+}
+
+int
+ResultsWriter::close()
+{
+  if (m_fd < 0) {
+    return -1;
+  }
+  if (m_format == resultsformat::TEXT) {
+    append("# end of file\n");
+  } else if (m_format == resultsformat::BINARY) {
+    writebinary();
+  }
+  flush();
+  if (0 != ::close(m_fd) && !m_failed) {
+    std::cerr << "failed writing results file \"" << m_filename
+              << "\": " << std::strerror(errno) << '\n';
+    m_failed = true;
+  }
+  m_fd = -1;
+  return m_failed ? -1 : 0;
+}
+
+void
+ResultsWriter::append(std::string_view text)
+{
+  while (!text.empty()) {
+    if (m_used == m_buffer.size()) {
+      flush();
+    }
+    const auto n = std::min(text.size(), m_buffer.size() - m_used);
+    std::copy_n(text.data(), n, m_buffer.data() + m_used);
+    m_used += n;
+    text.remove_prefix(n);
+  }
+}
+
+void
+ResultsWriter::append(char c)
+{
+  if (m_used == m_buffer.size()) {
+    flush();
+  }
+  m_buffer[m_used++] = c;
+}
+
+template<typename Integer>
+void
+ResultsWriter::appendnumber(Integer value)
+{
+  // enough for any 64 bit integer, with sign
+  constexpr std::size_t maxdigits = 21;
+  if (m_buffer.size() - m_used < maxdigits) {
+    flush();
+  }
+  const auto first = m_buffer.data() + m_used;
+  const auto result = std::to_chars(first, first + maxdigits, value);
+  m_used += static_cast<std::size_t>(result.ptr - first);
+}
+
+template<typename Integer>
+void
+ResultsWriter::appendlittleendian(Integer value)
+{
+  auto bits = static_cast<std::make_unsigned_t<Integer>>(value);
+  for (std::size_t i = 0; i < sizeof(Integer); ++i) {
+    append(static_cast<char>(bits & 0xFF));
+    bits = static_cast<decltype(bits)>(bits >> 8);
+  }
+}
+
+void
+ResultsWriter::appendjsonstring(std::string_view text)
+{
+  // names are written as the bytes they are, only what JSON does not allow
+  // is escaped.
+  static constexpr char hex[] = "0123456789abcdef";
+  append('"');
+  for (const char c : text) {
+    const auto u = static_cast<unsigned char>(c);
+    if (c == '"' || c == '\\') {
+      append('\\');
+      append(c);
+    } else if (u < 0x20) {
+      append("\\u00");
+      append(hex[u >> 4]);
+      append(hex[u & 0xF]);
+    } else {
+      append(c);
+    }
+  }
+  append('"');
+}
+
+void
+ResultsWriter::writebinary()
+{
+  const std::uint64_t count = m_records.size();
+  const std::uint64_t recordsoffset = BinaryHeaderSize;
+  const std::uint64_t indexoffset = recordsoffset + count * BinaryRecordSize;
+  const std::uint64_t stringsoffset = indexoffset + count * 8;
+
+  append(BinaryMagic);
+  appendlittleendian(BinaryVersion);
+  appendlittleendian(static_cast<std::uint32_t>(BinaryRecordSize));
+  appendlittleendian(count);
+  appendlittleendian(recordsoffset);
+  appendlittleendian(indexoffset);
+  appendlittleendian(stringsoffset);
+  appendlittleendian(std::uint64_t{ m_strings.size() });
+  appendlittleendian(std::uint64_t{ 0 });
+
+  for (const auto& record : m_records) {
+    appendlittleendian(record.identity);
+    appendlittleendian(record.size);
+    appendlittleendian(record.device);
+    appendlittleendian(record.inode);
+    appendlittleendian(record.nameoffset);
+    appendlittleendian(record.namelength);
+    appendlittleendian(record.depth);
+    appendlittleendian(record.priority);
+    appendlittleendian(record.duptype);
+    appendlittleendian(record.ctime);
+  }
+
+  std::vector<std::uint64_t> index(m_records.size());
+  std::iota(index.begin(), index.end(), std::uint64_t{ 0 });
+  const std::string_view strings(m_strings);
+  auto nameof = [&](std::uint64_t i) {
+    return strings.substr(m_records[i].nameoffset, m_records[i].namelength);
+  };
+  std::sort(index.begin(), index.end(), [&](std::uint64_t a, std::uint64_t b) {
+    return nameof(a) < nameof(b);
+  });
+  for (const auto i : index) {
+    appendlittleendian(i);
+  }
+
+  append(strings);
+}
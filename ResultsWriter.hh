@@ -0,0 +1,144 @@
+/*
+   copyright 2026 Paul Dreik
+   Distributed under GPL v 2.0 or later, at your option.
+   See LICENSE for further details.
+*/
+#ifndef RDFIND_RESULTSWRITER_HH_
+#define RDFIND_RESULTSWRITER_HH_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Fileinfo.hh"
+
+/// the formats the results file can be written in
+enum class resultsformat
+{
+  /// one line per file, with comments. the default, see the man page.
+  TEXT,
+  /// the same fields as TEXT, each record ended by NUL instead of newline,
+  /// without comments
+  NUL,
+  /// one JSON object per line, with the digest of the file in hex
+  JSONL,
+  /// fixed size records, a string table and an index on the names
+  BINARY
+};
+
+/**
+ * Writes results files through a large buffer, formatting numbers with
+ * std::to_chars instead of going through iostreams.
+ *
+ * The binary format is made to be mapped into memory and queried without
+ * parsing, see MappedResults. All integers are little endian:
+ *
+ *   header, 64 bytes:
+ *     0  "RDFINDRB"
+ *     8  u32 version, currently 2
+ *     12 u32 size of a record, 64
+ *     16 u64 number of records
+ *     24 u64 offset of the records
+ *     32 u64 offset of the name index
+ *     40 u64 offset of the string table
+ *     48 u64 size of the string table
+ *     56 u64 zero
+ *   records, in the order of the text format, each 64 bytes:
+ *     0  i64 id, negative for duplicates of the original with id -id
+ *     8  u64 size
+ *     16 u64 device
+ *     24 u64 inode
+ *     32 u64 offset of the name in the string table
+ *     40 u32 length of the name
+ *     44 i32 depth
+ *     48 i32 priority
+ *     52 u32 duptype, as Fileinfo::duptype
+ *     56 i64 change time in nanoseconds since the epoch, when the results
+ *            were written. zero if the file could not be looked at.
+ *   name index: u64 record numbers, ordered on the names bytewise
+ *   string table: the names, each followed by a NUL
+ *
+ * A set of duplicates is a run of records which starts with its original.
+ * Errors are remembered, and reported by close.
+ */
+class ResultsWriter
+{
+public:
+  /**
+   * @param digestlength the number of bytes of the buffer of each file which
+   * is written as the digest by the JSONL format.
+   */
+  ResultsWriter(resultsformat format, std::size_t digestlength);
+  ResultsWriter(const ResultsWriter&) = delete;
+  ResultsWriter& operator=(const ResultsWriter&) = delete;
+  ~ResultsWriter();
+
+  /**
+   * opens filename for writing, and writes the header of the text format. a
+   * fifo blocks until it is opened for reading.
+   * @return zero on success
+   */
+  int open(const std::string& filename);
+
+  /// writes a file, after marking of the duplicates
+  void add(const Fileinfo& file);
+
+  /// tells a set of duplicates has been written completely
+  void endgroup();
+
+  /// writes a comment line, only in the text format
+  void comment(std::string_view text);
+
+  /// writes what is buffered to the file
+  void flush();
+
+  /**
+   * writes the end of the file and closes it.
+   * @return zero if all was written
+   */
+  int close();
+
+  static constexpr std::size_t BinaryHeaderSize = 64;
+  static constexpr std::size_t BinaryRecordSize = 64;
+  static constexpr std::uint32_t BinaryVersion = 2;
+  static constexpr std::string_view BinaryMagic{ "RDFINDRB" };
+
+private:
+  void append(std::string_view text);
+  void append(char c);
+  template<typename Integer>
+  void appendnumber(Integer value);
+  template<typename Integer>
+  void appendlittleendian(Integer value);
+  void appendjsonstring(std::string_view text);
+  void writebinary();
+
+  resultsformat m_format;
+  std::size_t m_digestlength;
+  std::string m_filename;
+  int m_fd = -1;
+  bool m_failed = false;
+  std::vector<char> m_buffer;
+  std::size_t m_used = 0;
+
+  // the binary format is written by close, it needs to know all files.
+  struct Record
+  {
+    std::int64_t identity;
+    std::uint64_t size;
+    std::uint64_t device;
+    std::uint64_t inode;
+    std::uint64_t nameoffset;
+    std::uint32_t namelength;
+    std::int32_t depth;
+    std::int32_t priority;
+    std::uint32_t duptype;
+    std::int64_t ctime;
+  };
+  std::vector<Record> m_records;
+  std::string m_strings;
+};
+
+#endif /* RDFIND_RESULTSWRITER_HH_ */
@@ -0,0 +1,162 @@
+/*
+   copyright 2026 Paul Dreik
+   Distributed under GPL v 2.0 or later, at your option.
+   See LICENSE for further details.
+*/
+
+#include "config.h"
+
+// std
+#include <algorithm>
+
+// os
+#include <sys/stat.h>
+
+// project
+#include "Checksum.hh"
+#include "Options.hh"
+#include "Rdutil.hh"
+#include "StreamScanner.hh"
+
+StreamScanner::StreamScanner(const Options& options)
+  : m_options(options)
+{
+  for (const auto& stage : Rdutil::stages(options)) {
+    if (stage.first == Fileinfo::readtobuffermode::READ_FIRST_BYTES ||
+        stage.first == Fileinfo::readtobuffermode::READ_LAST_BYTES) {
+      m_modes.push_back(stage.first);
+    }
+  }
+  if (!m_modes.empty()) {
+    m_worker = std::thread([this]() { work(); });
+  }
+}
+
+StreamScanner::~StreamScanner()
+{
+  finish();
+}
+
+void
+StreamScanner::add(const Fileinfo& file)
+{
+  if (m_modes.empty()) {
+    return;
+  }
+  const auto size = file.size();
+  if (m_options.shardcount != 0 &&
+      Rdutil::shardof(size, m_options.shardcount) != m_options.shardindex) {
+    return;
+  }
+  Job job{ file.name(), size, file.device(), file.inode() };
+  if (m_started.count(size) != 0) {
+    enqueue(std::move(job));
+    return;
+  }
+  const auto waiting = m_waiting.find(size);
+  if (waiting == m_waiting.end()) {
+    // the only one of its size so far, it may stay unique
+    m_waiting.emplace(size, std::move(job));
+    return;
+  }
+  enqueue(std::move(waiting->second));
+  enqueue(std::move(job));
+  m_waiting.erase(waiting);
+  m_started.insert(size);
+}
+
+void
+StreamScanner::enqueue(Job job)
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_queue.push_back(std::move(job));
+  }
+  m_cv.notify_one();
+}
+
+void
+StreamScanner::finish()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_done = true;
+  }
+  m_cv.notify_one();
+  if (m_worker.joinable()) {
+    m_worker.join();
+  }
+  m_waiting.clear();
+  m_started.clear();
+}
+
+void
+StreamScanner::work()
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  for (;;) {
+    m_cv.wait(lock, [this]() { return m_done || !m_queue.empty(); });
+    if (m_queue.empty()) {
+      // done, and nothing left to probe
+      return;
+    }
+    const Job job = std::move(m_queue.front());
+    m_queue.pop_front();
+    lock.unlock();
+    probe(job);
+    lock.lock();
+  }
+}
+
+void
+StreamScanner::probe(const Job& job)
+{
+  struct stat info
+  {};
+  info.st_mode = S_IFREG;
+  info.st_size = job.size;
+  info.st_dev = static_cast<dev_t>(job.device);
+  info.st_ino = static_cast<ino_t>(job.inode);
+  Fileinfo file(job.name, 0, 0);
+  file.setfileinfo(info);
+
+  // read the way Rdutil::fillwithbytes does in each stage, so the buffers
+  // are the same.
+  Probed probed{ job.size, job.device, job.inode, {} };
+  std::vector<char> buffer(m_options.buffersize, '\0');
+  auto lastmode = Fileinfo::readtobuffermode::NOT_DEFINED;
+  for (std::size_t i = 0; i < m_modes.size(); ++i) {
+    Checksum chk(Rdutil::checksumtypefor(m_modes[i], m_options));
+    if (0 != file.fillwithbytes(m_modes[i], lastmode, buffer, chk, m_options)) {
+      // leave it to the stage to report the problem
+      return;
+    }
+    probed.buffers[i].assign(file.getbyteptr(), file.getbuffersize());
+    lastmode = m_modes[i];
+  }
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_buffers.emplace(job.name, std::move(probed));
+}
+
+bool
+StreamScanner::restorebuffer(Fileinfo& file,
+                             Fileinfo::readtobuffermode mode) const
+{
+  const auto index = std::find(m_modes.begin(), m_modes.end(), mode);
+  if (index == m_modes.end()) {
+    return false;
+  }
+  // files not found by this traversal, such as those of a reference index,
+  // may have the same name
+  const auto it = m_buffers.find(file.name());
+  if (it == m_buffers.end() || it->second.size != file.size() ||
+      it->second.device != file.device() ||
+      it->second.inode != file.inode()) {
+    return false;
+  }
+  const auto& bytes =
+    it->second.buffers[static_cast<std::size_t>(index - m_modes.begin())];
+  file.setbytes(bytes.data(), bytes.size());
+  return true;
+}
@@ -0,0 +1,101 @@
+/*
+   copyright 2026 Paul Dreik
+   Distributed under GPL v 2.0 or later, at your option.
+   See LICENSE for further details.
+*/
+#ifndef RDFIND_STREAMSCANNER_HH_
+#define RDFIND_STREAMSCANNER_HH_
+
+#include <array>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "Fileinfo.hh"
+
+struct Options;
+
+/**
+ * Reads the first and last bytes of files while the directories are still
+ * being traversed. As soon as a second file of some size is found, the files
+ * of that size are probed by a worker thread, so the disks and the checksum
+ * do useful work during the traversal.
+ *
+ * The buffers are handed to Rdutil::fillwithbytes by restorebuffer. Only the
+ * reading is moved, the elimination stages and the ranking are the same as
+ * without it.
+ */
+class StreamScanner
+{
+public:
+  /// starts the worker thread
+  explicit StreamScanner(const Options& options);
+  StreamScanner(const StreamScanner&) = delete;
+  StreamScanner& operator=(const StreamScanner&) = delete;
+  ~StreamScanner();
+
+  /// tells about a file found by the traversal
+  void add(const Fileinfo& file);
+
+  /// probes the files queued so far, and stops the worker thread
+  void finish();
+
+  /// the number of files probed by the worker
+  std::size_t probed() const { return m_buffers.size(); }
+
+  /**
+   * gives file the buffer it would get by reading it in the given mode, if
+   * it was probed. must not be called before finish.
+   * @return true if the buffer was set
+   */
+  bool restorebuffer(Fileinfo& file, Fileinfo::readtobuffermode mode) const;
+
+private:
+  struct Job
+  {
+    std::string name;
+    Fileinfo::filesizetype size;
+    std::uint64_t device;
+    std::uint64_t inode;
+  };
+
+  void enqueue(Job job);
+  void work();
+  void probe(const Job& job);
+
+  const Options& m_options;
+  // the modes probed, in the order of the elimination stages
+  std::vector<Fileinfo::readtobuffermode> m_modes;
+
+  // the first file of each size, until a second one is found. only used by
+  // the traversal, not by the worker.
+  std::unordered_map<Fileinfo::filesizetype, Job> m_waiting;
+  // the sizes with files queued
+  std::unordered_set<Fileinfo::filesizetype> m_started;
+
+  std::mutex m_mutex;
+  std::condition_variable m_cv;
+  std::deque<Job> m_queue;
+  bool m_done = false;
+  // a probed file, with the buffers after each probed mode
+  struct Probed
+  {
+    Fileinfo::filesizetype size;
+    std::uint64_t device;
+    std::uint64_t inode;
+    std::array<std::string, 2> buffers;
+  };
+  // the probed files, by name. written by the worker while holding the mutex.
+  std::unordered_map<std::string, Probed> m_buffers;
+
+  std::thread m_worker;
+};
+
+#endif /* RDFIND_STREAMSCANNER_HH_ */
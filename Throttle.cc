@@ -0,0 +1,100 @@
+/*
+   copyright 2026 Paul Dreik
+   Distributed under GPL v 2.0 or later, at your option.
+   See LICENSE for further details.
+*/
+
+#include "config.h"
+
+// std
+#include <algorithm>
+#include <cerrno>
+#include <thread>
+
+// os
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// project
+#include "Options.hh"
+#include "Throttle.hh"
+
+TokenBucket::TokenBucket(std::uint64_t rate)
+  : m_rate(rate)
+  , m_full(clock::now())
+{
+}
+
+void
+TokenBucket::take(std::uint64_t count)
+{
+  const std::chrono::nanoseconds cost(
+    static_cast<std::chrono::nanoseconds::rep>(count * 1000000000 / m_rate));
+  clock::time_point wakeup;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    // a bucket which has been full for a while is not fuller than full
+    m_full = std::max(m_full, clock::now()) + cost;
+    wakeup = m_full - std::chrono::seconds(1);
+  }
+  std::this_thread::sleep_until(wakeup);
+}
+
+void
+throttleopen(const Options& options)
+{
+  if (options.maxopenrate == 0) {
+    return;
+  }
+  static TokenBucket bucket(options.maxopenrate);
+  bucket.take(1);
+}
+
+void
+throttleread(const Options& options, std::uint64_t length)
+{
+  if (options.maxreadrate == 0) {
+    return;
+  }
+  static TokenBucket bucket(options.maxreadrate);
+  bucket.take(length);
+}
+
+#ifdef SYS_ioprio_set
+namespace {
+// from linux/ioprio.h, which older systems do not have
+constexpr int IoprioWhoProcess = 1;
+constexpr int IoprioClassShift = 13;
+constexpr int IoprioClassBestEffort = 2;
+constexpr int IoprioClassIdle = 3;
+// the lowest of the eight levels of best effort
+constexpr int IoprioLowestLevel = 7;
+} // namespace
+
+int
+setioclass(ioschedclass cls)
+{
+  int value = 0;
+  switch (cls) {
+    case ioschedclass::DEFAULT:
+      return 0;
+    case ioschedclass::BESTEFFORT:
+      value = IoprioClassBestEffort << IoprioClassShift | IoprioLowestLevel;
+      break;
+    case ioschedclass::IDLE:
+      value = IoprioClassIdle << IoprioClassShift;
+      break;
+  }
+  return syscall(SYS_ioprio_set, IoprioWhoProcess, 0, value) == 0 ? 0 : -1;
+}
+#else
+int
+setioclass(ioschedclass cls)
+{
+  if (cls == ioschedclass::DEFAULT) {
+    return 0;
+  }
+  errno = ENOSYS;
+  return -1;
+}
+#endif
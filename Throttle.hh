@@ -0,0 +1,58 @@
+/*
+   copyright 2026 Paul Dreik
+   Distributed under GPL v 2.0 or later, at your option.
+   See LICENSE for further details.
+*/
+#ifndef RDFIND_THROTTLE_HH_
+#define RDFIND_THROTTLE_HH_
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+#include "Options.hh"
+
+/**
+ * A token bucket, which lets through a number of tokens per second on
+ * average and at most one second worth of them at once. It is safe to share
+ * between threads, which take turns: a thread taking more than there is
+ * waits until the tokens it took would have been added.
+ */
+class TokenBucket
+{
+public:
+  /// @param rate tokens per second, more than zero
+  explicit TokenBucket(std::uint64_t rate);
+
+  /// waits until count tokens are available, and takes them
+  void take(std::uint64_t count);
+
+private:
+  using clock = std::chrono::steady_clock;
+
+  const std::uint64_t m_rate;
+  std::mutex m_mutex;
+  // when the bucket will be full again, given what has been taken
+  clock::time_point m_full;
+};
+
+/**
+ * waits until the file may be opened, with -maxopenrate. all readers share
+ * one bucket, made with the options given first.
+ */
+void
+throttleopen(const Options& options);
+
+/// waits until length bytes may be read, with -maxreadrate
+void
+throttleread(const Options& options, std::uint64_t length);
+
+/**
+ * sets the I/O scheduling class of the process with ioprio_set. threads
+ * started afterwards inherit it.
+ * @return zero on success
+ */
+int
+setioclass(ioschedclass cls);
+
+#endif /* RDFIND_THROTTLE_HH_ */
@@ -0,0 +1,667 @@
+/*
+   copyright 2026 Paul Dreik
+   Distributed under GPL v 2.0 or later, at your option.
+   See LICENSE for further details.
+*/
+
+#include "config.h"
+
+// std
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+// os
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#ifdef HAVE_SYS_INOTIFY_H
+#include <sys/inotify.h>
+#endif
+
+// project
+#include "Dirlist.hh"
+#include "Options.hh"
+#include "PathFilter.hh"
+#include "Rdutil.hh"
+#include "WatchDaemon.hh"
+
+WatchDaemon* WatchDaemon::s_scanning = nullptr;
+int WatchDaemon::s_cmdline_index = 0;
+
+namespace {
+volatile std::sig_atomic_t stoprequested = 0;
+
+extern "C" void
+onstopsignal(int)
+{
+  stoprequested = 1;
+}
+
+// the longest question accepted
+constexpr std::size_t max_request_length = 1 << 16;
+
+#ifdef MSG_NOSIGNAL
+// a client going away while answered must not kill the daemon
+constexpr int sendflags = MSG_NOSIGNAL;
+#else
+constexpr int sendflags = 0;
+#endif
+
+bool
+fillsockaddr(struct sockaddr_un& addr, const std::string& socketpath)
+{
+  addr = {};
+  addr.sun_family = AF_UNIX;
+  if (socketpath.size() >= sizeof(addr.sun_path)) {
+    std::cerr << "socket path \"" << socketpath << "\" is too long\n";
+    return false;
+  }
+  std::memcpy(addr.sun_path, socketpath.c_str(), socketpath.size() + 1);
+  return true;
+}
+
+bool
+writeall(int fd, const std::string& data)
+{
+  std::size_t written = 0;
+  while (written < data.size()) {
+    const auto ret =
+      send(fd, data.data() + written, data.size() - written, sendflags);
+    if (ret < 0 && errno == EINTR) {
+      continue;
+    }
+    if (ret < 0) {
+      return false;
+    }
+    written += static_cast<std::size_t>(ret);
+  }
+  return true;
+}
+
+bool
+sametime(const struct timespec& a, const struct timespec& b)
+{
+  return a.tv_sec == b.tv_sec && a.tv_nsec == b.tv_nsec;
+}
+} // namespace
+
+WatchDaemon::WatchDaemon(const Options& options)
+  : m_options(options)
+{
+#ifdef HAVE_SYS_INOTIFY_H
+  m_inotifyfd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (m_inotifyfd < 0) {
+    std::cerr << "could not start watching for changes: "
+              << std::strerror(errno) << '\n';
+  }
+#endif
+}
+
+WatchDaemon::~WatchDaemon()
+{
+  if (m_inotifyfd >= 0) {
+    close(m_inotifyfd);
+  }
+}
+
+int
+WatchDaemon::addroot(const std::string& path, int cmdline_index)
+{
+  m_roots[cmdline_index] = path;
+  scan(path, cmdline_index, 0);
+  return 0;
+}
+
+void
+WatchDaemon::scan(const std::string& path, int cmdline_index, int depth)
+{
+  Dirlist dirlist(m_options.followsymlinks);
+  dirlist.setcallbackfcn(&reportfile);
+  dirlist.setdircallbackfcn(&reportdir);
+  dirlist.setfilter(m_filter);
+  s_scanning = this;
+  s_cmdline_index = cmdline_index;
+  dirlist.walk(path, depth);
+  s_scanning = nullptr;
+}
+
+int
+WatchDaemon::reportfile(const std::string& path,
+                        const std::string& name,
+                        int depth,
+                        const struct stat* info)
+{
+  const std::string expandedname = path.empty() ? name : (path + "/" + name);
+  struct stat followed;
+  if (!info) {
+    // a symlink, which is followed
+    if (0 != stat(expandedname.c_str(), &followed)) {
+      return -1;
+    }
+    info = &followed;
+  }
+  s_scanning->updatefile(expandedname, *info, s_cmdline_index, depth);
+  return 0;
+}
+
+void
+WatchDaemon::reportdir(const std::string& path, int depth)
+{
+  s_scanning->addwatch(path, s_cmdline_index, depth);
+}
+
+void
+WatchDaemon::updatefile(const std::string& name,
+                        const struct stat& info,
+                        int cmdline_index,
+                        int depth)
+{
+  if (!S_ISREG(info.st_mode) || info.st_size < m_options.minimumfilesize ||
+      info.st_size >= m_options.maximumfilesize) {
+    removefile(name);
+    return;
+  }
+
+  auto it = m_files.find(name);
+  if (it == m_files.end()) {
+    File file{ info.st_size, info.st_dev, info.st_ino, info.st_mtim,
+               cmdline_index, depth,       {} };
+    it = m_files.emplace(name, std::move(file)).first;
+    m_bysize[info.st_size].insert(it->first);
+    return;
+  }
+
+  File& file = it->second;
+  const bool unchanged = file.size == info.st_size &&
+                         file.device == info.st_dev &&
+                         file.inode == info.st_ino &&
+                         sametime(file.mtime, info.st_mtim);
+  if (unchanged) {
+    return;
+  }
+  file.buffers.clear();
+  if (file.size != info.st_size) {
+    auto& samesize = m_bysize[file.size];
+    samesize.erase(it->first);
+    if (samesize.empty()) {
+      m_bysize.erase(file.size);
+    }
+    m_bysize[info.st_size].insert(it->first);
+  }
+  file.size = info.st_size;
+  file.device = info.st_dev;
+  file.inode = info.st_ino;
+  file.mtime = info.st_mtim;
+}
+
+void
+WatchDaemon::removefile(const std::string& name)
+{
+  const auto it = m_files.find(name);
+  if (it == m_files.end()) {
+    return;
+  }
+  const auto size = it->second.size;
+  auto& samesize = m_bysize[size];
+  samesize.erase(it->first);
+  if (samesize.empty()) {
+    m_bysize.erase(size);
+  }
+  m_files.erase(it);
+}
+
+void
+WatchDaemon::removetree(const std::string& path)
+{
+  removefile(path);
+  const std::string prefix = path + "/";
+  auto it = m_files.lower_bound(prefix);
+  while (it != m_files.end() &&
+         it->first.compare(0, prefix.size(), prefix) == 0) {
+    const auto size = it->second.size;
+    auto& samesize = m_bysize[size];
+    samesize.erase(it->first);
+    if (samesize.empty()) {
+      m_bysize.erase(size);
+    }
+    it = m_files.erase(it);
+  }
+
+  for (auto w = m_watches.begin(); w != m_watches.end();) {
+    const auto& watched = w->second.path;
+    if (watched == path || watched.compare(0, prefix.size(), prefix) == 0) {
+#ifdef HAVE_SYS_INOTIFY_H
+      // fails if the directory is already gone, which is fine.
+      inotify_rm_watch(m_inotifyfd, w->first);
+#endif
+      w = m_watches.erase(w);
+    } else {
+      ++w;
+    }
+  }
+}
+
+void
+WatchDaemon::addwatch(const std::string& path, int cmdline_index, int depth)
+{
+#ifdef HAVE_SYS_INOTIFY_H
+  if (m_inotifyfd < 0) {
+    return;
+  }
+  constexpr std::uint32_t mask = IN_CREATE | IN_DELETE | IN_MODIFY |
+                                 IN_CLOSE_WRITE | IN_ATTRIB | IN_MOVED_FROM |
+                                 IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF |
+                                 IN_DONT_FOLLOW | IN_ONLYDIR;
+  const int wd = inotify_add_watch(m_inotifyfd, path.c_str(), mask);
+  if (wd < 0) {
+    if (!m_warnedaboutwatches) {
+      std::cerr << "could not watch \"" << path
+                << "\" for changes: " << std::strerror(errno) << '\n';
+      if (errno == ENOSPC) {
+        std::cerr << "consider raising fs.inotify.max_user_watches\n";
+      }
+      m_warnedaboutwatches = true;
+    }
+    return;
+  }
+  // a directory moved within the watched tree keeps its watch descriptor
+  m_watches[wd] = Watch{ path, cmdline_index, depth };
+#else
+  (void)path;
+  (void)cmdline_index;
+  (void)depth;
+#endif
+}
+
+void
+WatchDaemon::rescan()
+{
+  std::cerr << "too many changes to follow, scanning again\n";
+#ifdef HAVE_SYS_INOTIFY_H
+  for (const auto& w : m_watches) {
+    inotify_rm_watch(m_inotifyfd, w.first);
+  }
+#endif
+  m_watches.clear();
+  m_bysize.clear();
+  auto before = std::move(m_files);
+  m_files.clear();
+  for (const auto& [cmdline_index, path] : m_roots) {
+    scan(path, cmdline_index, 0);
+  }
+
+  // keep what was read from files which did not change
+  for (auto& [name, file] : m_files) {
+    const auto old = before.find(name);
+    if (old != before.end() && old->second.size == file.size &&
+        old->second.device == file.device && old->second.inode == file.inode &&
+        sametime(old->second.mtime, file.mtime)) {
+      file.buffers = std::move(old->second.buffers);
+    }
+  }
+}
+
+void
+WatchDaemon::handleevents()
+{
+#ifdef HAVE_SYS_INOTIFY_H
+  if (m_inotifyfd < 0) {
+    return;
+  }
+  bool overflow = false;
+  alignas(struct inotify_event) char buffer[1 << 16];
+  for (;;) {
+    const auto length = read(m_inotifyfd, buffer, sizeof(buffer));
+    if (length < 0 && errno == EINTR) {
+      continue;
+    }
+    if (length <= 0) {
+      // nothing more to read for now
+      break;
+    }
+    const auto end = static_cast<std::size_t>(length);
+    std::size_t offset = 0;
+    while (offset + sizeof(struct inotify_event) <= end) {
+      struct inotify_event event;
+      std::memcpy(&event, buffer + offset, sizeof(event));
+      const char* namestart = buffer + offset + sizeof(event);
+      const std::string name(namestart, strnlen(namestart, event.len));
+      offset += sizeof(event) + event.len;
+
+      if (event.mask & IN_Q_OVERFLOW) {
+        overflow = true;
+        continue;
+      }
+      const auto w = m_watches.find(event.wd);
+      if (w == m_watches.end()) {
+        continue;
+      }
+      // copied, since the watches may change below
+      const Watch watch = w->second;
+      if (event.mask & IN_IGNORED) {
+        m_watches.erase(w);
+        continue;
+      }
+      if (event.mask & (IN_DELETE_SELF | IN_MOVE_SELF)) {
+        // other directories are taken care of by the directory above them
+        const bool isroot =
+          std::any_of(m_roots.begin(), m_roots.end(), [&](const auto& root) {
+            return root.second == watch.path;
+          });
+        if (isroot) {
+          removetree(watch.path);
+        }
+        continue;
+      }
+      if (name.empty()) {
+        continue;
+      }
+
+      const std::string fullname = watch.path + "/" + name;
+      if (event.mask & (IN_DELETE | IN_MOVED_FROM)) {
+        if (event.mask & IN_ISDIR) {
+          removetree(fullname);
+        } else {
+          removefile(fullname);
+        }
+        continue;
+      }
+      if (m_filter && m_filter->excluded(watch.path, name.c_str())) {
+        continue;
+      }
+      if (event.mask & IN_ISDIR) {
+        if (event.mask & (IN_CREATE | IN_MOVED_TO)) {
+          // files may have been put there before it was watched
+          scan(fullname, watch.cmdline_index, watch.depth + 1);
+        }
+        continue;
+      }
+
+      struct stat info;
+      if (0 != lstat(fullname.c_str(), &info)) {
+        removefile(fullname);
+        continue;
+      }
+      if (S_ISLNK(info.st_mode)) {
+        if (m_options.followsymlinks &&
+            (event.mask & (IN_CREATE | IN_MOVED_TO))) {
+          scan(fullname, watch.cmdline_index, watch.depth + 1);
+        }
+        continue;
+      }
+      if (m_filter && !m_filter->included(watch.path, name.c_str())) {
+        continue;
+      }
+      if (event.mask & (IN_MODIFY | IN_CLOSE_WRITE)) {
+        // written to, even if the size and time are the same as before
+        const auto it = m_files.find(fullname);
+        if (it != m_files.end()) {
+          it->second.buffers.clear();
+        }
+      }
+      updatefile(fullname, info, watch.cmdline_index, watch.depth);
+    }
+  }
+  if (overflow) {
+    rescan();
+  }
+#endif
+}
+
+std::vector<Fileinfo>
+WatchDaemon::findduplicates(const Fileinfo::filesizetype* onlysize)
+{
+  std::vector<Fileinfo> list;
+  for (const auto& [size, names] : m_bysize) {
+    if ((onlysize && size != *onlysize) || names.size() < 2) {
+      continue;
+    }
+    for (const auto name : names) {
+      const File& known = m_files.find(name)->second;
+      Fileinfo file(std::string(name), known.cmdline_index, known.depth);
+      struct stat info
+      {};
+      info.st_mode = S_IFREG;
+      info.st_size = known.size;
+      info.st_dev = known.device;
+      info.st_ino = known.inode;
+      file.setfileinfo(info);
+      list.push_back(std::move(file));
+    }
+  }
+
+  // the usual elimination, except that files which did not change since
+  // they were last read are not read again.
+  Rdutil gswd(list);
+  gswd.addbufferprovider(
+    [this](Fileinfo& file, Fileinfo::readtobuffermode mode) {
+      const auto it = m_files.find(file.name());
+      if (it == m_files.end()) {
+        return false;
+      }
+      const auto buffer = it->second.buffers.find(mode);
+      if (buffer == it->second.buffers.end()) {
+        return false;
+      }
+      file.setbytes(buffer->second.data(), buffer->second.size());
+      return true;
+    });
+  gswd.addbufferobserver(
+    [this](const Fileinfo& file, Fileinfo::readtobuffermode mode) {
+      const auto it = m_files.find(file.name());
+      if (it != m_files.end()) {
+        it->second.buffers[mode].assign(file.getbyteptr(),
+                                        file.getbuffersize());
+      }
+    });
+
+  gswd.markitems();
+  if (m_options.remove_identical_inode) {
+    gswd.removeIdenticalInodes();
+  }
+  gswd.removeUniqueSizes();
+  auto lastmode = Fileinfo::readtobuffermode::NOT_DEFINED;
+  for (const auto& stage : Rdutil::stages(m_options)) {
+    gswd.fillwithbytes(stage.first, lastmode, m_options, {});
+    gswd.removeUniqSizeAndBuffer();
+    lastmode = stage.first;
+  }
+  gswd.markduplicates();
+  return list;
+}
+
+std::string
+WatchDaemon::answer(const std::string& request)
+{
+  // changes made before the question was asked must be part of the answer
+  handleevents();
+
+  if (request == "DUPLICATES") {
+    auto list = findduplicates(nullptr);
+    std::ostringstream out;
+    Rdutil(list).printtostream(out);
+    return out.str();
+  }
+
+  const std::string isdup = "ISDUP ";
+  if (request.compare(0, isdup.size(), isdup) == 0) {
+    const std::string name = request.substr(isdup.size());
+    const auto known = m_files.find(name);
+    if (known == m_files.end()) {
+      return "UNKNOWN\n";
+    }
+    const auto size = known->second.size;
+    const auto list = findduplicates(&size);
+    const auto file =
+      std::find_if(list.begin(), list.end(), [&](const Fileinfo& f) {
+        return f.name() == name;
+      });
+    if (file == list.end()) {
+      return "UNIQUE\n";
+    }
+    if (file->getduptype() == Fileinfo::duptype::DUPTYPE_FIRST_OCCURRENCE) {
+      const auto count =
+        std::count_if(list.begin(), list.end(), [&](const Fileinfo& f) {
+          return f.getidentity() == -file->getidentity();
+        });
+      return "ORIGINAL " + std::to_string(count) + "\n";
+    }
+    const auto original =
+      std::find_if(list.begin(), list.end(), [&](const Fileinfo& f) {
+        return f.getidentity() == -file->getidentity();
+      });
+    return "DUPLICATE " + original->name() + "\n";
+  }
+  return "ERROR unknown request\n";
+}
+
+int
+WatchDaemon::run(const std::string& socketpath)
+{
+#ifdef HAVE_SYS_INOTIFY_H
+  if (m_inotifyfd < 0) {
+    return EXIT_FAILURE;
+  }
+  struct sockaddr_un addr;
+  if (!fillsockaddr(addr, socketpath)) {
+    return EXIT_FAILURE;
+  }
+  // a socket left behind by an earlier daemon is replaced, nothing else is
+  struct stat info;
+  if (0 == lstat(socketpath.c_str(), &info) && S_ISSOCK(info.st_mode)) {
+    unlink(socketpath.c_str());
+  }
+  const int listenfd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (listenfd < 0 ||
+      0 != bind(listenfd,
+                reinterpret_cast<const struct sockaddr*>(&addr),
+                sizeof(addr)) ||
+      0 != listen(listenfd, 16)) {
+    std::cerr << "could not listen on \"" << socketpath
+              << "\": " << std::strerror(errno) << '\n';
+    if (listenfd >= 0) {
+      close(listenfd);
+    }
+    return EXIT_FAILURE;
+  }
+
+  struct sigaction action
+  {};
+  action.sa_handler = onstopsignal;
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGINT, &action, nullptr);
+  sigaction(SIGTERM, &action, nullptr);
+
+  std::cout << "Now watching " << m_watches.size() << " directories with "
+            << m_files.size() << " files, listening on " << socketpath
+            << std::endl;
+
+  while (!stoprequested) {
+    struct pollfd fds[2] = { { m_inotifyfd, POLLIN, 0 },
+                             { listenfd, POLLIN, 0 } };
+    if (poll(fds, 2, -1) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      std::cerr << "poll failed: " << std::strerror(errno) << '\n';
+      break;
+    }
+    if (fds[0].revents & POLLIN) {
+      handleevents();
+    }
+    if (!(fds[1].revents & POLLIN)) {
+      continue;
+    }
+    const int client = accept4(listenfd, nullptr, nullptr, SOCK_CLOEXEC);
+    if (client < 0) {
+      continue;
+    }
+    // a client which does not ask anything must not block the daemon
+    struct timeval timeout
+    {};
+    timeout.tv_sec = 5;
+    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    std::string request;
+    char chunk[4096];
+    while (request.find('\n') == std::string::npos &&
+           request.size() < max_request_length) {
+      const auto ret = recv(client, chunk, sizeof(chunk), 0);
+      if (ret < 0 && errno == EINTR) {
+        continue;
+      }
+      if (ret <= 0) {
+        break;
+      }
+      request.append(chunk, static_cast<std::size_t>(ret));
+    }
+    request.erase(std::min(request.find('\n'), request.size()));
+    if (!request.empty() && request.back() == '\r') {
+      request.pop_back();
+    }
+    writeall(client, answer(request));
+    close(client);
+  }
+
+  close(listenfd);
+  unlink(socketpath.c_str());
+  std::cout << "Stopped watching." << std::endl;
+  return 0;
+#else
+  (void)socketpath;
+  std::cerr << "-watch is not supported on this platform, it needs inotify\n";
+  return EXIT_FAILURE;
+#endif
+}
+
+int
+WatchDaemon::query(const std::string& socketpath, const std::string& request)
+{
+  struct sockaddr_un addr;
+  if (!fillsockaddr(addr, socketpath)) {
+    return EXIT_FAILURE;
+  }
+  const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0 || 0 != connect(fd,
+                             reinterpret_cast<const struct sockaddr*>(&addr),
+                             sizeof(addr))) {
+    std::cerr << "could not connect to \"" << socketpath
+              << "\": " << std::strerror(errno) << '\n';
+    if (fd >= 0) {
+      close(fd);
+    }
+    return EXIT_FAILURE;
+  }
+  if (!writeall(fd, request + "\n")) {
+    std::cerr << "could not ask \"" << socketpath
+              << "\": " << std::strerror(errno) << '\n';
+    close(fd);
+    return EXIT_FAILURE;
+  }
+  shutdown(fd, SHUT_WR);
+  char chunk[4096];
+  for (;;) {
+    const auto ret = recv(fd, chunk, sizeof(chunk), 0);
+    if (ret < 0 && errno == EINTR) {
+      continue;
+    }
+    if (ret <= 0) {
+      break;
+    }
+    std::cout.write(chunk, ret);
+  }
+  std::cout.flush();
+  close(fd);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,138 @@
+/*
+   copyright 2026 Paul Dreik
+   Distributed under GPL v 2.0 or later, at your option.
+   See LICENSE for further details.
+*/
+#ifndef RDFIND_WATCHDAEMON_HH_
+#define RDFIND_WATCHDAEMON_HH_
+
+#include <ctime>
+#include <functional>
+#include <map>
+#include <set>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// os specific headers
+#include <sys/types.h>
+
+#include "Fileinfo.hh"
+
+struct Options;
+class PathFilter;
+
+/**
+ * Keeps the files under a set of directories in memory and follows changes
+ * to them with inotify, so that duplicates can be asked for at any time
+ * without scanning again.
+ *
+ * The buffers read during the elimination stages are remembered per file
+ * until the file changes, so answering a question only reads the files
+ * which changed since the last one and are still candidates. Questions are
+ * asked over a unix domain socket, one per connection:
+ *
+ *   DUPLICATES     the duplicates, in the results file format
+ *   ISDUP <name>   one of "DUPLICATE <name of original>",
+ *                  "ORIGINAL <number of duplicates>", "UNIQUE" or "UNKNOWN"
+ *
+ * Names are the names rdfind gives the files, as in the results file.
+ */
+class WatchDaemon
+{
+public:
+  explicit WatchDaemon(const Options& options);
+  WatchDaemon(const WatchDaemon&) = delete;
+  WatchDaemon& operator=(const WatchDaemon&) = delete;
+  ~WatchDaemon();
+
+  /**
+   * scans a file or directory given on the command line and watches the
+   * directories found. must be called before run.
+   * @return zero on success
+   */
+  int addroot(const std::string& path, int cmdline_index);
+
+  /**
+   * answers questions on the socket and follows changes to the files, until
+   * interrupted by SIGINT or SIGTERM.
+   * @return the exit status for main
+   */
+  int run(const std::string& socketpath);
+
+  /// entries to skip, also when they appear later. may be nullptr.
+  void setfilter(const PathFilter* filter) { m_filter = filter; }
+
+  /// the number of files known
+  std::size_t filecount() const { return m_files.size(); }
+
+  /**
+   * asks a running daemon a question and prints the answer to stdout.
+   * @return the exit status for main
+   */
+  static int query(const std::string& socketpath, const std::string& request);
+
+private:
+  struct File
+  {
+    Fileinfo::filesizetype size;
+    dev_t device;
+    ino_t inode;
+    struct timespec mtime;
+    int cmdline_index;
+    int depth;
+    // the buffers read so far, by read mode. cleared when the file changes.
+    std::map<Fileinfo::readtobuffermode, std::string> buffers;
+  };
+
+  struct Watch
+  {
+    std::string path;
+    int cmdline_index;
+    int depth;
+  };
+
+  // callbacks from Dirlist, which only accepts plain functions
+  static int reportfile(const std::string& path,
+                        const std::string& name,
+                        int depth,
+                        const struct stat* info);
+  static void reportdir(const std::string& path, int depth);
+
+  void scan(const std::string& path, int cmdline_index, int depth);
+  void updatefile(const std::string& name,
+                  const struct stat& info,
+                  int cmdline_index,
+                  int depth);
+  void removefile(const std::string& name);
+  void removetree(const std::string& path);
+  void addwatch(const std::string& path, int cmdline_index, int depth);
+  void rescan();
+  void handleevents();
+  std::string answer(const std::string& request);
+
+  /**
+   * runs the elimination stages over the files with the given size, or all
+   * sizes if nullptr.
+   * @return the duplicates, marked as by Rdutil::markduplicates
+   */
+  std::vector<Fileinfo> findduplicates(const Fileinfo::filesizetype* onlysize);
+
+  const Options& m_options;
+  const PathFilter* m_filter = nullptr;
+  int m_inotifyfd = -1;
+  bool m_warnedaboutwatches = false;
+  // what was given on the command line, by command line index
+  std::map<int, std::string> m_roots;
+  std::unordered_map<int, Watch> m_watches;
+  std::map<std::string, File, std::less<>> m_files;
+  // the names of the files, by size. the names refer to the keys of m_files.
+  std::map<Fileinfo::filesizetype, std::set<std::string_view>> m_bysize;
+
+  // used by the Dirlist callbacks
+  static WatchDaemon* s_scanning;
+  static int s_cmdline_index;
+};
+
+#endif /* RDFIND_WATCHDAEMON_HH_ */
@@ -10,25 +10,51 @@ static_assert(__cplusplus >= 201703L,
               "this code requires a C++17 capable compiler!");
 
 // std
+#include <algorithm>
+#include <cerrno>
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <memory>
+#include <set>
 #include <sstream>
 #include <string>
 #include <vector>
 
+// os
+#include <sys/stat.h>
+#include <unistd.h>
+
 // project
+#include "ApplyResults.hh" //to act on an earlier results file
+#include "Checkpoint.hh"   //to resume interrupted runs
+#include "ChunkReport.hh"  //to find the parts files have in common
 #include "CmdlineParser.hh"
+#include "DirCache.hh"    //to remember directory listings
+#include "DirDuplicates.hh" //to find duplicate directories
 #include "Dirlist.hh"     //to find files
+#include "ExtentMap.hh"   //to read files sharing extents once
+#include "FileList.hh"    //to read the files from a list
 #include "Fileinfo.hh"    //file container
+#include "Manifest.hh"    //to find duplicates over several nodes
 #include "Options.hh"     //
+#include "PathFilter.hh"  //to skip files and directories
 #include "RdfindDebug.hh" //debug macro
 #include "Rdutil.hh"      //to do some work
+#include "ReferenceIndex.hh" //to compare against a reference corpus
+#include "ResultStream.hh"   //to write the results as they are found
+#include "ResultsFile.hh"    //to merge the results of shards
+#include "StreamScanner.hh"  //to read while traversing
+#include "Throttle.hh"       //to set the I/O scheduling class
+#include "WatchDaemon.hh"    //to keep running and follow changes
 
 // global variables
 
 // this vector holds the information about all files found
 std::vector<Fileinfo> filelist;
 const Options* global_options{};
+// reads the files found during the traversal, if requested
+StreamScanner* global_streamscanner{};
 
 /**
  * this contains the command line index for the path currently
@@ -39,7 +65,10 @@ int current_cmdline_index = 0;
 
 // function to add items to the list of all files
 static int
-report(const std::string& path, const std::string& name, int depth)
+report(const std::string& path,
+       const std::string& name,
+       int depth,
+       const struct stat* info)
 {
 
   RDDEBUG("report(" << path.c_str() << "," << name.c_str() << "," << depth
@@ -49,12 +78,22 @@ report(const std::string& path, const std::string& name, int depth)
   std::string expandedname = path.empty() ? name : (path + "/" + name);
 
   Fileinfo tmp(std::move(expandedname), current_cmdline_index, depth);
-  if (tmp.readfileinfo()) {
+  // reuse the stat information if the caller already has it
+  bool haveinfo = true;
+  if (info) {
+    tmp.setfileinfo(*info);
+  } else {
+    haveinfo = tmp.readfileinfo();
+  }
+  if (haveinfo) {
     if (tmp.isRegularFile()) {
       const auto size = tmp.size();
       if (size >= global_options->minimumfilesize &&
           size < global_options->maximumfilesize) {
         filelist.emplace_back(std::move(tmp));
+        if (global_streamscanner) {
+          global_streamscanner->add(filelist.back());
+        }
       }
     }
   } else {
@@ -64,6 +103,145 @@ report(const std::string& path, const std::string& name, int depth)
   return 0;
 }
 
+// reads all files found and writes their buffers to an index
+static int
+buildindex(const Options& o, Rdutil& gswd, const std::string& dryruntext)
+{
+  std::cout << dryruntext << "Now have " << filelist.size()
+            << " files in total." << std::endl;
+  gswd.markitems();
+  if (o.remove_identical_inode) {
+    std::cout << dryruntext << "Removed " << gswd.removeIdenticalInodes()
+              << " files due to nonunique device and inode." << std::endl;
+  }
+
+  // every file is indexed, since any of them may have a duplicate among the
+  // files given to later runs.
+  ReferenceIndexWriter writer(o);
+  gswd.addbufferobserver(
+    [&writer](const Fileinfo& file, Fileinfo::readtobuffermode mode) {
+      writer.recordbuffer(file, mode);
+    });
+  auto lastmode = Fileinfo::readtobuffermode::NOT_DEFINED;
+  for (const auto& stage : Rdutil::stages(o)) {
+    std::cout << dryruntext << "Now indexing " << stage.second << std::endl;
+    gswd.fillwithbytes(stage.first, lastmode, o, {});
+    lastmode = stage.first;
+  }
+
+  if (0 != writer.write(o.buildindexfile, filelist)) {
+    return EXIT_FAILURE;
+  }
+  std::cout << dryruntext << "Wrote index of " << filelist.size()
+            << " files to " << o.buildindexfile << std::endl;
+  return 0;
+}
+
+// reads the files of this node and writes their buffers to a manifest
+static int
+exportmanifest(const Options& o, Rdutil& gswd, const std::string& dryruntext)
+{
+  std::cout << dryruntext << "Now have " << filelist.size()
+            << " files in total." << std::endl;
+  gswd.markitems();
+  if (o.remove_identical_inode) {
+    std::cout << dryruntext << "Removed " << gswd.removeIdenticalInodes()
+              << " files due to nonunique device and inode." << std::endl;
+  }
+
+  // only sizes found more than once among all nodes need to be read. without
+  // the sizes of the other nodes, all files have to be.
+  if (!o.collidingsizesfiles.empty()) {
+    std::set<Fileinfo::filesizetype> sizes;
+    if (0 != readcollidingsizes(o.collidingsizesfiles, sizes)) {
+      return EXIT_FAILURE;
+    }
+    const auto before = filelist.size();
+    filelist.erase(std::remove_if(filelist.begin(),
+                                  filelist.end(),
+                                  [&sizes](const Fileinfo& f) {
+                                    return sizes.count(f.size()) == 0;
+                                  }),
+                   filelist.end());
+    std::cout << dryruntext << "Removed " << before - filelist.size()
+              << " files due to sizes unique among all nodes. "
+              << filelist.size() << " files left." << std::endl;
+  }
+
+  std::string nodename = o.nodename;
+  if (nodename.empty()) {
+    char hostname[256]{};
+    gethostname(hostname, sizeof(hostname) - 1);
+    nodename = hostname;
+  }
+
+  ManifestWriter writer(o);
+  gswd.addbufferobserver(
+    [&writer](const Fileinfo& file, Fileinfo::readtobuffermode mode) {
+      writer.recordbuffer(file, mode);
+    });
+  auto lastmode = Fileinfo::readtobuffermode::NOT_DEFINED;
+  for (const auto& stage : Rdutil::stages(o)) {
+    std::cout << dryruntext << "Now reading " << stage.second << std::endl;
+    gswd.fillwithbytes(stage.first, lastmode, o, {});
+    lastmode = stage.first;
+  }
+
+  if (0 != writer.write(o.exportmanifestfile, nodename, filelist)) {
+    return EXIT_FAILURE;
+  }
+  std::cout << dryruntext << "Wrote manifest of " << filelist.size()
+            << " files on node " << nodename << " to "
+            << o.exportmanifestfile << std::endl;
+  return 0;
+}
+
+// cuts all files into chunks and reports the chunks they have in common
+static int
+chunkreport(const Options& o, Rdutil& gswd, const std::string& dryruntext)
+{
+  std::cout << dryruntext << "Now have " << filelist.size()
+            << " files in total." << std::endl;
+  gswd.markitems();
+  if (o.remove_identical_inode) {
+    std::cout << dryruntext << "Removed " << gswd.removeIdenticalInodes()
+              << " files due to nonunique device and inode." << std::endl;
+  }
+
+  // removing identical inodes sorts on inode. in ranking order, each chunk
+  // is credited to the best ranked file holding it.
+  gswd.sortOnRank();
+  std::cout << dryruntext << "Now cutting files into chunks: " << std::flush;
+  ChunkReport report(o);
+  std::size_t failed = 0;
+  for (const auto& file : filelist) {
+    if (0 != report.add(file)) {
+      ++failed;
+    }
+  }
+  std::cout << "read " << report.bytes() << " bytes in " << report.chunks()
+            << " chunks, " << report.sharedbytes()
+            << " bytes in chunks seen before." << std::endl;
+  if (failed != 0) {
+    std::cout << dryruntext << "Failed reading " << failed << " files."
+              << std::endl;
+  }
+
+  if (o.dedupextents) {
+    std::cout << dryruntext << "Now sharing the extents of the chunks in "
+              << "common." << std::endl;
+    report.dedup(o.dryrun).report(std::cout, dryruntext);
+  }
+
+  if (0 != report.write(o.chunkreportfile)) {
+    return EXIT_FAILURE;
+  }
+  std::cout << dryruntext << "Wrote " << report.pairs()
+            << " pairs of files with chunks in common to "
+            << o.chunkreportfile << std::endl;
+  return 0;
+}
+
 int
 main(int narg, const char* argv[])
 {
@@ -80,6 +258,76 @@ main(int narg, const char* argv[])
   // set the dryrun string
   const std::string dryruntext(o.dryrun ? "(DRYRUN MODE) " : "");
 
+  // before any thread is started, so they all inherit it
+  if (0 != setioclass(o.ioclass)) {
+    std::cerr << "could not set the I/O scheduling class: "
+              << std::strerror(errno) << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  if (!o.querysocket.empty()) {
+    // the rest of the arguments is the question
+    std::string request;
+    for (; parser.has_args_left(); parser.advance()) {
+      if (!request.empty()) {
+        request += ' ';
+      }
+      request += parser.get_current_arg();
+    }
+    return WatchDaemon::query(o.querysocket, request);
+  }
+
+  if (o.mergemanifests) {
+    // the rest of the arguments are the manifests
+    std::vector<std::string> manifests;
+    for (; parser.has_args_left(); parser.advance()) {
+      manifests.emplace_back(parser.get_current_arg());
+    }
+    return 0 == mergemanifests(manifests, o) ? 0 : EXIT_FAILURE;
+  }
+
+  if (o.mergeresults) {
+    // the rest of the arguments are the results files of the shards
+    std::vector<std::string> resultsfiles;
+    for (; parser.has_args_left(); parser.advance()) {
+      resultsfiles.emplace_back(parser.get_current_arg());
+    }
+    return 0 == mergeresults(resultsfiles, o.resultsfile) ? 0 : EXIT_FAILURE;
+  }
+
+  if (!o.applyfile.empty()) {
+    if (parser.has_args_left()) {
+      std::cerr << "-apply takes the files from the results file, files and "
+                   "directories can not be given\n";
+      std::exit(EXIT_FAILURE);
+    }
+    return 0 == applyresults(o, dryruntext) ? 0 : EXIT_FAILURE;
+  }
+
+  // what to skip while traversing
+  PathFilter filter;
+  if (0 != filter.compile(o)) {
+    std::exit(EXIT_FAILURE);
+  }
+
+  if (!o.watchsocket.empty()) {
+    WatchDaemon daemon(o);
+    daemon.setfilter(&filter);
+    for (; parser.has_args_left(); parser.advance()) {
+      std::string file_or_dir(parser.get_current_arg());
+      // remove trailing /
+      while (file_or_dir.back() == '/' && file_or_dir.size() > 1) {
+        file_or_dir.erase(file_or_dir.size() - 1);
+      }
+      const auto lastcount = daemon.filecount();
+      std::cout << "Now scanning \"" << file_or_dir << "\"" << std::flush;
+      daemon.addroot(file_or_dir, parser.get_current_index());
+      std::cout << ", found " << daemon.filecount() - lastcount << " files."
+                << std::endl;
+    }
+    return daemon.run(o.watchsocket);
+  }
+
   // an object to do sorting and duplicate finding
   Rdutil gswd(filelist);
 
@@ -91,8 +339,30 @@ main(int narg, const char* argv[])
   // options is set as well.
   global_options = &o;
   dirlist.setcallbackfcn(&report);
+  dirlist.setfilter(&filter);
+  dirlist.setsortsubdirs(o.deterministic);
+
+  // directory listings remembered from the previous run, if requested.
+  DirCache dircache(o.dircachemaxage);
+  if (!o.dircachefile.empty()) {
+    dircache.load(o.dircachefile);
+    dirlist.setdircache(&dircache);
+  }
 
-  if (o.makeresultsfile) {
+  // writes each set of duplicates as soon as it is confirmed, if requested
+  ResultStream resultstream(o);
+  if (o.streamresults) {
+    if (o.makeresultsfile) {
+      std::cout << dryruntext << "Now streaming results to " << o.resultsfile
+                << std::endl;
+    }
+    if (0 != resultstream.open()) {
+      std::exit(EXIT_FAILURE);
+    }
+    gswd.addgroupobserver([&resultstream](std::vector<Fileinfo> group) {
+      resultstream.add(std::move(group));
+    });
+  } else if (o.makeresultsfile) {
     // make sure the results file can be opened, before doing all potentially
     // lengthy work. in case of permission problems, it is not fun to find out
     // only after the fact. see https://github.com/pauldreik/rdfind/issues/128
@@ -103,6 +373,72 @@ main(int narg, const char* argv[])
     }
   }
 
+  // journal of the progress, to be able to resume an interrupted run.
+  Checkpoint checkpoint;
+  const bool resumed = !o.resumefile.empty();
+  if (resumed) {
+    if (parser.has_args_left()) {
+      std::cerr << "-resume continues the run the checkpoint was made from, "
+                   "files and directories can not be given\n";
+      std::exit(EXIT_FAILURE);
+    }
+    if (0 != checkpoint.resume(o.resumefile, o, filelist)) {
+      std::exit(EXIT_FAILURE);
+    }
+    std::cout << dryruntext << "Resumed " << filelist.size()
+              << " candidates from checkpoint " << o.resumefile << std::endl;
+  } else if (!o.checkpointfile.empty()) {
+    if (0 != checkpoint.create(o.checkpointfile, o)) {
+      std::exit(EXIT_FAILURE);
+    }
+  }
+
+  // started before the traversal, to read files while it is going on
+  std::unique_ptr<StreamScanner> streamscanner;
+  if (o.streamscan) {
+    streamscanner = std::make_unique<StreamScanner>(o);
+    global_streamscanner = streamscanner.get();
+  }
+
+  // files from an earlier run to check the new files against. the files
+  // given now rank after all of them.
+  ReferenceIndex referenceindex;
+  int cmdline_index_offset = 0;
+  if (!o.referenceindexfile.empty()) {
+    if (0 != referenceindex.open(o.referenceindexfile, o)) {
+      std::exit(EXIT_FAILURE);
+    }
+    cmdline_index_offset = referenceindex.maxcmdlineindex();
+    resultstream.setlastreferenceindex(cmdline_index_offset);
+  }
+
+  // files from a list rank before the files and directories given as
+  // arguments, in the order of their groups.
+  if (!o.filesfrom.empty()) {
+    FileList listreader(o.filesfromformat);
+    const auto lastsize = filelist.size();
+    std::cout << dryruntext << "Now reading file list \"" << o.filesfrom
+              << "\"" << std::flush;
+    const int ret = listreader.read(
+      o.filesfrom,
+      [cmdline_index_offset](const std::string& name,
+                             int group,
+                             int depth,
+                             const struct stat* info) {
+        current_cmdline_index = cmdline_index_offset + group;
+        return report(std::string(), name, depth, info);
+      });
+    if (ret != 0) {
+      std::exit(EXIT_FAILURE);
+    }
+    std::cout << ", found " << filelist.size() - lastsize << " files."
+              << std::endl;
+    if (o.deterministic) {
+      gswd.sort_on_depth_and_name(lastsize);
+    }
+    cmdline_index_offset += listreader.maxgroup();
+  }
+
   // now loop over path list and add the files
 
   // done with arguments. start parsing files and directories!
@@ -120,7 +456,7 @@ main(int narg, const char* argv[])
     auto lastsize = filelist.size();
     std::cout << dryruntext << "Now scanning \"" << file_or_dir << "\"";
     std::cout.flush();
-    current_cmdline_index = parser.get_current_index();
+    current_cmdline_index = parser.get_current_index() + cmdline_index_offset;
     dirlist.walk(file_or_dir, 0);
     std::cout << ", found " << filelist.size() - lastsize << " files."
               << std::endl;
@@ -132,96 +468,229 @@ main(int narg, const char* argv[])
     }
   }
 
-  std::cout << dryruntext << "Now have " << filelist.size()
-            << " files in total." << std::endl;
+  if (streamscanner) {
+    // the rest of the reading is made by the stages as usual
+    streamscanner->finish();
+    global_streamscanner = nullptr;
+    std::cout << dryruntext << "Read " << streamscanner->probed()
+              << " files while traversing." << std::endl;
+    gswd.addbufferprovider(
+      [&streamscanner](Fileinfo& file, Fileinfo::readtobuffermode mode) {
+        return streamscanner->restorebuffer(file, mode);
+      });
+  }
 
-  // mark files with a number for correct ranking. The only ordering at this
-  // point is that files found on early command line index are earlier in the
-  // list.
-  gswd.markitems();
+  if (!o.dircachefile.empty()) {
+    std::cout << dryruntext << "Used cached listings for " << dircache.hits()
+              << " directories, listed " << dircache.misses() << "."
+              << std::endl;
+    dircache.save(o.dircachefile);
+  }
 
-  if (o.remove_identical_inode) {
-    // remove files with identical devices and inodes from the list
-    std::cout << dryruntext << "Removed " << gswd.removeIdenticalInodes()
-              << " files due to nonunique device and inode." << std::endl;
+  if (!o.buildindexfile.empty()) {
+    return buildindex(o, gswd, dryruntext);
+  }
+
+  if (!o.exportsizesfile.empty()) {
+    gswd.markitems();
+    if (o.remove_identical_inode) {
+      gswd.removeIdenticalInodes();
+    }
+    if (0 != writesizes(o.exportsizesfile, filelist)) {
+      return EXIT_FAILURE;
+    }
+    std::cout << dryruntext << "Wrote sizes of " << filelist.size()
+              << " files to " << o.exportsizesfile << std::endl;
+    return 0;
+  }
+
+  if (!o.exportmanifestfile.empty()) {
+    return exportmanifest(o, gswd, dryruntext);
+  }
+
+  if (!o.chunkreportfile.empty()) {
+    return chunkreport(o, gswd, dryruntext);
   }
 
-  std::cout << dryruntext << "Total size is " << gswd.totalsizeinbytes()
-            << " bytes or ";
-  gswd.totalsize(std::cout) << std::endl;
+  if (!o.referenceindexfile.empty()) {
+    const auto added = referenceindex.addcandidates(filelist);
+    std::cout << dryruntext << "Added " << added
+              << " files of the same size from reference index "
+              << o.referenceindexfile << std::endl;
+    gswd.addbufferprovider(
+      [&referenceindex](Fileinfo& file, Fileinfo::readtobuffermode mode) {
+        return referenceindex.restorebuffer(file, mode);
+      });
+  }
+
+  if (!resumed) {
+    std::cout << dryruntext << "Now have " << filelist.size()
+              << " files in total." << std::endl;
+
+    // mark files with a number for correct ranking. The only ordering at this
+    // point is that files found on early command line index are earlier in the
+    // list.
+    gswd.markitems();
+
+    if (o.shardcount != 0) {
+      // the files are marked as in a run over all shards, so the ranking and
+      // the results file are the same.
+      std::cout << dryruntext << "Removed "
+                << gswd.removeOtherShards(o.shardindex, o.shardcount)
+                << " files belonging to other shards. " << filelist.size()
+                << " files left." << std::endl;
+    }
+
+    if (o.remove_identical_inode) {
+      // remove files with identical devices and inodes from the list
+      std::cout << dryruntext << "Removed " << gswd.removeIdenticalInodes()
+                << " files due to nonunique device and inode." << std::endl;
+    }
+
+    std::cout << dryruntext << "Total size is " << gswd.totalsizeinbytes()
+              << " bytes or ";
+    gswd.totalsize(std::cout) << std::endl;
+
+    std::cout << dryruntext << "Removed " << gswd.removeUniqueSizes()
+              << " files due to unique sizes from list. ";
+    std::cout << filelist.size() << " files left." << std::endl;
 
-  std::cout << dryruntext << "Removed " << gswd.removeUniqueSizes()
-            << " files due to unique sizes from list. ";
-  std::cout << filelist.size() << " files left." << std::endl;
+    // this is the state an interrupted run is resumed from.
+    checkpoint.recordfilelist(filelist);
+  }
 
   // ok. we now need to do something stronger to disambiguate the duplicate
   // candidates. start looking at the contents.
   std::vector<std::pair<Fileinfo::readtobuffermode, const char*>> modes{
     { Fileinfo::readtobuffermode::NOT_DEFINED, "" },
   };
-  if (o.first_bytes_size > 0) {
-    modes.emplace_back(Fileinfo::readtobuffermode::READ_FIRST_BYTES,
-                       "first bytes");
-  }
-  if (o.last_bytes_size > 0) {
-    modes.emplace_back(Fileinfo::readtobuffermode::READ_LAST_BYTES,
-                       "last bytes");
-  }
-  if (o.usemd5) {
-    modes.emplace_back(Fileinfo::readtobuffermode::CREATE_MD5_CHECKSUM,
-                       "md5 checksum");
+  for (const auto& stage : Rdutil::stages(o)) {
+    modes.push_back(stage);
   }
-  if (o.usesha1) {
-    modes.emplace_back(Fileinfo::readtobuffermode::CREATE_SHA1_CHECKSUM,
-                       "sha1 checksum");
-  }
-  if (o.usesha256) {
-    modes.emplace_back(Fileinfo::readtobuffermode::CREATE_SHA256_CHECKSUM,
-                       "sha256 checksum");
-  }
-  if (o.usesha512) {
-    modes.emplace_back(Fileinfo::readtobuffermode::CREATE_SHA512_CHECKSUM,
-                       "sha512 checksum");
+
+  if (resumed || !o.checkpointfile.empty()) {
+    gswd.addbufferprovider(
+      [&checkpoint](Fileinfo& file, Fileinfo::readtobuffermode mode) {
+        return checkpoint.restorebuffer(file, mode);
+      });
+    gswd.addbufferobserver(
+      [&checkpoint](const Fileinfo& file, Fileinfo::readtobuffermode mode) {
+        checkpoint.recordbuffer(file, mode);
+      });
   }
-  if (o.usexxh128) {
-    modes.emplace_back(Fileinfo::readtobuffermode::CREATE_XXH128_CHECKSUM,
-                       "xxh128 checksum");
+
+  SharedExtents sharedextents;
+  if (o.checkextents) {
+    std::cout << dryruntext << "Found " << sharedextents.scan(filelist)
+              << " files sharing all of their extents with another, they are "
+                 "read once."
+              << std::endl;
+    gswd.addbufferprovider(
+      [&sharedextents](Fileinfo& file, Fileinfo::readtobuffermode mode) {
+        return sharedextents.restorebuffer(file, mode);
+      });
+    gswd.addbufferobserver(
+      [&sharedextents](const Fileinfo& file, Fileinfo::readtobuffermode mode) {
+        sharedextents.recordbuffer(file, mode);
+      });
   }
 
   std::function<void(std::size_t)> progress_callback;
 
-  for (auto it = modes.begin() + 1; it != modes.end(); ++it) {
-    std::cout << dryruntext << "Now eliminating candidates based on "
-              << it->second << ": " << std::flush;
-
+  if (o.threads > 1) {
+    // each group of candidates goes through the stages on its own
+    std::vector<Fileinfo::readtobuffermode> pipelined;
+    for (auto it = modes.begin() + 1; it != modes.end(); ++it) {
+      pipelined.push_back(it->first);
+    }
+    std::cout << dryruntext << "Now eliminating candidates in all stages with "
+              << o.threads << " threads: " << std::flush;
     if (o.showprogress) {
-      progress_callback = []() {
-        // format the total count only once, not each iteration.
-        std::ostringstream oss;
-        oss << "/" << filelist.size() << ")"
-            << "\033[u"; // Restore the cursor to the saved position;
-        return [suffix = oss.str()](std::size_t completed) {
-          std::cout
-            << "\033[s\033[K" // Save the cursor position & clear following text
-            << "(" << completed << suffix << std::flush;
-        };
-      }();
+      progress_callback = [](std::size_t completed) {
+        std::cout
+          << "\033[s\033[K" // Save the cursor position & clear following text
+          << "(" << completed << " files read)"
+          << "\033[u" // Restore the cursor to the saved position
+          << std::flush;
+      };
     }
-
-    // read bytes (destroys the sorting, for disk reading efficiency)
-    gswd.fillwithbytes(it[0].first, it[-1].first, o, progress_callback);
-
-    // remove non-duplicates
-    std::cout << "removed " << gswd.removeUniqSizeAndBuffer()
+    std::cout << "removed "
+              << gswd.pipelinestages(pipelined, o, o.threads, progress_callback)
               << " files from list. ";
     std::cout << filelist.size() << " files left." << std::endl;
+    for (const auto mode : pipelined) {
+      checkpoint.recordstagedone(mode);
+    }
+  } else {
+    for (auto it = modes.begin() + 1; it != modes.end(); ++it) {
+      std::cout << dryruntext << "Now eliminating candidates based on "
+                << it->second << ": " << std::flush;
+      if (checkpoint.stagedone(it->first)) {
+        std::cout << "(done before, reusing the checkpoint) " << std::flush;
+      }
+
+      if (o.showprogress) {
+        progress_callback = []() {
+          // format the total count only once, not each iteration.
+          std::ostringstream oss;
+          oss << "/" << filelist.size() << ")"
+              << "\033[u"; // Restore the cursor to the saved position;
+          return [suffix = oss.str()](std::size_t completed) {
+            // Save the cursor position & clear following text
+            std::cout << "\033[s\033[K"
+                      << "(" << completed << suffix << std::flush;
+          };
+        }();
+      }
+
+      // read bytes (destroys the sorting, for disk reading efficiency)
+      gswd.fillwithbytes(it[0].first, it[-1].first, o, progress_callback);
+
+      // remove non-duplicates
+      std::cout << "removed " << gswd.removeUniqSizeAndBuffer()
+                << " files from list. ";
+      std::cout << filelist.size() << " files left." << std::endl;
+      checkpoint.recordstagedone(it->first);
+    }
+    // the last stage confirmed all sets at once
+    gswd.observegroups();
+  }
+
+  // directories holding nothing but duplicates may be duplicates as a whole.
+  // the files within them go with them, instead of being reported one by one.
+  DirDuplicates dirduplicates;
+  if (o.dirduplicates) {
+    std::cout << dryruntext << "Now looking for duplicate directories: found "
+              << dirduplicates.find(filelist, o) << " with "
+              << dirduplicates.files() << " files and "
+              << dirduplicates.bytes() << " bytes in them, ";
+    const auto removed =
+      dirduplicates.prune(filelist) + gswd.removeUniqSizeAndBuffer();
+    std::cout << "removed " << removed << " files from list. "
+              << filelist.size() << " files left." << std::endl;
   }
 
   // What is left now is a list of duplicates, ordered on size.
   // We also know the list is ordered on size, then bytes, and all unique
   // files are gone so it contains sequences of duplicates. Go ahead and mark
-  // them.
-  gswd.markduplicates();
+  // them. hard links and shared extents can only be made within a device, so
+  // then each device gets an original of its own.
+  const bool perdevice = o.makehardlinks || o.dedupextents;
+  const auto alone = gswd.markduplicates(perdevice);
+  if (perdevice) {
+    std::cout << dryruntext << "Removed " << alone
+              << " files without a duplicate on their own device."
+              << std::endl;
+  }
+
+  if (!o.referenceindexfile.empty()) {
+    // the reference is only compared against, it is not acted upon.
+    std::cout << dryruntext << "Removed "
+              << gswd.removereferenceduplicates(
+                   referenceindex.maxcmdlineindex())
+              << " reference files from the list of duplicates."
+              << std::endl;
+  }
 
   std::cout << dryruntext << "It seems like you have " << filelist.size()
             << " files that are not unique\n";
@@ -229,18 +698,61 @@ main(int narg, const char* argv[])
   std::cout << dryruntext << "Totally, ";
   gswd.saveablespace(std::cout) << " can be reduced." << std::endl;
 
+  if (o.streamresults) {
+    // the sets were written and acted on as they were confirmed
+    resultstream.close();
+    if (o.makesymlinks || o.makehardlinks || o.deleteduplicates ||
+        o.dedupextents) {
+      std::cout << dryruntext << "Took the action on "
+                << resultstream.acted()
+                << " files as their duplicates were confirmed." << std::endl;
+    }
+    if (o.dedupextents) {
+      resultstream.dedupsummary().report(std::cout, dryruntext);
+    }
+    return 0;
+  }
+
+  // the extents are shared first, so the results file can tell which files
+  // were not shared completely
+  if (o.dedupextents) {
+    std::cout << dryruntext << "Now sharing the extents of duplicates."
+              << std::endl;
+    gswd.dedupextents(o.dryrun, o.threads).report(std::cout, dryruntext);
+  }
+
   // traverse the list and make a nice file with the results
   if (o.makeresultsfile) {
     std::cout << dryruntext << "Now making results file " << o.resultsfile
               << std::endl;
-    gswd.printtofile(o.resultsfile);
+    gswd.printtofile(o.resultsfile,
+                     o.outputformat,
+                     Rdutil::digestlength(o),
+                     dirduplicates.directories());
+  }
+
+  // the duplicate directories are taken care of before the files left
+  if (o.dirduplicates && o.makesymlinks) {
+    std::cout << dryruntext
+              << "Now replacing duplicate directories with symbolic links."
+              << std::endl;
+    const auto tmp = dirduplicates.makesymlinks(o.dryrun);
+    std::cout << dryruntext << "Replaced " << tmp << " directories."
+              << std::endl;
+  }
+  if (o.dirduplicates && o.deleteduplicates) {
+    std::cout << dryruntext << "Now deleting duplicate directories:"
+              << std::endl;
+    const auto tmp = dirduplicates.deleteduplicates(o.dryrun);
+    std::cout << dryruntext << "Deleted " << tmp << " directories."
+              << std::endl;
   }
 
   // traverse the list and replace with symlinks
   if (o.makesymlinks) {
     std::cout << dryruntext << "Now making symbolic links. creating "
               << std::endl;
-    const auto tmp = gswd.makesymlinks(o.dryrun);
+    const auto tmp = gswd.makesymlinks(o.dryrun, o.threads);
     std::cout << "Making " << tmp << " links." << std::endl;
     return 0;
   }
@@ -248,7 +760,7 @@ main(int narg, const char* argv[])
   // traverse the list and replace with hard links
   if (o.makehardlinks) {
     std::cout << dryruntext << "Now making hard links." << std::endl;
-    const auto tmp = gswd.makehardlinks(o.dryrun);
+    const auto tmp = gswd.makehardlinks(o.dryrun, o.threads);
     std::cout << dryruntext << "Making " << tmp << " links." << std::endl;
     return 0;
   }
@@ -256,7 +768,7 @@ main(int narg, const char* argv[])
   // traverse the list and delete files
   if (o.deleteduplicates) {
     std::cout << dryruntext << "Now deleting duplicates:" << std::endl;
-    const auto tmp = gswd.deleteduplicates(o.dryrun);
+    const auto tmp = gswd.deleteduplicates(o.dryrun, o.threads);
     std::cout << dryruntext << "Deleted " << tmp << " files." << std::endl;
     return 0;
   }
@@ -0,0 +1,80 @@
+#!/bin/sh
+# Ensures -apply takes the action on the duplicates of an earlier results
+# file, and skips what changed since.
+#
+
+set -e
+. "$(dirname "$0")/common_funcs.sh"
+
+reset_teststate
+
+mkdir -p a b
+echo one >a/one
+echo one >b/one
+echo two >a/two
+echo two >b/two
+echo two >b/two2
+echo three >a/three
+echo three >b/three
+
+$rdfind -outputname results.txt a b >rdfind.out
+verify [ "$(grep -c -v '^#' results.txt)" -eq 7 ]
+
+# the set of three is left alone by removing its duplicate
+grep -v 'b/three$' results.txt >trimmed.txt
+# modified after the scan
+sleep 0.01
+echo TWO >b/two2
+# the same size, inode and time, but other contents
+echo ONE >b/one
+touch -r a/one b/one
+
+$rdfind -apply trimmed.txt -applyverify true -makehardlinks true >rdfind.out
+verify grep -q "Skipped 1 changed files and 1 files with other contents" \
+  rdfind.out
+verify [ "$(stat -c %i a/two)" = "$(stat -c %i b/two)" ]
+verify [ "$(stat -c %i a/two)" != "$(stat -c %i b/two2)" ]
+verify [ "$(stat -c %i a/one)" != "$(stat -c %i b/one)" ]
+verify [ "$(stat -c %i a/three)" != "$(stat -c %i b/three)" ]
+verify [ "$(cat b/one)" = "ONE" ]
+
+# without -applyverify, a text results file trimmed after the files changed
+# can not tell, so replacing files is refused
+reset_teststate
+mkdir -p a b
+echo one >a/one
+echo one >b/one
+$rdfind -outputname results.txt a b >rdfind.out
+echo ONE >b/one
+cp results.txt trimmed.txt
+if $rdfind -apply trimmed.txt -makehardlinks true >rdfind.out 2>&1; then
+  dbgecho "-apply of a text results file without -applyverify was accepted"
+  exit 1
+fi
+verify [ "$(cat b/one)" = "ONE" ]
+
+# the binary format has the change time of each file
+echo one >b/one
+$rdfind -outputname results.bin -outputformat binary a b >rdfind.out
+echo ONE >b/one
+cp results.bin trimmed.bin
+$rdfind -apply trimmed.bin -makehardlinks true >rdfind.out
+verify grep -q "Skipped 1 changed files" rdfind.out
+verify [ "$(cat b/one)" = "ONE" ]
+echo one >b/one
+$rdfind -outputname results.bin -outputformat binary a b >rdfind.out
+$rdfind -apply results.bin -makehardlinks true >rdfind.out
+verify grep -q "Skipped 0 changed files" rdfind.out
+verify [ "$(stat -c %i a/one)" = "$(stat -c %i b/one)" ]
+
+# files can not be given, and an action is needed
+if $rdfind -apply results.txt -deleteduplicates true a >rdfind.out 2>&1; then
+  dbgecho "files should not be accepted with -apply"
+  exit 1
+fi
+if $rdfind -apply results.txt >rdfind.out 2>&1; then
+  dbgecho "-apply without an action should fail"
+  exit 1
+fi
+
+dbgecho "all is good in this test!"
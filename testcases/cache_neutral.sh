@@ -0,0 +1,62 @@
+#!/bin/sh
+# Ensures -cacheneutral leaves the page cache as it was found: files which
+# were not cached are not cached after reading them, and files which were
+# stay cached.
+#
+
+set -e
+. "$(dirname "$0")/common_funcs.sh"
+
+if ! command -v fincore >/dev/null; then
+  echo "$me: fincore is not installed, exiting"
+  exit 0
+fi
+
+# the number of pages of the file in the page cache
+cachedpages() {
+  fincore --noheadings --output PAGES "$1" | tr -d ' '
+}
+
+# drops the file from the page cache
+uncache() {
+  dd if="$1" iflag=nocache count=0 status=none
+}
+
+reset_teststate
+mkdir d
+head -c 4000000 /dev/urandom >d/a
+cp d/a d/b
+sync
+uncache d/a
+uncache d/b
+if [ "$(cachedpages d/a)" -ne 0 ]; then
+  echo "$me: the file system keeps the files cached, exiting"
+  exit 0
+fi
+
+$rdfind -cacheneutral true d >rdfind.out
+verify grep -q "It seems like you have 2 files that are not unique" rdfind.out
+verify [ "$(cachedpages d/a)" -eq 0 ]
+verify [ "$(cachedpages d/b)" -eq 0 ]
+
+# without it, the files are cached
+$rdfind d >rdfind.out
+verify [ "$(cachedpages d/a)" -gt 0 ]
+
+# the files cached before stay cached
+cat d/a d/b >/dev/null
+before=$(cachedpages d/b)
+$rdfind -cacheneutral true d >rdfind.out
+verify [ "$(cachedpages d/b)" -eq "$before" ]
+
+# with -checksum none, only the first and last bytes are read
+uncache d/a
+$rdfind -cacheneutral true -checksum none d/a d/b >rdfind.out
+verify [ "$(cachedpages d/a)" -eq 0 ]
+
+# -chunkreport reads the files in pieces of other sizes
+uncache d/a
+$rdfind -cacheneutral true -chunkreport report.txt d/a >rdfind.out
+verify [ "$(cachedpages d/a)" -eq 0 ]
+
+dbgecho "all is good in this test!"
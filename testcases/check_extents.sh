@@ -0,0 +1,36 @@
+#!/bin/sh
+# Ensures -checkextents finds the same duplicates. Files sharing their
+# extents need a file system with reflinks, so mostly this checks that the
+# lookup does no harm.
+#
+
+set -e
+. "$(dirname "$0")/common_funcs.sh"
+
+reset_teststate
+mkdir d
+head -c 100000 /dev/urandom >d/a
+cp d/a d/b
+# copies sharing the extents, where the file system can
+cp --reflink=auto d/a d/c 2>/dev/null || cp d/a d/c
+head -c 100000 /dev/urandom >d/other
+sync
+
+$rdfind -checkextents false d >rdfind.out
+grep -v "^#" results.txt | sort >expected.txt
+if grep -q "sharing all of their extents" rdfind.out; then
+  dbgecho "the extents should only be looked up with -checkextents true"
+  exit 1
+fi
+
+$rdfind -checkextents true d >rdfind.out
+grep -v "^#" results.txt | sort >actual.txt
+verify grep -q "sharing all of their extents with another" rdfind.out
+verify cmp expected.txt actual.txt
+
+$rdfind -checkextents true -threads 2 d >rdfind.out
+grep -v "^#" results.txt | sort >actual.txt
+verify grep -q "sharing all of their extents with another" rdfind.out
+verify [ "$(wc -l <actual.txt)" -eq 3 ]
+
+dbgecho "all is good in this test!"
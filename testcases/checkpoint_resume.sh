@@ -0,0 +1,69 @@
+#!/bin/sh
+# Ensures an interrupted run can be resumed from a checkpoint, with the
+# same result as an uninterrupted run.
+#
+
+set -e
+. "$(dirname "$0")/common_funcs.sh"
+
+makefiles() {
+  mkdir -p tree/sd1 tree/sd2
+  for i in $(seq 1 20); do
+    head -c$((i * 100)) /dev/zero >"tree/sd1/zero$i"
+    head -c$((i * 100)) /dev/zero >"tree/sd2/zero$i"
+    # same size, different content
+    (head -c$((i * 100 - 1)) /dev/zero && echo) >"tree/sd2/nl$i"
+  done
+}
+
+reset_teststate
+makefiles
+
+# the reference, without checkpointing. the option is given as something
+# else, to get the same priority in the results file.
+$rdfind -outputname reference.txt -makeresultsfile true tree >rdfind.out
+
+$rdfind -outputname full.txt -checkpoint journal.bin tree >rdfind.out
+verify cmp reference.txt full.txt
+
+# resuming a finished run reuses everything. changing a file proves it is
+# not read again.
+head -c2000 /dev/urandom >tree/sd2/zero20
+$rdfind -resume journal.bin -outputname resumed.txt >rdfind.out
+verify grep -q "Resumed 60 candidates from checkpoint" rdfind.out
+verify cmp reference.txt resumed.txt
+head -c2000 /dev/zero >tree/sd2/zero20
+
+# simulate being killed at various points by truncating the journal
+fullsize=$(stat -c %s journal.bin)
+cp journal.bin complete.bin
+for cut in 3 100 555 1001; do
+  if [ $cut -ge "$fullsize" ]; then
+    continue
+  fi
+  head -c$((fullsize - cut)) complete.bin >journal.bin
+  $rdfind -resume journal.bin -outputname cut$cut.txt >rdfind.out
+  verify cmp reference.txt cut$cut.txt
+done
+
+# a journal without the complete file list can not be resumed
+head -c100 complete.bin >journal.bin
+if $rdfind -resume journal.bin >rdfind.out 2>&1; then
+  dbgecho "resuming before scanning finished should fail"
+  exit 1
+fi
+
+# resuming with options affecting the buffers is not possible
+cp complete.bin journal.bin
+if $rdfind -resume journal.bin -firstbytessize 10 >rdfind.out 2>&1; then
+  dbgecho "resuming with different options should fail"
+  exit 1
+fi
+
+# files can not be given when resuming
+if $rdfind -resume journal.bin tree >rdfind.out 2>&1; then
+  dbgecho "resuming with files should fail"
+  exit 1
+fi
+
+dbgecho "all is good in this test!"
@@ -0,0 +1,80 @@
+#!/bin/sh
+# Ensures -chunkreport finds the parts files have in common, also when they
+# are not duplicates, and that -dedupextents leaves the files as they are.
+#
+
+set -e
+. "$(dirname "$0")/common_funcs.sh"
+
+reset_teststate
+mkdir a b c
+head -c 300000 /dev/urandom >a/file
+# the same contents, with a few bytes inserted near the start
+{
+  head -c 1000 a/file
+  echo "inserted"
+  tail -c +1001 a/file
+} >b/inserted
+# the same contents, with a whole block inserted
+{
+  head -c 8192 a/file
+  head -c 4096 /dev/urandom
+  tail -c +8193 a/file
+} >b/block
+head -c 300000 /dev/urandom >c/other
+
+$rdfind -chunkreport report.txt a b c >rdfind.out
+# the chunks b/inserted and b/block have in common are credited to a/file
+verify grep -q "Wrote 2 pairs of files with chunks in common" rdfind.out
+verify [ ! -e results.txt ]
+# most of the contents are found in common
+shared=$(grep "	a/file	.*	b/inserted$" report.txt | cut -f1)
+verify [ "$shared" -gt 250000 ]
+verify grep -q "	a/file	.*	b/block$" report.txt
+if grep -q "c/other" report.txt; then
+  dbgecho "unrelated files were found to have chunks in common"
+  exit 1
+fi
+
+# a smaller chunk size finds more in common
+$rdfind -chunkreport report.txt -chunksize 1024 a b c >rdfind.out
+verify [ "$(grep "	b/inserted$" report.txt | cut -f1)" -gt "$shared" ]
+
+# only the parts in the same place within a block can share extents
+$rdfind -chunkreport report.txt -dedupextents true -dryrun true \
+  a b c >rdfind.out
+verify grep -q "(DRYRUN MODE) share [0-9]* bytes of b/block with a/file" \
+  rdfind.out
+cp b/block block.before
+$rdfind -chunkreport report.txt -dedupextents true a b c >rdfind.out
+verify grep -q "Shared all extents of" rdfind.out
+verify cmp b/block block.before
+rm block.before
+
+# the chunks are credited to the better ranked file, also when it was
+# created last
+reset_teststate
+mkdir a b
+head -c 300000 /dev/urandom >b/inserted
+{
+  head -c 1000 b/inserted
+  tail -c +1009 b/inserted
+} >a/file
+$rdfind -chunkreport report.txt a b >rdfind.out
+verify grep -q "	a/file	.*	b/inserted$" report.txt
+
+# options which do not fit
+for bad in "-chunksize 1000" "-chunksize 32" "-deleteduplicates true" \
+  "-dirduplicates true"; do
+  # shellcheck disable=SC2086
+  if $rdfind -chunkreport report.txt $bad a >rdfind.out 2>&1; then
+    dbgecho "-chunkreport was accepted with $bad"
+    exit 1
+  fi
+done
+if $rdfind -chunksize 1024 a >rdfind.out 2>&1; then
+  dbgecho "-chunksize was accepted without -chunkreport"
+  exit 1
+fi
+
+dbgecho "all is good in this test!"
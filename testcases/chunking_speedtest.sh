@@ -0,0 +1,30 @@
+#!/bin/sh
+# Performance test for -chunkreport. Not meant to be run for regular
+# testing. The files are read from the page cache, so the throughput is
+# the one of cutting and hashing the chunks. Set SIZE to change the size
+# of the files, in MiB.
+
+set -e
+. "$(dirname "$0")/common_funcs.sh"
+
+size=${SIZE:-512}
+
+reset_teststate
+mkdir speedtest
+head -c $((size << 20)) /dev/urandom >speedtest/largefile1
+{
+  echo "something inserted"
+  cat speedtest/largefile1
+} >speedtest/largefile2
+#warm up the cache
+cat speedtest/largefile1 speedtest/largefile2 >/dev/null
+
+for chunksize in 2048 8192 65536; do
+  start=$(date +%s%N)
+  $rdfind -chunkreport report.txt -chunksize $chunksize speedtest >rdfind.out
+  stop=$(date +%s%N)
+  ms=$(((stop - start) / 1000000 + 1))
+  dbgecho "chunks of $chunksize bytes: $ms ms, $((2 * size * 1000 / ms)) MiB/s"
+done
+
+dbgecho "all is good in this test!"
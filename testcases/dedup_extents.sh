@@ -0,0 +1,45 @@
+#!/bin/sh
+# Ensures -dedupextents leaves the files as they are, and tells in the
+# results file which could not share their extents. Most file systems do not
+# support sharing extents, then all duplicates are reported.
+#
+
+set -e
+. "$(dirname "$0")/common_funcs.sh"
+
+reset_teststate
+mkdir d
+head -c 100000 /dev/urandom >d/a
+cp d/a d/b
+cp d/a d/c
+echo "something else" >d/other
+
+$rdfind -dedupextents true d >rdfind.out
+verify grep -q "Shared all extents of" rdfind.out
+for f in b c; do
+  verify cmp d/a d/$f
+  verify [ "$(stat -c %h d/$f)" -eq 1 ]
+done
+if grep -q "Shared all extents of 2 files" rdfind.out; then
+  dbgecho "the file system shares extents"
+  verify [ "$(grep -c "^# .*shared" results.txt)" -eq 0 ]
+else
+  dbgecho "the file system does not share extents"
+  verify [ "$(grep -c "^# not shared" results.txt)" -eq 2 ]
+fi
+# the comments do not disturb reading the results file
+$rdfind -apply results.txt -dedupextents true >rdfind.out
+verify grep -q "Shared all extents of" rdfind.out
+
+# dryrun
+$rdfind -dryrun true -dedupextents true d >rdfind.out
+verify grep -q "(DRYRUN MODE) share extents of d/b with d/a" rdfind.out
+verify grep -q "(DRYRUN MODE) Shared all extents of 2 files" rdfind.out
+
+# it is an action of its own
+if $rdfind -dedupextents true -makehardlinks true d >rdfind.out 2>&1; then
+  dbgecho "combining -dedupextents with another action should fail"
+  exit 1
+fi
+
+dbgecho "all is good in this test!"
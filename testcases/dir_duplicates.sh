@@ -0,0 +1,105 @@
+#!/bin/sh
+# Ensures whole directories are found to be duplicates with -dirduplicates,
+# only if they have nothing but duplicates in them, and that they are
+# deleted or replaced with symlinks as a whole.
+#
+
+set -e
+. "$(dirname "$0")/common_funcs.sh"
+
+reset_teststate
+
+makefiles() {
+  for dir in a b; do
+    mkdir -p $dir/tree/sub $dir/tree/empty
+    echo "content 1" >$dir/tree/file1
+    echo "content 2" >$dir/tree/sub/file2
+    echo "content 3" >$dir/top
+  done
+  # the same tree deeper down
+  mkdir -p c/deeper/tree/sub c/deeper/tree/empty
+  echo "content 1" >c/deeper/tree/file1
+  echo "content 2" >c/deeper/tree/sub/file2
+  # the same files, but also a file without duplicates
+  mkdir -p d/tree/sub d/tree/empty
+  echo "content 1" >d/tree/file1
+  echo "content 2" >d/tree/sub/file2
+  echo "unique" >d/tree/sub/unique
+  # the same files, but also a symlink
+  mkdir -p e/tree/sub e/tree/empty
+  echo "content 1" >e/tree/file1
+  echo "content 2" >e/tree/sub/file2
+  ln -s file2 e/tree/sub/link
+}
+
+# b and c/deeper/tree are duplicates, b/tree goes with b
+reset_teststate
+makefiles
+$rdfind -dirduplicates true a b c d e >rdfind.out
+verify grep -q "found 2 with 5 files" rdfind.out
+verify [ "$(grep -c '/$' results.txt)" -eq 4 ]
+verify grep -q "^DUPTYPE_FIRST_OCCURRENCE [0-9]* 0 .* a/$" results.txt
+verify grep -q "^DUPTYPE_OUTSIDE_TREE -[0-9]* 0 .* b/$" results.txt
+verify grep -q "^DUPTYPE_FIRST_OCCURRENCE [0-9]* 1 .* a/tree/$" results.txt
+verify grep -q "^DUPTYPE_OUTSIDE_TREE -[0-9]* 2 .* c/deeper/tree/$" results.txt
+# the files within them are not reported one by one
+if grep -v '/$' results.txt | grep -q " b/\| c/"; then
+  dbgecho "files within duplicate directories were reported"
+  exit 1
+fi
+verify grep -q " d/tree/file1$" results.txt
+verify grep -q " e/tree/sub/file2$" results.txt
+
+# without the option, all files are reported
+$rdfind a b c d e >rdfind.out
+verify [ "$(grep -c '/$' results.txt)" -eq 0 ]
+verify grep -q " b/tree/sub/file2$" results.txt
+
+# a dryrun changes nothing
+$rdfind -dirduplicates true -deleteduplicates true -dryrun true \
+  a b c d e >rdfind.out
+verify grep -q "delete directory b$" rdfind.out
+verify grep -q "delete directory c/deeper/tree$" rdfind.out
+verify [ -f b/tree/sub/file2 ]
+
+reset_teststate
+makefiles
+$rdfind -dirduplicates true -deleteduplicates true a b c d e >rdfind.out
+verify grep -q "Deleted 2 directories." rdfind.out
+verify [ ! -e b ]
+verify [ ! -e c/deeper/tree ]
+verify [ -d c/deeper ]
+verify [ -d a/tree/empty ]
+verify [ -f a/tree/sub/file2 ]
+verify [ -f a/top ]
+# the files of the other directories are acted on one by one
+verify [ ! -e d/tree/file1 ]
+verify [ -f d/tree/sub/unique ]
+
+reset_teststate
+makefiles
+$rdfind -dirduplicates true -makesymlinks true a b c d e >rdfind.out
+verify grep -q "Replaced 2 directories." rdfind.out
+verify [ "$(readlink b)" = "$(pwd)/a" ]
+verify [ "$(readlink c/deeper/tree)" = "$(pwd)/a/tree" ]
+verify [ -f b/tree/sub/file2 ]
+verify [ ! -L a/tree/sub/file2 ]
+verify [ "$(readlink d/tree/file1)" = "$(pwd)/a/tree/file1" ]
+
+# the directories in a results file are skipped by -apply
+reset_teststate
+makefiles
+$rdfind -dirduplicates true a b c d e >rdfind.out
+$rdfind -apply results.txt -deleteduplicates true -applyverify true \
+  >rdfind.out
+verify grep -q "Skipping the set of directory a/," rdfind.out
+verify [ -d b ]
+verify [ ! -e d/tree/file1 ]
+
+# actions which can not be taken on directories are refused
+if $rdfind -dirduplicates true -makehardlinks true a b >rdfind.out 2>&1; then
+  dbgecho "-dirduplicates was combined with -makehardlinks"
+  exit 1
+fi
+
+dbgecho "all is good in this test!"
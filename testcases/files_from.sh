@@ -0,0 +1,54 @@
+#!/bin/sh
+# Ensures the files can be read from a list instead of traversing
+# directories, with the ranking given by the groups of the list.
+#
+
+set -e
+. "$(dirname "$0")/common_funcs.sh"
+
+reset_teststate
+
+mkdir -p a b c
+echo "duplicate" >a/file
+echo "duplicate" >b/file
+echo "duplicate" >c/file
+echo "not in the list" >c/other
+echo "not in the list" >c/other2
+
+# newline separated, the first file ranks highest
+printf 'b/file\na/file\n' >list.txt
+$rdfind -filesfrom list.txt >rdfind.out
+verify grep -q "Now reading file list" rdfind.out
+verify [ "$(grep -vc '^#' results.txt)" -eq 2 ]
+verify grep -q "^DUPTYPE_FIRST_OCCURRENCE .* a/file$" results.txt
+
+# NUL separated from standard input, groups decide the ranking
+printf '2\ta/file\0001\tb/file\0' | $rdfind -filesfrom - \
+  -filesfromformat groups >rdfind.out
+verify grep -q "^DUPTYPE_FIRST_OCCURRENCE .* b/file$" results.txt
+verify grep -q "^DUPTYPE_OUTSIDE_TREE .* a/file$" results.txt
+
+# files given as arguments rank after the list
+printf 'c/file\n' >list.txt
+$rdfind -filesfrom list.txt a >rdfind.out
+verify grep -q "^DUPTYPE_FIRST_OCCURRENCE .* c/file$" results.txt
+verify grep -q "^DUPTYPE_OUTSIDE_TREE .* a/file$" results.txt
+
+# with the size, device and inode in the list, the files are not looked up.
+# different inodes of the same size make the files candidates.
+printf '1\t10\t1\t1\ta/file\n1\t10\t1\t2\tb/file\n' >list.txt
+$rdfind -filesfrom list.txt -filesfromformat stat >rdfind.out
+verify [ "$(grep -vc '^#' results.txt)" -eq 2 ]
+# the same inode is only looked at once
+printf '1\t10\t1\t1\ta/file\n1\t10\t1\t1\tb/file\n' >list.txt
+$rdfind -filesfrom list.txt -filesfromformat stat >rdfind.out
+verify grep -q "Removed 1 files due to nonunique device and inode" rdfind.out
+
+# bad records are rejected
+printf 'x\ta/file\n' >list.txt
+if $rdfind -filesfrom list.txt -filesfromformat groups >rdfind.out 2>&1; then
+  dbgecho "a bad group should be rejected"
+  exit 1
+fi
+
+dbgecho "all is good in this test!"
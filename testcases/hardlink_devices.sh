@@ -0,0 +1,65 @@
+#!/bin/sh
+# Ensures hard links are made within each device, when the duplicates are on
+# several devices.
+#
+
+set -e
+. "$(dirname "$0")/common_funcs.sh"
+
+# a directory on another device than the temp dir, tmpfs is used if present
+otherdir=
+if [ -d /dev/shm ] && [ -w /dev/shm ]; then
+  otherdir=$(mktemp -d /dev/shm/rdfindtestcases.XXXXXXXXXXXX)
+fi
+if [ -z "$otherdir" ] ||
+  [ "$(stat -c %d "$otherdir")" = "$(stat -c %d "$datadir")" ]; then
+  echo "$me: could not find a writable directory on another device"
+  echo "$me: falsely exiting with success now"
+  [ -z "$otherdir" ] || rm -rf "$otherdir"
+  exit 0
+fi
+cleanup_otherdir() {
+  rm -rf "$otherdir"
+  cleanup
+}
+trap cleanup_otherdir INT QUIT EXIT
+
+reset_teststate
+mkdir here
+for f in a b c; do
+  echo "same on both devices" >here/$f
+  echo "same on both devices" >"$otherdir/$f"
+done
+
+$rdfind -makehardlinks true here "$otherdir" 2>&1 | tee rdfind.out
+if grep -iq "failed" rdfind.out; then
+  dbgecho "no link should have been tried across devices"
+  exit 1
+fi
+verify grep -q "Making 4 links." rdfind.out
+verify [ "$(grep -c DUPTYPE_FIRST_OCCURRENCE results.txt)" -eq 2 ]
+for f in a b c; do
+  verify [ "$(stat -c %h here/$f)" -eq 3 ]
+  verify [ "$(stat -c %h "$otherdir/$f")" -eq 3 ]
+done
+
+# without hard links, there is one original for all devices
+reset_teststate
+mkdir here
+echo "same on both devices" >here/a
+$rdfind here "$otherdir"
+verify [ "$(grep -c DUPTYPE_FIRST_OCCURRENCE results.txt)" -eq 1 ]
+
+# with hard links, a file alone on its device is left out, and told about.
+# the files on the other device are linked already.
+$rdfind -makehardlinks true -dryrun true -removeidentinode false here \
+  "$otherdir" >rdfind.out
+verify grep -q "Removed 1 files without a duplicate on their own device" \
+  rdfind.out
+verify [ "$(grep -c DUPTYPE_FIRST_OCCURRENCE results.txt)" -eq 1 ]
+if grep -q "here/a$" results.txt; then
+  dbgecho "the file alone on its device should be left out"
+  exit 1
+fi
+
+dbgecho "all is good in this test!"
@@ -29,6 +29,22 @@ for n in $files; do
 done
 dbgecho passed the happy path
 
+# linking a file to itself must not leave any temporary behind
+reset_teststate
+echo "hello hardlink" >"$datadir/a"
+ln "$datadir/a" "$datadir/b"
+echo "hello hardlink" >"$datadir/c"
+$rdfind -removeidentinode false -makehardlinks true "$datadir/"
+if [ "$(find "$datadir" -type f ! -name results.txt | wc -l)" -ne 3 ]; then
+  dbgecho "expected no other files than a, b and c"
+  exit 1
+fi
+if [ "$(stat -c %h "$datadir/c")" -ne 3 ]; then
+  dbgecho "expected c to be linked to a"
+  exit 1
+fi
+dbgecho passed linking to the same file
+
 # try to make a hardlink to somewhere that fails.
 
 reset_teststate
@@ -0,0 +1,84 @@
+#!/bin/sh
+# Ensures duplicates spread over several nodes are found by merging
+# manifests, with the same result as scanning everything at once.
+#
+
+set -e
+. "$(dirname "$0")/common_funcs.sh"
+
+reset_teststate
+
+mkdir -p n1/sd n2
+echo "on both nodes" >n1/a
+echo "on both nodes" >n2/a2
+echo "twice on node 1" >n1/b
+echo "twice on node 1" >n1/sd/c
+echo "unique size on node 2" >n2/d
+echo "same size, node 1" >n1/e
+echo "same size, node 2" >n2/f
+
+$rdfind -exportsizes n1.sizes n1 >rdfind.out
+$rdfind -exportsizes n2.sizes n2 >rdfind.out
+verify [ ! -e results.txt ]
+
+$rdfind -exportmanifest n1.mf -nodename node1 -collidingsizes n1.sizes \
+  -collidingsizes n2.sizes n1 >rdfind.out
+verify grep -q "Removed 0 files due to sizes unique among all nodes" rdfind.out
+$rdfind -exportmanifest n2.mf -nodename node2 -collidingsizes n1.sizes \
+  -collidingsizes n2.sizes n2 >rdfind.out
+verify grep -q "Removed 1 files due to sizes unique among all nodes" rdfind.out
+
+$rdfind -mergemanifests true -outputname merged.txt n1.mf n2.mf >rdfind.out
+verify grep -q "Read 6 files from 2 manifests" rdfind.out
+
+# the same duplicates as when scanning both at once
+$rdfind -outputname local.txt n1 n2 >rdfind.out
+verify [ "$(grep -vc '^#' merged.txt)" -eq "$(grep -vc '^#' local.txt)" ]
+verify grep -q "^DUPTYPE_FIRST_OCCURRENCE .* node1:n1/a$" merged.txt
+verify grep -q "^DUPTYPE_OUTSIDE_TREE .* node2:n2/a2$" merged.txt
+
+# each node gets its part, with its own names
+verify grep -q "^DUPTYPE_FIRST_OCCURRENCE .* n1/a$" merged.txt.node1
+verify grep -q "^DUPTYPE_FIRST_OCCURRENCE .* n1/b$" merged.txt.node1
+verify grep -q "^DUPTYPE_WITHIN_SAME_TREE .* n1/sd/c$" merged.txt.node1
+verify grep -q "^DUPTYPE_REMOTE_ORIGINAL .* node1:n1/a$" merged.txt.node2
+verify grep -q "^DUPTYPE_OUTSIDE_TREE .* n2/a2$" merged.txt.node2
+if grep -q "n1/b" merged.txt.node2; then
+  dbgecho "node 2 should not get the duplicates of node 1"
+  exit 1
+fi
+
+# the duplicates of an original on another node can only be deleted
+$rdfind -apply merged.txt.node2 -makehardlinks true -applyverify true \
+  >rdfind.out
+verify grep -q "Skipping the set of node1:n1/a" rdfind.out
+verify [ -e n2/a2 ]
+$rdfind -apply merged.txt.node2 -deleteduplicates true -applyverify true \
+  >rdfind.out
+verify grep -q "Skipping n2/a2, it can not be compared to node1:n1/a" rdfind.out
+verify [ -e n2/a2 ]
+# the text format can not tell if they changed since
+if $rdfind -apply merged.txt.node2 -deleteduplicates true \
+  >rdfind.out 2>&1; then
+  dbgecho "deleting without -applyverify should be refused"
+  exit 1
+fi
+verify [ -e n2/a2 ]
+$rdfind -apply merged.txt.node2 -deleteduplicates true -dryrun true \
+  >rdfind.out
+verify grep -q "(DRYRUN MODE) delete n2/a2" rdfind.out
+
+# manifests made with different options can not be merged
+$rdfind -exportmanifest n2md5.mf -nodename node2 -checksum md5 n2 >rdfind.out
+if $rdfind -mergemanifests true n1.mf n2md5.mf >rdfind.out 2>&1; then
+  dbgecho "merging manifests with different checksums should fail"
+  exit 1
+fi
+
+# node names must be unique
+if $rdfind -mergemanifests true n1.mf n1.mf >rdfind.out 2>&1; then
+  dbgecho "merging manifests with the same node name should fail"
+  exit 1
+fi
+
+dbgecho "all is good in this test!"
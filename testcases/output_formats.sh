@@ -0,0 +1,69 @@
+#!/bin/sh
+# Ensures the results file can be written in all output formats, with the
+# same content.
+#
+
+set -e
+. "$(dirname "$0")/common_funcs.sh"
+
+reset_teststate
+
+mkdir -p a b
+for size in 1 10 100 1000 10000 100000; do
+  head -c $size /dev/zero >a/zero$size
+  head -c $size /dev/zero >b/zero$size
+  head -c $size /dev/zero | tr '\0' 'x' >a/x$size
+  head -c $size /dev/zero | tr '\0' 'x' >"b/with space$size"
+done
+echo "unique" >a/unique
+
+$rdfind -outputformat text -outputname plain.txt a b >rdfind.out
+grep -v '^#' plain.txt >records.txt
+
+# the same records, NUL terminated
+$rdfind -outputformat nul -outputname results.nul a b >rdfind.out
+tr '\0' '\n' <results.nul >nul.txt
+verify cmp records.txt nul.txt
+
+# one JSON object per line, with the sha1 checksum as digest
+$rdfind -outputformat jsonl -outputname results.jsonl a b >rdfind.out
+verify [ "$(wc -l <results.jsonl)" -eq "$(wc -l <records.txt)" ]
+digest=$(sha1sum a/x1000 | cut -c1-40)
+verify grep -q "\"name\":\"a/x1000\",\"digest\":\"$digest\"" results.jsonl
+verify grep -q '"name":"b/with space1000"' results.jsonl
+
+# the binary format is read back by -mergeresults
+$rdfind -outputformat binary -outputname results.bin a b >rdfind.out
+verify [ "$(head -c 8 results.bin)" = "RDFINDRB" ]
+$rdfind -mergeresults true -outputname merged.txt results.bin >rdfind.out
+verify cmp plain.txt merged.txt
+
+# names which would break the lines of the text format
+mkdir c
+echo "same" >"c/new
+line"
+echo "same" >'c/quote"backslash\'
+$rdfind -outputformat nul -outputname results.nul c >rdfind.out
+verify [ "$(tr -cd '\0' <results.nul | wc -c)" -eq 2 ]
+$rdfind -outputformat jsonl -outputname results.jsonl c >rdfind.out
+verify [ "$(wc -l <results.jsonl)" -eq 2 ]
+verify grep -q '"name":"c/new\\u000aline"' results.jsonl
+verify grep -q '"name":"c/quote\\"backslash\\\\"' results.jsonl
+
+# offsets which wrap around when added to are found to be damaged
+cp results.bin damaged.bin
+printf '\300\377\377\377\377\377\377\377' |
+  dd of=damaged.bin bs=1 seek=24 conv=notrunc status=none
+if $rdfind -mergeresults true -outputname merged.txt damaged.bin \
+  >rdfind.out 2>&1; then
+  dbgecho "a damaged binary results file should be rejected"
+  exit 1
+fi
+verify grep -q "is not in the binary format or is damaged" rdfind.out
+
+if $rdfind -outputformat binary -streamresults true a >rdfind.out 2>&1; then
+  dbgecho "the binary format should not be streamed"
+  exit 1
+fi
+
+dbgecho "all is good in this test!"
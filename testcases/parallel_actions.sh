@@ -0,0 +1,51 @@
+#!/bin/sh
+# Ensures the actions give the same result when several threads take care of
+# different directories.
+#
+
+set -e
+. "$(dirname "$0")/common_funcs.sh"
+
+reset_teststate
+
+makefiles() {
+  for dir in a b c d e; do
+    mkdir -p $dir/sub
+    for n in 1 2 3; do
+      echo "content $n" >$dir/file$n
+      echo "content $n" >$dir/sub/file$n
+    done
+  done
+  echo "content 1" >bare
+}
+
+for threads in 1 4; do
+  reset_teststate
+  makefiles
+  $rdfind -threads $threads -makehardlinks true bare a b c d e >rdfind.out
+  verify grep -q "Making 28 links." rdfind.out
+  for dir in a b c d e; do
+    verify [ "$(stat -c %i bare)" = "$(stat -c %i $dir/sub/file1)" ]
+    verify [ "$(stat -c %i a/file2)" = "$(stat -c %i $dir/sub/file2)" ]
+  done
+
+  reset_teststate
+  makefiles
+  $rdfind -threads $threads -makesymlinks true bare a b c d e >rdfind.out
+  verify grep -q "Making 28 links." rdfind.out
+  verify [ "$(readlink e/sub/file1)" = "$(pwd)/bare" ]
+  verify [ "$(readlink e/sub/file3)" = "$(pwd)/a/file3" ]
+  verify [ -f bare ]
+  verify [ ! -L bare ]
+
+  reset_teststate
+  makefiles
+  $rdfind -threads $threads -deleteduplicates true bare a b c d e >rdfind.out
+  verify grep -q "Deleted 28 files." rdfind.out
+  verify [ "$(find . -name 'file*' | wc -l)" -eq 2 ]
+  verify [ -f bare ]
+  verify [ -f a/file2 ]
+  verify [ -f a/file3 ]
+done
+
+dbgecho "all is good in this test!"
@@ -0,0 +1,51 @@
+#!/bin/sh
+# Ensures -exclude and -include skip files and whole directories.
+#
+
+set -e
+. "$(dirname "$0")/common_funcs.sh"
+
+reset_teststate
+
+mkdir -p tree/.git/objects tree/node_modules/pkg tree/src tree/build/tmp
+for f in tree/.git/objects/x tree/node_modules/pkg/x tree/src/x tree/src/x.c \
+  tree/build/tmp/x tree/a.jpg tree/b.jpg; do
+  echo "same content" >"$f"
+done
+
+$rdfind tree >rdfind.out
+verify [ "$(grep -vc '^#' results.txt)" -eq 7 ]
+
+# directories are skipped by name, anywhere in the tree
+$rdfind -exclude .git -exclude node_modules tree >rdfind.out
+verify [ "$(grep -vc '^#' results.txt)" -eq 5 ]
+verify [ "$(grep -c '\.git\|node_modules' results.txt)" -eq 0 ]
+
+# a glob with a slash matches the path
+$rdfind -exclude 'tree/build/*' -exclude '*.c' tree >rdfind.out
+verify [ "$(grep -vc '^#' results.txt)" -eq 5 ]
+verify [ "$(grep -c 'build\|x\.c' results.txt)" -eq 0 ]
+
+# only included files are kept, but all directories are entered
+$rdfind -include '*.jpg' -include 'x.?' tree >rdfind.out
+verify [ "$(grep -vc '^#' results.txt)" -eq 3 ]
+
+# regular expressions match the path
+$rdfind -excluderegex '/(\.git|build)$' -includeregex '/x$' tree >rdfind.out
+verify [ "$(grep -vc '^#' results.txt)" -eq 2 ]
+
+# the cached listing does not depend on the patterns
+$rdfind -dircache cache -exclude .git tree >rdfind.out
+verify [ "$(grep -vc '^#' results.txt)" -eq 6 ]
+$rdfind -dircache cache tree >rdfind.out
+verify [ "$(grep -vc '^#' results.txt)" -eq 7 ]
+$rdfind -dircache cache -exclude .git -exclude src tree >rdfind.out
+verify [ "$(grep -vc '^#' results.txt)" -eq 4 ]
+
+# bad regular expressions are rejected
+if $rdfind -excluderegex '(' tree >rdfind.out 2>&1; then
+  dbgecho "a bad regular expression should be rejected"
+  exit 1
+fi
+
+dbgecho "all is good in this test!"
@@ -0,0 +1,53 @@
+#!/bin/sh
+# Ensures letting each group go through the stages on its own, with several
+# threads, finds the same duplicates as going through stage by stage.
+#
+
+set -e
+. "$(dirname "$0")/common_funcs.sh"
+
+reset_teststate
+
+mkdir -p a b c
+for size in 1 10 100 1000 10000 100000; do
+  head -c $size /dev/zero >a/zero$size
+  head -c $size /dev/zero >b/zero$size
+  head -c $size /dev/zero >c/zero$size
+  head -c $size /dev/zero | tr '\0' 'x' >a/x$size
+  head -c $size /dev/zero | tr '\0' 'x' >c/x$size
+  head -c $size /dev/zero | tr '\0' 'y' >b/y$size
+done
+# same first and last bytes, different in the middle
+head -c 20000 /dev/zero >a/middle
+head -c 20000 /dev/zero | tr '\0' 'm' | dd of=a/middle bs=1 seek=9000 \
+  count=10 conv=notrunc 2>/dev/null
+head -c 20000 /dev/zero >c/middle
+
+# the order within a set of duplicates is not defined, beyond the original
+# being first
+same_results() {
+  verify [ "$(grep FIRST "$1")" = "$(grep FIRST "$2")" ]
+  grep -v '^#' "$1" | sort >"$1.sorted"
+  grep -v '^#' "$2" | sort >"$2.sorted"
+  verify cmp "$1.sorted" "$2.sorted"
+}
+
+$rdfind -threads 1 -outputname staged.txt a b c >rdfind.out
+for threads in 2 4; do
+  $rdfind -threads $threads -outputname pipelined.txt a b c >rdfind.out
+  verify grep -q "with $threads threads" rdfind.out
+  same_results staged.txt pipelined.txt
+done
+
+# the same, when some stages are skipped
+$rdfind -threads 1 -firstbytessize 0 -outputname staged.txt a b c >rdfind.out
+$rdfind -threads 3 -firstbytessize 0 -outputname pipelined.txt a b c \
+  >rdfind.out
+same_results staged.txt pipelined.txt
+
+if $rdfind -threads 0 a >rdfind.out 2>&1; then
+  dbgecho "zero threads should be rejected"
+  exit 1
+fi
+
+dbgecho "all is good in this test!"
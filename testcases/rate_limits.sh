@@ -0,0 +1,60 @@
+#!/bin/sh
+# Ensures -maxreadrate and -maxopenrate slow down reading to the rate given,
+# and that -ioclass is accepted.
+#
+
+set -e
+. "$(dirname "$0")/common_funcs.sh"
+
+# milliseconds since the epoch
+now() {
+  echo $(($(date +%s%N) / 1000000))
+}
+
+reset_teststate
+mkdir big small
+head -c 3000000 /dev/urandom >big/a
+cp big/a big/b
+i=0
+while [ $i -lt 40 ]; do
+  # the same size, but different first bytes
+  printf "%04d" $i >small/$i
+  i=$((i + 1))
+done
+
+# one second worth is read at once, the other four megabytes take two
+start=$(now)
+$rdfind -maxreadrate 2000000 big >rdfind.out
+elapsed=$(($(now) - start))
+dbgecho "reading took $elapsed ms"
+verify grep -q "It seems like you have 2 files that are not unique" rdfind.out
+verify [ "$elapsed" -ge 1500 ]
+
+# comparing the contents with -apply is limited the same way
+start=$(now)
+$rdfind -apply results.txt -applyverify true -makehardlinks true \
+  -dryrun true -maxreadrate 2000000 >rdfind.out
+elapsed=$(($(now) - start))
+dbgecho "comparing took $elapsed ms"
+verify grep -q "0 files with other contents" rdfind.out
+verify [ "$elapsed" -ge 1500 ]
+
+# twenty files are opened at once, the other twenty take a second
+start=$(now)
+$rdfind -maxopenrate 20 small >rdfind.out
+elapsed=$(($(now) - start))
+dbgecho "opening took $elapsed ms"
+verify [ "$elapsed" -ge 800 ]
+
+if $rdfind -ioclass idle big >rdfind.out 2>&1; then
+  verify grep -q "It seems like you have 2 files that are not unique" \
+    rdfind.out
+else
+  dbgecho "the I/O scheduling class could not be set here"
+fi
+if $rdfind -ioclass bogus big >rdfind.out 2>&1; then
+  dbgecho "-ioclass accepted a bad class"
+  exit 1
+fi
+
+dbgecho "all is good in this test!"
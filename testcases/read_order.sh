@@ -0,0 +1,31 @@
+#!/bin/sh
+# Ensures the order the files are read in does not change the results.
+#
+
+set -e
+. "$(dirname "$0")/common_funcs.sh"
+
+reset_teststate
+mkdir d
+for i in 1 2 3 4 5 6; do
+  head -c 10000 /dev/urandom >d/unique$i
+  echo "duplicate $i" >d/a$i
+  cp d/a$i d/b$i
+  # same first bytes, different last bytes
+  { cat d/unique1; echo "$i"; } >d/tail$i
+done
+sync
+
+$rdfind -readorder inode d >rdfind.out
+grep -v "^#" results.txt | sort >expected.txt
+
+$rdfind -readorder physical d >rdfind.out
+grep -v "^#" results.txt | sort >actual.txt
+verify cmp expected.txt actual.txt
+
+if $rdfind -readorder random d >rdfind.out 2>&1; then
+  dbgecho "an unknown read order should be refused"
+  exit 1
+fi
+
+dbgecho "all is good in this test!"
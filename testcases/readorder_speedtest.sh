@@ -0,0 +1,70 @@
+#!/bin/sh
+# Performance test for -readorder. Not meant to be run for regular testing.
+# Needs root, to mount an image on a loop device and to drop the page
+# cache. Counts the seeks with blktrace if it is installed, otherwise only
+# times the runs. Set MKFS to try another file system, like "mkfs.xfs -q -f".
+
+set -e
+. "$(dirname "$0")/common_funcs.sh"
+
+if [ "$(id -u)" -ne 0 ]; then
+  echo "$me: needs root to mount a loop device, exiting"
+  exit 0
+fi
+mkfs=${MKFS:-mkfs.ext4 -q -F}
+nfiles=${NFILES:-2000}
+
+reset_teststate
+truncate -s 1G image
+$mkfs image
+mkdir mnt
+mount -o loop image mnt
+device=$(findmnt -n -o SOURCE mnt)
+cleanup_mount() {
+  cd "$datadir"
+  umount mnt || true
+  cleanup
+}
+trap cleanup_mount INT QUIT EXIT
+
+# the inodes are made in order, then the contents are written in a random
+# order, so the place on the disk does not follow the inode order. the
+# files start the same, so the last bytes are read too.
+head -c 4096 /dev/urandom >header
+i=0
+while [ $i -lt "$nfiles" ]; do
+  : >mnt/f$i
+  i=$((i + 1))
+done
+seq 0 $((nfiles - 1)) | shuf | while read -r i; do
+  { cat header; head -c 61440 /dev/urandom; } >mnt/f$i
+done
+sync
+
+for order in inode physical; do
+  sync
+  echo 3 >/proc/sys/vm/drop_caches
+  if command -v blktrace >/dev/null; then
+    blktrace -d "$device" -o trace_$order >/dev/null 2>&1 &
+    tracer=$!
+    sleep 1
+  fi
+  start=$(date +%s%N)
+  $rdfind -readorder $order -makeresultsfile false mnt >rdfind.out
+  stop=$(date +%s%N)
+  dbgecho "$order order: $(((stop - start) / 1000000)) ms"
+  if command -v blktrace >/dev/null; then
+    kill -INT $tracer
+    wait $tracer || true
+    # a seek is a read which does not start where the previous one ended
+    seeks=$(blkparse -i trace_$order -f "%a %d %S %n\n" 2>/dev/null |
+      awk '$1 == "D" && $2 ~ /R/ {
+             if (count++ > 0 && $3 != end) seeks++
+             end = $3 + $4
+           }
+           END { print seeks + 0 }')
+    dbgecho "$order order: $seeks seeks"
+  fi
+done
+
+dbgecho "all is good in this test!"
@@ -0,0 +1,84 @@
+#!/bin/sh
+# Ensures new files can be checked against an index of a reference corpus,
+# with the reference ranked first and never acted upon.
+#
+
+set -e
+. "$(dirname "$0")/common_funcs.sh"
+
+reset_teststate
+
+mkdir -p ref/sd new
+echo "in reference and new" >ref/a
+echo "in reference twice" >ref/b
+echo "in reference twice" >ref/sd/b
+echo "only in reference" >ref/c
+echo "in reference and new" >new/a1
+echo "in reference and new" >new/a2
+echo "twice, only in new" >new/d1
+echo "twice, only in new" >new/d2
+echo "unique, only in new" >new/e
+
+$rdfind -buildindex index.bin ref >rdfind.out
+verify grep -q "Wrote index of 4 files to index.bin" rdfind.out
+verify [ ! -e results.txt ]
+
+$rdfind -referenceindex index.bin new >rdfind.out
+# ref/c has no file of the same size among the new files
+verify grep -q "Added 3 files of the same size from reference index" rdfind.out
+# the reference file is the original
+verify grep -q "^DUPTYPE_FIRST_OCCURRENCE .* ref/a$" results.txt
+verify grep -q "^DUPTYPE_OUTSIDE_TREE .* new/a1$" results.txt
+verify grep -q "^DUPTYPE_OUTSIDE_TREE .* new/a2$" results.txt
+verify grep -q "^DUPTYPE_FIRST_OCCURRENCE .* new/d1$" results.txt
+verify grep -q "^DUPTYPE_WITHIN_SAME_TREE .* new/d2$" results.txt
+# duplicates within the reference are not of interest
+if grep -q "ref/b" results.txt; then
+  dbgecho "duplicates within the reference should not be reported"
+  exit 1
+fi
+
+# the reference files are not read when the index has their checksums,
+# which is seen by changing one without changing its size.
+echo "in reference and nex" >ref/a
+$rdfind -referenceindex index.bin -outputname stale.txt new >rdfind.out
+verify grep -q " ref/a$" stale.txt
+
+# with another checksum, the reference files have to be read.
+$rdfind -referenceindex index.bin -checksum md5 -outputname md5.txt new \
+  >rdfind.out
+if grep -q " ref/a$" md5.txt; then
+  dbgecho "the changed reference file should have been read"
+  exit 1
+fi
+echo "in reference and new" >ref/a
+
+# only the new files are acted upon
+$rdfind -referenceindex index.bin -deleteduplicates true new >rdfind.out
+verify [ -e ref/a ]
+verify [ -e ref/b ]
+verify [ -e ref/sd/b ]
+verify [ ! -e new/a1 ]
+verify [ ! -e new/a2 ]
+verify [ -e new/d1 ]
+verify [ ! -e new/d2 ]
+verify [ -e new/e ]
+
+# an index with a name outside of it is rejected. the name offset of the
+# first entry is after the header of 128 bytes and 32 bytes into the entry.
+$rdfind -buildindex damaged.bin ref >rdfind.out
+printf '\377\377\377\377' |
+  dd of=damaged.bin bs=1 seek=160 conv=notrunc status=none
+if $rdfind -referenceindex damaged.bin new >rdfind.out 2>&1; then
+  dbgecho "a damaged index should be rejected"
+  exit 1
+fi
+verify grep -q "is damaged" rdfind.out
+
+# building an index does not look for duplicates
+if $rdfind -buildindex index.bin -deleteduplicates true ref >rdfind.out 2>&1; then
+  dbgecho "-buildindex with an action should fail"
+  exit 1
+fi
+
+dbgecho "all is good in this test!"
@@ -0,0 +1,55 @@
+#!/bin/sh
+# Ensures splitting the work into shards and merging the results gives the
+# same results file as a single run.
+#
+
+set -e
+. "$(dirname "$0")/common_funcs.sh"
+
+reset_teststate
+
+mkdir -p a b/sub
+for size in 1 2 3 5 8 13 21 34 55 89; do
+  head -c $size /dev/zero >a/zero$size
+  head -c $size /dev/zero >b/zero$size
+  head -c $size /dev/zero >b/sub/zero$size
+  head -c $size /dev/zero | tr '\0' 'x' >a/x$size
+  head -c $size /dev/zero | tr '\0' 'x' >b/x$size
+done
+echo "unique" >a/unique
+
+# the priority is the position on the command line, keep it the same as
+# with -shard I/N
+$rdfind -deterministic true -outputname all.txt a b >rdfind.out
+
+for shard in 1 2 3; do
+  $rdfind -shard $shard/3 -outputname shard$shard.txt a b >rdfind.out
+  verify grep -q "files belonging to other shards" rdfind.out
+done
+
+$rdfind -mergeresults true -outputname merged.txt shard1.txt shard2.txt \
+  shard3.txt >rdfind.out
+verify grep -q "Merged 20 groups of 50 files from 3 results files" rdfind.out
+
+# the same originals and duplicates, with the same ids and priorities
+grep -v '^#' all.txt | sort >all.sorted
+grep -v '^#' merged.txt | sort >merged.sorted
+verify cmp all.sorted merged.sorted
+verify [ "$(grep FIRST all.txt)" = "$(grep FIRST merged.txt)" ]
+
+# a shard given twice is noticed
+if $rdfind -mergeresults true -outputname bad.txt shard1.txt shard1.txt \
+  >rdfind.out 2>&1; then
+  dbgecho "merging a shard twice should fail"
+  exit 1
+fi
+
+# bad shard numbers are rejected
+for bad in 0/3 4/3 3 x/y; do
+  if $rdfind -shard $bad a >rdfind.out 2>&1; then
+    dbgecho "-shard $bad should be rejected"
+    exit 1
+  fi
+done
+
+dbgecho "all is good in this test!"
@@ -0,0 +1,38 @@
+#!/bin/sh
+# Ensures sparse files, of which the holes are not read, are compared as if
+# the holes were read as zeros: a sparse file and a copy of it with the
+# zeros written out are duplicates, and a difference within a hole is
+# found.
+#
+
+set -e
+. "$(dirname "$0")/common_funcs.sh"
+
+reset_teststate
+mkdir d
+# 8 MiB with data at the start, in the middle and at the end
+truncate -s 8M d/sparse
+echo "start" | dd of=d/sparse conv=notrunc status=none
+echo "middle" | dd of=d/sparse bs=1M seek=4 conv=notrunc status=none
+echo "end" | dd of=d/sparse bs=1 seek=$((8 * 1048576 - 4)) conv=notrunc \
+  status=none
+cp --sparse=never d/sparse d/dense
+cp --sparse=always d/sparse d/differs
+printf "x" | dd of=d/differs bs=1 seek=2097152 conv=notrunc status=none
+# a file which is one big hole
+truncate -s 8M d/hole
+head -c 8M /dev/zero >d/zeros
+
+# the first and last bytes are the same, so all are checksummed
+for checksumtype in $allchecksumtypes; do
+  $rdfind -checksum "$checksumtype" d >rdfind.out
+  for f in sparse dense hole zeros; do
+    verify grep -q " d/$f$" results.txt
+  done
+  if grep -q " d/differs$" results.txt; then
+    dbgecho "a difference within a hole was not found"
+    exit 1
+  fi
+done
+
+dbgecho "all is good in this test!"
@@ -0,0 +1,60 @@
+#!/bin/sh
+# Ensures writing each set of duplicates as soon as it is confirmed gives the
+# same results as writing them all at the end.
+#
+
+set -e
+. "$(dirname "$0")/common_funcs.sh"
+
+reset_teststate
+
+mkdir -p a b c
+for size in 1 10 100 1000 10000 100000; do
+  head -c $size /dev/zero >a/zero$size
+  head -c $size /dev/zero >b/zero$size
+  head -c $size /dev/zero | tr '\0' 'x' >a/x$size
+  head -c $size /dev/zero | tr '\0' 'x' >c/x$size
+  head -c $size /dev/zero | tr '\0' 'y' >c/y$size
+done
+echo "unique" >a/unique
+
+# the sets come in the order they are confirmed
+same_results() {
+  grep -v '^#' "$1" | sort >"$1.sorted"
+  grep -v '^#' "$2" | sort >"$2.sorted"
+  verify cmp "$1.sorted" "$2.sorted"
+}
+
+$rdfind -streamresults false -threads 1 -outputname plain.txt a b c \
+  >rdfind.out
+for threads in 1 3; do
+  $rdfind -streamresults true -threads $threads -outputname streamed.txt \
+    a b c >rdfind.out
+  verify grep -q "Now streaming results to streamed.txt" rdfind.out
+  same_results plain.txt streamed.txt
+  # each set is ended, and the file is complete
+  verify [ "$(grep -c '^# end of group$' streamed.txt)" -eq \
+    "$(grep -c FIRST plain.txt)" ]
+  verify [ "$(tail -n1 streamed.txt)" = "# end of file" ]
+done
+
+# it can be read from a fifo while rdfind is running
+mkfifo results.fifo
+cat results.fifo >fromfifo.txt &
+reader=$!
+$rdfind -streamresults true -threads 2 -outputname results.fifo a b c \
+  >rdfind.out
+wait $reader
+same_results plain.txt fromfifo.txt
+
+# the action is taken on each set as it is confirmed
+$rdfind -streamresults true -threads 2 -deleteduplicates true a b c \
+  >rdfind.out
+verify grep -q "Took the action on 12 files" rdfind.out
+verify [ -e a/zero1 ]
+verify [ ! -e b/zero1 ]
+verify [ ! -e c/x100000 ]
+$rdfind -outputname after.txt a b c >rdfind.out
+verify [ "$(grep -c -v '^#' after.txt)" -eq 0 ]
+
+dbgecho "all is good in this test!"
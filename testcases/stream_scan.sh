@@ -0,0 +1,38 @@
+#!/bin/sh
+# Ensures reading files while traversing gives the same results as reading
+# them afterwards.
+#
+
+set -e
+. "$(dirname "$0")/common_funcs.sh"
+
+reset_teststate
+
+mkdir -p a b/sub c
+for size in 1 10 100 1000 10000 100000; do
+  head -c $size /dev/zero >a/zero$size
+  head -c $size /dev/zero >b/sub/zero$size
+  head -c $size /dev/zero | tr '\0' 'x' >c/x$size
+  head -c $size /dev/zero | tr '\0' 'y' >c/y$size
+done
+# same first and last bytes, different in the middle
+head -c 20000 /dev/zero >a/middle
+head -c 20000 /dev/zero | tr '\0' 'm' | dd of=a/middle bs=1 seek=9000 \
+  count=10 conv=notrunc 2>/dev/null
+head -c 20000 /dev/zero >c/middle
+echo "unique" >a/unique
+
+$rdfind -streamscan false -outputname plain.txt a b c >rdfind.out
+$rdfind -streamscan true -outputname stream.txt a b c >rdfind.out
+verify grep -q "files while traversing" rdfind.out
+verify [ "$(grep -c 'Read 0 files while traversing' rdfind.out)" -eq 0 ]
+verify cmp plain.txt stream.txt
+
+# with checksum none, the first and last bytes decide
+$rdfind -streamscan false -checksum none -outputname plain.txt a b c \
+  >rdfind.out
+$rdfind -streamscan true -checksum none -outputname stream.txt a b c \
+  >rdfind.out
+verify cmp plain.txt stream.txt
+
+dbgecho "all is good in this test!"
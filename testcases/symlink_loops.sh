@@ -0,0 +1,50 @@
+#!/bin/sh
+# Ensures symlinks pointing back up the tree are followed only once, and
+# that deep trees are traversed completely.
+#
+
+set -e
+. "$(dirname "$0")/common_funcs.sh"
+
+reset_teststate
+
+mkdir -p tree/a/b
+echo "same content" >tree/a/file1
+echo "same content" >tree/a/b/file2
+# loops back to the parents, several times over
+ln -s .. tree/a/b/up
+ln -s ../.. tree/a/b/upup
+ln -s ../a tree/a/again
+
+$rdfind -followsymlinks true -removeidentinode false tree >rdfind.out
+# each file is found once, even with identical inodes kept
+verify [ "$(grep -vc '^#' results.txt)" -eq 2 ]
+
+# a directory reached through symlinks is found under the first name, in
+# name order, whatever order the directory lists them in
+mkdir -p order/m
+echo "in the middle" >order/m/file
+echo "in the middle" >order/copy
+ln -s m order/z
+ln -s m order/a
+$rdfind -followsymlinks true -outputname order.txt order >rdfind.out
+verify grep -q "order/a/file$" order.txt
+if grep -q "order/[mz]/file$" order.txt; then
+  dbgecho "the directory was found under another name"
+  exit 1
+fi
+
+# deeper than the old limit of 50 levels
+deep=deep
+i=0
+while [ $i -lt 80 ]; do
+  deep=$deep/d
+  i=$((i + 1))
+done
+mkdir -p "$deep"
+echo "deep down" >"$deep/file"
+echo "deep down" >deep/file
+$rdfind deep >rdfind.out
+verify [ "$(grep -vc '^#' results.txt)" -eq 2 ]
+
+dbgecho "all is good in this test!"
@@ -0,0 +1,58 @@
+#!/bin/sh
+# Ensures the directory listing cache gives the same result as listing
+# the directories, and that changed directories are listed again.
+#
+
+set -e
+. "$(dirname "$0")/common_funcs.sh"
+
+reset_teststate
+
+mkdir -p tree/sd1/sd2 tree/sd3
+echo content1 >tree/a
+echo content1 >tree/sd1/sd2/b
+echo content2 >tree/sd3/c
+echo content3 >tree/sd1/d
+# listings made the same second as a directory changed are not trusted
+sleep 1
+
+# first run, nothing is cached
+$rdfind -dircache cache.bin -outputname uncached.txt tree >rdfind.out
+verify grep -q "Used cached listings for 0 directories, listed 4" rdfind.out
+verify [ -e cache.bin ]
+
+# second run, everything is cached and the result is the same
+$rdfind -dircache cache.bin -outputname cached.txt tree >rdfind.out
+verify grep -q "Used cached listings for 4 directories, listed 0" rdfind.out
+verify cmp uncached.txt cached.txt
+
+# a new file is picked up, since its directory changed
+echo content2 >tree/sd1/sd2/e
+$rdfind -dircache cache.bin -outputname changed.txt tree >rdfind.out
+verify grep -q "Used cached listings for 3 directories, listed 1" rdfind.out
+verify grep -q "tree/sd1/sd2/e" changed.txt
+
+# a max age of zero lists everything again
+$rdfind -dircache cache.bin -dircachemaxage 0 tree >rdfind.out
+verify grep -q "Used cached listings for 0 directories, listed 4" rdfind.out
+
+# negative max age is misusage
+if $rdfind -dircache cache.bin -dircachemaxage -1 tree >rdfind.out 2>&1; then
+  dbgecho "negative value should have been detected"
+  exit 1
+fi
+
+# a damaged cache is ignored
+echo garbage >cache.bin
+$rdfind -dircache cache.bin -outputname garbage.txt tree >rdfind.out 2>&1
+verify cmp changed.txt garbage.txt
+
+# so is a name longer than the cache. its length is after the header of 20
+# bytes and the 64 bytes of the first listing.
+$rdfind -dircache cache.bin -outputname cached.txt tree >rdfind.out
+printf '\377\377\377\377' |
+  dd of=cache.bin bs=1 seek=84 conv=notrunc status=none
+$rdfind -dircache cache.bin -outputname longname.txt tree >rdfind.out 2>&1
+verify cmp changed.txt longname.txt
+
+dbgecho "all is good in this test!"
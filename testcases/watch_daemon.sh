@@ -0,0 +1,78 @@
+#!/bin/sh
+# Ensures the watch daemon follows changes to the files and answers
+# questions about duplicates.
+#
+
+set -e
+. "$(dirname "$0")/common_funcs.sh"
+
+reset_teststate
+
+mkdir -p tree/sd1
+echo same >tree/a
+echo same >tree/sd1/b
+echo other >tree/c
+
+$rdfind -watch sock tree >daemon.out 2>&1 &
+daemonpid=$!
+stopdaemon() {
+  kill "$daemonpid" 2>/dev/null || true
+  wait "$daemonpid" 2>/dev/null || true
+}
+trap stopdaemon EXIT
+
+# wait for it to be ready
+for i in $(seq 1 50); do
+  if grep -q "listening on sock" daemon.out; then
+    break
+  fi
+  sleep 0.1
+done
+verify grep -q "Now watching 2 directories with 3 files" daemon.out
+
+$rdfind -query sock DUPLICATES >answer.txt
+verify grep -q "^DUPTYPE_FIRST_OCCURRENCE .* tree/a$" answer.txt
+verify grep -q "^DUPTYPE_WITHIN_SAME_TREE .* tree/sd1/b$" answer.txt
+verify [ "$($rdfind -query sock ISDUP tree/sd1/b)" = "DUPLICATE tree/a" ]
+verify [ "$($rdfind -query sock ISDUP tree/a)" = "ORIGINAL 1" ]
+verify [ "$($rdfind -query sock ISDUP tree/c)" = "UNIQUE" ]
+verify [ "$($rdfind -query sock ISDUP nonexisting)" = "UNKNOWN" ]
+
+# a changed file is no longer a duplicate
+echo sane >tree/sd1/b
+verify [ "$($rdfind -query sock ISDUP tree/sd1/b)" = "UNIQUE" ]
+
+# new files and directories are picked up
+mkdir -p tree/sd2/sd3
+echo other >tree/sd2/sd3/d
+verify [ "$($rdfind -query sock ISDUP tree/sd2/sd3/d)" = "DUPLICATE tree/c" ]
+
+# removed files are forgotten
+rm tree/c
+verify [ "$($rdfind -query sock ISDUP tree/sd2/sd3/d)" = "UNIQUE" ]
+verify [ "$($rdfind -query sock ISDUP tree/c)" = "UNKNOWN" ]
+
+# moving a directory moves its files
+mv tree/sd2 tree/sd4
+echo other >tree/e
+verify [ "$($rdfind -query sock ISDUP tree/sd4/sd3/d)" = "DUPLICATE tree/e" ]
+verify [ "$($rdfind -query sock ISDUP tree/sd2/sd3/d)" = "UNKNOWN" ]
+
+# a file written to is read again, even if its time is set back
+echo other >tree/f
+verify [ "$($rdfind -query sock ISDUP tree/f)" = "DUPLICATE tree/e" ]
+# the daemon is stopped meanwhile, so it sees the events after the fact
+kill -STOP "$daemonpid"
+touch -r tree/f stamp
+echo otter >tree/f
+touch -r stamp tree/f
+kill -CONT "$daemonpid"
+verify [ "$($rdfind -query sock ISDUP tree/f)" = "UNIQUE" ]
+
+# the daemon stops on request and cleans up
+stopdaemon
+trap - EXIT
+verify grep -q "Stopped watching" daemon.out
+verify [ ! -e sock ]
+
+dbgecho "all is good in this test!"
@@ -0,0 +1,88 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "Chunker.hh"
+#include <cstdint>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace {
+// the same pseudo random data on all machines
+std::vector<unsigned char>
+randomdata(std::size_t size, std::uint32_t seed)
+{
+  std::vector<unsigned char> data(size);
+  std::uint32_t state = seed;
+  for (auto& byte : data) {
+    state = state * 1664525U + 1013904223U;
+    byte = static_cast<unsigned char>(state >> 24);
+  }
+  return data;
+}
+
+// the contents of each chunk
+std::vector<std::string>
+chunks(const Chunker& chunker, const std::vector<unsigned char>& data)
+{
+  std::vector<std::string> ret;
+  std::size_t start = 0;
+  while (start < data.size()) {
+    const auto length = chunker.cut(data.data() + start, data.size() - start);
+    REQUIRE(length > 0);
+    ret.emplace_back(data.begin() + static_cast<std::ptrdiff_t>(start),
+                     data.begin() +
+                       static_cast<std::ptrdiff_t>(start + length));
+    start += length;
+  }
+  return ret;
+}
+}
+
+TEST_CASE("chunk sizes follow the average")
+{
+  const Chunker chunker(4096);
+  REQUIRE(chunker.minsize() == 1024);
+  REQUIRE(chunker.maxsize() == 32768);
+
+  const auto data = randomdata(1 << 22, 1);
+  const auto all = chunks(chunker, data);
+  for (std::size_t i = 0; i + 1 < all.size(); ++i) {
+    REQUIRE(all[i].size() > chunker.minsize());
+    REQUIRE(all[i].size() <= chunker.maxsize());
+  }
+  const auto average = data.size() / all.size();
+  REQUIRE(average > 2048);
+  REQUIRE(average < 8192);
+}
+
+TEST_CASE("short data is one chunk")
+{
+  const Chunker chunker(4096);
+  const auto data = randomdata(100, 2);
+  REQUIRE(chunker.cut(data.data(), data.size()) == data.size());
+}
+
+TEST_CASE("data without cut points is cut at the maximum size")
+{
+  const Chunker chunker(4096);
+  const std::vector<unsigned char> zeros(100000);
+  REQUIRE(chunker.cut(zeros.data(), zeros.size()) <= chunker.maxsize());
+}
+
+TEST_CASE("an insert only changes the chunks around it")
+{
+  const Chunker chunker(4096);
+  const auto data = randomdata(1 << 20, 3);
+  auto changed = data;
+  const auto extra = randomdata(100, 4);
+  changed.insert(changed.begin() + 1000, extra.begin(), extra.end());
+
+  const auto before = chunks(chunker, data);
+  const auto after = chunks(chunker, changed);
+  const std::set<std::string> known(before.begin(), before.end());
+  std::size_t same = 0;
+  for (const auto& chunk : after) {
+    same += known.count(chunk);
+  }
+  REQUIRE(same + 2 >= before.size());
+}